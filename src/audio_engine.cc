@@ -2,25 +2,37 @@
 
 #include <string.h>
 
+#include <atomic>
 #include <mutex>
 
 #include <SDL.h>
 
+#include "profiler.h"
+
 namespace fallout {
 
 #define AUDIO_ENGINE_SOUND_BUFFERS 8
 
+// Size of intermediate buffer for converted samples.
+#define AUDIO_ENGINE_MIX_BUFFER_SIZE 4096
+
+// NOTE: `active`, `volume`, `playing`, `looping` and `pos` are atomic so that
+// play, stop, volume and status requests do not have to wait for the audio
+// thread. The mutex guards buffer data, conversion stream and position
+// changes made outside of the audio thread.
 struct AudioEngineSoundBuffer {
-    bool active;
+    std::atomic<bool> active;
     unsigned int size;
     int bitsPerSample;
     int channels;
     int rate;
     void* data;
-    int volume;
-    bool playing;
-    bool looping;
-    unsigned int pos;
+    std::atomic<int> volume;
+    std::atomic<bool> playing;
+    std::atomic<bool> looping;
+    std::atomic<unsigned int> pos;
+    // Samples are in device format, no conversion is needed.
+    bool passthrough;
     SDL_AudioStream* stream;
     std::recursive_mutex mutex;
 };
@@ -29,14 +41,25 @@ extern bool GNW95_isActive;
 
 static bool soundBufferIsValid(int soundBufferIndex);
 static void audioEngineMixin(void* userData, Uint8* stream, int length);
+static void audioEngineMix(Uint8* dest, const Uint8* src, int length, int volume);
+static void audioEngineMixPassthrough(AudioEngineSoundBuffer* soundBuffer, Uint8* stream, int length);
+static void audioEngineMixConverted(AudioEngineSoundBuffer* soundBuffer, Uint8* stream, int length);
 
 static SDL_AudioSpec gAudioEngineSpec;
 static SDL_AudioDeviceID gAudioEngineDeviceId = -1;
 static AudioEngineSoundBuffer gAudioEngineSoundBuffers[AUDIO_ENGINE_SOUND_BUFFERS];
 
+// CE: Set when there is no audio device and sound is mixed by
+// `audioEngineRender` (see `audioEngineSetHeadless`).
+static bool gAudioEngineHeadless = false;
+static bool gAudioEngineHeadlessInitialized = false;
+
+// Sample frames owed by `audioEngineRender`, scaled by 1000.
+static unsigned long long gAudioEngineHeadlessFrames = 0;
+
 static bool audioEngineIsInitialized()
 {
-    return gAudioEngineDeviceId != -1;
+    return gAudioEngineDeviceId != -1 || gAudioEngineHeadlessInitialized;
 }
 
 static bool soundBufferIsValid(int soundBufferIndex)
@@ -46,6 +69,8 @@ static bool soundBufferIsValid(int soundBufferIndex)
 
 static void audioEngineMixin(void* userData, Uint8* stream, int length)
 {
+    ProfilerZone zone("audioEngineMixin");
+
     memset(stream, gAudioEngineSpec.silence, length);
 
     if (!GNW95_isActive) {
@@ -54,51 +79,155 @@ static void audioEngineMixin(void* userData, Uint8* stream, int length)
 
     for (int index = 0; index < AUDIO_ENGINE_SOUND_BUFFERS; index++) {
         AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[index]);
+
+        // Skip idle buffers without touching the lock.
+        if (!soundBuffer->playing) {
+            continue;
+        }
+
         std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
         if (soundBuffer->active && soundBuffer->playing) {
-            int srcFrameSize = soundBuffer->bitsPerSample / 8 * soundBuffer->channels;
-
-            unsigned char buffer[1024];
-            int pos = 0;
-            while (pos < length) {
-                int remaining = length - pos;
-                if (remaining > sizeof(buffer)) {
-                    remaining = sizeof(buffer);
-                }
+            if (soundBuffer->passthrough) {
+                audioEngineMixPassthrough(soundBuffer, stream, length);
+            } else {
+                audioEngineMixConverted(soundBuffer, stream, length);
+            }
+        }
+    }
+}
 
-                // TODO: Make something better than frame-by-frame convertion.
-                SDL_AudioStreamPut(soundBuffer->stream, (unsigned char*)soundBuffer->data + soundBuffer->pos, srcFrameSize);
-                soundBuffer->pos += srcFrameSize;
+// Mixes `length` bytes of `src` into `dest` with the given volume.
+//
+// The result is identical to `SDL_MixAudioFormat` (each source is scaled and
+// then saturated when added), but the loop for native 16-bit samples is
+// simple enough for the compiler to vectorize.
+static void audioEngineMix(Uint8* dest, const Uint8* src, int length, int volume)
+{
+    if (gAudioEngineSpec.format != AUDIO_S16SYS) {
+        SDL_MixAudioFormat(dest, src, gAudioEngineSpec.format, length, volume);
+        return;
+    }
 
-                int bytesRead = SDL_AudioStreamGet(soundBuffer->stream, buffer, remaining);
-                if (bytesRead == -1) {
-                    break;
-                }
+    if (volume == 0) {
+        return;
+    }
 
-                SDL_MixAudioFormat(stream + pos, buffer, gAudioEngineSpec.format, bytesRead, soundBuffer->volume);
+    Sint16* destSamples = reinterpret_cast<Sint16*>(dest);
+    const Sint16* srcSamples = reinterpret_cast<const Sint16*>(src);
+    int samples = length / 2;
 
-                if (soundBuffer->pos >= soundBuffer->size) {
-                    if (soundBuffer->looping) {
-                        soundBuffer->pos %= soundBuffer->size;
-                    } else {
-                        soundBuffer->playing = false;
-                        break;
-                    }
-                }
+    for (int index = 0; index < samples; index++) {
+        Sint16 scaled = static_cast<Sint16>(srcSamples[index] * volume / SDL_MIX_MAXVOLUME);
+        int sample = destSamples[index] + scaled;
+        if (sample > 32767) {
+            sample = 32767;
+        } else if (sample < -32768) {
+            sample = -32768;
+        }
+        destSamples[index] = static_cast<Sint16>(sample);
+    }
+}
+
+// Mixes sound buffer which is already in device format straight from it's
+// data.
+static void audioEngineMixPassthrough(AudioEngineSoundBuffer* soundBuffer, Uint8* stream, int length)
+{
+    int volume = soundBuffer->volume;
+    unsigned int bufferPos = soundBuffer->pos;
+
+    int pos = 0;
+    while (pos < length) {
+        unsigned int chunk = length - pos;
+        if (chunk > soundBuffer->size - bufferPos) {
+            chunk = soundBuffer->size - bufferPos;
+        }
+
+        audioEngineMix(stream + pos, (unsigned char*)soundBuffer->data + bufferPos, chunk, volume);
+
+        bufferPos += chunk;
+        pos += chunk;
 
-                pos += bytesRead;
+        if (bufferPos >= soundBuffer->size) {
+            if (soundBuffer->looping) {
+                bufferPos %= soundBuffer->size;
+            } else {
+                soundBuffer->playing = false;
+                break;
             }
         }
     }
+
+    soundBuffer->pos = bufferPos;
 }
 
-bool audioEngineInit()
+// Mixes sound buffer which needs sample format, channel or rate conversion.
+//
+// Source frames are fed to conversion stream in blocks large enough to
+// produce the requested amount of output.
+static void audioEngineMixConverted(AudioEngineSoundBuffer* soundBuffer, Uint8* stream, int length)
 {
-    if (SDL_InitSubSystem(SDL_INIT_AUDIO) == -1) {
-        return false;
+    int volume = soundBuffer->volume;
+    unsigned int bufferPos = soundBuffer->pos;
+    int srcFrameSize = soundBuffer->bitsPerSample / 8 * soundBuffer->channels;
+    int destFrameSize = SDL_AUDIO_BITSIZE(gAudioEngineSpec.format) / 8 * gAudioEngineSpec.channels;
+
+    unsigned char buffer[AUDIO_ENGINE_MIX_BUFFER_SIZE];
+    bool ended = false;
+    int pos = 0;
+    while (pos < length) {
+        int remaining = length - pos;
+
+        int available = SDL_AudioStreamAvailable(soundBuffer->stream);
+        if (available < remaining && !ended) {
+            // Estimate how many source frames will be needed to produce
+            // missing output. If conversion holds some frames back, next
+            // iteration will feed more.
+            int destFrames = (remaining - available + destFrameSize - 1) / destFrameSize;
+            int srcFrames = (int)(((long long)destFrames * soundBuffer->rate + gAudioEngineSpec.freq - 1) / gAudioEngineSpec.freq);
+            if (srcFrames < 1) {
+                srcFrames = 1;
+            }
+
+            unsigned int srcBytes = srcFrames * srcFrameSize;
+            if (srcBytes > soundBuffer->size - bufferPos) {
+                srcBytes = soundBuffer->size - bufferPos;
+            }
+
+            SDL_AudioStreamPut(soundBuffer->stream, (unsigned char*)soundBuffer->data + bufferPos, srcBytes);
+            bufferPos += srcBytes;
+
+            if (bufferPos >= soundBuffer->size) {
+                if (soundBuffer->looping) {
+                    bufferPos %= soundBuffer->size;
+                } else {
+                    soundBuffer->playing = false;
+                    ended = true;
+                }
+            }
+
+            continue;
+        }
+
+        if (remaining > (int)sizeof(buffer)) {
+            remaining = (int)sizeof(buffer);
+        }
+
+        int bytesRead = SDL_AudioStreamGet(soundBuffer->stream, buffer, remaining);
+        if (bytesRead <= 0) {
+            break;
+        }
+
+        audioEngineMix(stream + pos, buffer, bytesRead, volume);
+
+        pos += bytesRead;
     }
 
+    soundBuffer->pos = bufferPos;
+}
+
+bool audioEngineInit()
+{
     SDL_AudioSpec desiredSpec;
     desiredSpec.freq = 22050;
     desiredSpec.format = AUDIO_S16;
@@ -106,6 +235,18 @@ bool audioEngineInit()
     desiredSpec.samples = 1024;
     desiredSpec.callback = audioEngineMixin;
 
+    if (gAudioEngineHeadless) {
+        gAudioEngineSpec = desiredSpec;
+        gAudioEngineSpec.silence = 0;
+        gAudioEngineHeadlessInitialized = true;
+        gAudioEngineHeadlessFrames = 0;
+        return true;
+    }
+
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) == -1) {
+        return false;
+    }
+
     gAudioEngineDeviceId = SDL_OpenAudioDevice(NULL, 0, &desiredSpec, &gAudioEngineSpec, SDL_AUDIO_ALLOW_ANY_CHANGE);
     if (gAudioEngineDeviceId == -1) {
         return false;
@@ -118,7 +259,9 @@ bool audioEngineInit()
 
 void audioEngineExit()
 {
-    if (audioEngineIsInitialized()) {
+    gAudioEngineHeadlessInitialized = false;
+
+    if (gAudioEngineDeviceId != -1) {
         SDL_CloseAudioDevice(gAudioEngineDeviceId);
         gAudioEngineDeviceId = -1;
     }
@@ -128,16 +271,58 @@ void audioEngineExit()
     }
 }
 
+// CE: Makes `audioEngineInit` skip opening audio device. Sound buffers work as
+// usual, but they only play as `audioEngineRender` is called, which makes
+// playback progress deterministic.
+void audioEngineSetHeadless(bool headless)
+{
+    gAudioEngineHeadless = headless;
+}
+
+bool audioEngineIsHeadless()
+{
+    return gAudioEngineHeadless;
+}
+
+// CE: Mixes `ms` milliseconds of sound in headless mode, advancing playback
+// the same way audio device would.
+void audioEngineRender(unsigned int ms)
+{
+    Uint8 stream[AUDIO_ENGINE_MIX_BUFFER_SIZE];
+    int frameSize;
+    int frames;
+    int length;
+
+    if (!gAudioEngineHeadlessInitialized) {
+        return;
+    }
+
+    gAudioEngineHeadlessFrames += (unsigned long long)ms * gAudioEngineSpec.freq;
+    frames = (int)(gAudioEngineHeadlessFrames / 1000);
+    gAudioEngineHeadlessFrames %= 1000;
+
+    frameSize = SDL_AUDIO_BITSIZE(gAudioEngineSpec.format) / 8 * gAudioEngineSpec.channels;
+    while (frames > 0) {
+        length = frames * frameSize;
+        if (length > (int)sizeof(stream)) {
+            length = (int)sizeof(stream) / frameSize * frameSize;
+        }
+
+        audioEngineMixin(NULL, stream, length);
+        frames -= length / frameSize;
+    }
+}
+
 void audioEnginePause()
 {
-    if (audioEngineIsInitialized()) {
+    if (gAudioEngineDeviceId != -1) {
         SDL_PauseAudioDevice(gAudioEngineDeviceId, 1);
     }
 }
 
 void audioEngineResume()
 {
-    if (audioEngineIsInitialized()) {
+    if (gAudioEngineDeviceId != -1) {
         SDL_PauseAudioDevice(gAudioEngineDeviceId, 0);
     }
 }
@@ -163,6 +348,10 @@ int audioEngineCreateSoundBuffer(unsigned int size, int bitsPerSample, int chann
             soundBuffer->looping = false;
             soundBuffer->pos = 0;
             soundBuffer->data = malloc(size);
+            soundBuffer->passthrough = bitsPerSample == 16
+                && gAudioEngineSpec.format == AUDIO_S16SYS
+                && channels == gAudioEngineSpec.channels
+                && rate == gAudioEngineSpec.freq;
             soundBuffer->stream = SDL_NewAudioStream(bitsPerSample == 16 ? AUDIO_S16 : AUDIO_S8, channels, rate, gAudioEngineSpec.format, gAudioEngineSpec.channels, gAudioEngineSpec.freq);
             return index;
         }
@@ -189,6 +378,7 @@ bool audioEngineSoundBufferRelease(int soundBufferIndex)
     }
 
     soundBuffer->active = false;
+    soundBuffer->playing = false;
 
     free(soundBuffer->data);
     soundBuffer->data = NULL;
@@ -210,7 +400,6 @@ bool audioEngineSoundBufferSetVolume(int soundBufferIndex, int volume)
     }
 
     AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
-    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
     if (!soundBuffer->active) {
         return false;
@@ -232,7 +421,6 @@ bool audioEngineSoundBufferGetVolume(int soundBufferIndex, int* volumePtr)
     }
 
     AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
-    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
     if (!soundBuffer->active) {
         return false;
@@ -254,7 +442,6 @@ bool audioEngineSoundBufferSetPan(int soundBufferIndex, int pan)
     }
 
     AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
-    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
     if (!soundBuffer->active) {
         return false;
@@ -277,18 +464,19 @@ bool audioEngineSoundBufferPlay(int soundBufferIndex, unsigned int flags)
     }
 
     AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
-    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
     if (!soundBuffer->active) {
         return false;
     }
 
-    soundBuffer->playing = true;
-
+    // NOTE: Looping flag must be visible to the audio thread before it
+    // starts playing.
     if ((flags & AUDIO_ENGINE_SOUND_BUFFER_PLAY_LOOPING) != 0) {
         soundBuffer->looping = true;
     }
 
+    soundBuffer->playing = true;
+
     return true;
 }
 
@@ -303,7 +491,6 @@ bool audioEngineSoundBufferStop(int soundBufferIndex)
     }
 
     AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
-    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
     if (!soundBuffer->active) {
         return false;
@@ -325,18 +512,19 @@ bool audioEngineSoundBufferGetCurrentPosition(int soundBufferIndex, unsigned int
     }
 
     AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
-    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
     if (!soundBuffer->active) {
         return false;
     }
 
+    unsigned int pos = soundBuffer->pos;
+
     if (readPosPtr != NULL) {
-        *readPosPtr = soundBuffer->pos;
+        *readPosPtr = pos;
     }
 
     if (writePosPtr != NULL) {
-        *writePosPtr = soundBuffer->pos;
+        *writePosPtr = pos;
 
         if (soundBuffer->playing) {
             // 15 ms lead
@@ -465,7 +653,6 @@ bool audioEngineSoundBufferGetStatus(int soundBufferIndex, unsigned int* statusP
     }
 
     AudioEngineSoundBuffer* soundBuffer = &(gAudioEngineSoundBuffers[soundBufferIndex]);
-    std::lock_guard<std::recursive_mutex> lock(soundBuffer->mutex);
 
     if (!soundBuffer->active) {
         return false;
@@ -13,6 +13,9 @@ namespace fallout {
 
 bool audioEngineInit();
 void audioEngineExit();
+void audioEngineSetHeadless(bool headless);
+bool audioEngineIsHeadless();
+void audioEngineRender(unsigned int ms);
 void audioEnginePause();
 void audioEngineResume();
 int audioEngineCreateSoundBuffer(unsigned int size, int bitsPerSample, int channels, int rate);
@@ -405,6 +405,7 @@ static int show_death(Object* obj, int anim)
 
     if (obj->pid != 16777266 && obj->pid != 16777265 && obj->pid != 16777224) {
         obj->flags |= OBJECT_NO_BLOCK;
+        obj_blocking_invalidate(obj->elevation);
         if (obj_toggle_flat(obj, &temp_rect) == 0) {
             rect_min_bound(&dirty_rect, &temp_rect, &dirty_rect);
         }
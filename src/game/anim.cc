@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "game/art.h"
+#include "game/benchmark.h"
 #include "game/combat.h"
 #include "game/combat_defs.h"
 #include "game/combatai.h"
@@ -17,6 +18,7 @@
 #include "game/item.h"
 #include "game/map.h"
 #include "game/object.h"
+#include "game/path.h"
 #include "game/perk.h"
 #include "game/protinst.h"
 #include "game/proto.h"
@@ -41,6 +43,9 @@ namespace fallout {
 
 #define ANIMATION_SEQUENCE_FORCED 0x01
 
+#define PATH_CACHE_CAPACITY 32
+#define PATH_CACHE_MAX_ROTATIONS 800
+
 typedef enum AnimationKind {
     ANIM_KIND_MOVE_TO_OBJECT = 0,
     ANIM_KIND_MOVE_TO_TILE = 1,
@@ -216,14 +221,38 @@ typedef struct AnimationSequence {
     AnimationDescription animations[ANIMATION_DESCRIPTION_LIST_CAPACITY];
 } AnimationSequence;
 
-typedef struct PathNode {
-    int tile;
+typedef enum PathCacheKind {
+    PATH_CACHE_KIND_PATH,
+    PATH_CACHE_KIND_STRAIGHT_PATH,
+} PathCacheKind;
+
+// Result of `make_path` or `make_straight_path` query.
+//
+// Entry is valid as long as blocking epoch of it's elevation is unchanged
+// (see `obj_blocking_epoch`).
+typedef struct PathCacheEntry {
+    // Blocking epoch at the moment entry was stored, 0 - entry is unused.
+    unsigned int epoch;
+    PathCacheKind kind;
+    Object* object;
     int from;
-    // actual type is likely char
-    int rotation;
-    int field_C;
-    int field_10;
-} PathNode;
+    int to;
+    int elevation;
+    // Screen coordinates of tiles (used by both path builders) depend on
+    // which tile is at the center of the screen.
+    int centerTile;
+    // `a5` of `make_path` or `a6` of `make_straight_path`.
+    int flags;
+    bool inCombat;
+    bool hasObstacle;
+    // Obstacle passed into `make_straight_path`.
+    Object* obstacleIn;
+    // Obstacle returned from `make_straight_path`.
+    Object* obstacleOut;
+    bool hasRotations;
+    int length;
+    unsigned char rotations[PATH_CACHE_MAX_ROTATIONS];
+} PathCacheEntry;
 
 // TODO: I don't know what `sad` means, but it's definitely better than
 // `STRUCT_530014`. Find a better name.
@@ -268,6 +297,8 @@ static int anim_animate(Object* obj, int anim, int animationSequenceIndex, int f
 static void object_anim_compact();
 static int anim_turn_towards(Object* obj, int delta, int animationSequenceIndex);
 static int check_gravity(int tile, int elevation);
+static PathCacheEntry* path_cache_find(PathCacheKind kind, Object* object, int from, int to, int flags, Object** obstaclePtr);
+static PathCacheEntry* path_cache_add(PathCacheKind kind, Object* object, int from, int to, int flags, Object** obstaclePtr);
 
 // 0x4FEA98
 static int curr_sad = 0;
@@ -287,21 +318,21 @@ static bool anim_in_bk = false;
 // 0x540014
 static AnimationSad sad[ANIMATION_SAD_LIST_CAPACITY];
 
-// 0x5566D4
-static PathNode dad[20000];
-
 // 0x560314
 static AnimationSequence anim_set[ANIMATION_SEQUENCE_LIST_CAPACITY];
 
-// 0x56A1E4
-static unsigned char seen[5000];
-
-// 0x54CA94
-static PathNode child[20000];
-
 // 0x56B56C
 static int curr_anim_counter;
 
+static PathCacheEntry path_cache[PATH_CACHE_CAPACITY];
+
+// Index of the entry in `path_cache` to be replaced next.
+static int path_cache_next;
+
+static unsigned int path_cache_hits;
+
+static unsigned int path_cache_misses;
+
 // 0x4134B0
 void anim_init()
 {
@@ -323,6 +354,8 @@ void anim_reset()
     curr_sad = 0;
     curr_anim_set = -1;
 
+    path_cache_clear();
+
     for (index = 0; index < ANIMATION_SEQUENCE_LIST_CAPACITY; index++) {
         anim_set[index].field_0 = -1000;
         anim_set[index].flags = 0;
@@ -334,6 +367,10 @@ void anim_exit()
 {
     // NOTE: Uninline.
     anim_stop();
+
+    char stats[200];
+    path_cache_stats(stats, sizeof(stats));
+    debug_printf("%s", stats);
 }
 
 // 0x413584
@@ -1517,6 +1554,7 @@ static int anim_set_check(int animationSequenceIndex)
                 }
             } else {
                 animationDescription->owner->flags |= animationDescription->objectFlag;
+                obj_blocking_invalidate(animationDescription->owner->elevation);
             }
 
             rc = anim_set_continue(animationSequenceIndex, 0);
@@ -1532,6 +1570,7 @@ static int anim_set_check(int animationSequenceIndex)
                 }
             } else {
                 animationDescription->owner->flags &= ~animationDescription->objectFlag;
+                obj_blocking_invalidate(animationDescription->owner->elevation);
             }
 
             rc = anim_set_continue(animationSequenceIndex, 0);
@@ -1765,177 +1804,137 @@ static bool anim_can_use_door(Object* critter, Object* door)
 // 0x4159D4
 int make_path(Object* object, int from, int to, unsigned char* rotations, int a5)
 {
-    return make_path_func(object, from, to, rotations, a5, obj_blocking_at);
-}
+    PathCacheEntry* entry = path_cache_find(PATH_CACHE_KIND_PATH, object, from, to, a5, NULL);
+    if (entry != NULL && (rotations == NULL || entry->hasRotations)) {
+        path_cache_hits++;
 
-// 0x4159E8
-int make_path_func(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback)
-{
-    if (a5) {
-        if (callback(object, to, object->elevation) != NULL) {
-            return 0;
+        if (rotations != NULL) {
+            memcpy(rotations, entry->rotations, entry->length);
         }
-    }
-
-    bool isNotInCombat = !isInCombat();
-
-    memset(seen, 0, sizeof(seen));
 
-    seen[from / 8] |= 1 << (from & 7);
-
-    child[0].tile = from;
-    child[0].from = -1;
-    child[0].rotation = 0;
-    child[0].field_C = EST(from, to);
-    child[0].field_10 = 0;
-
-    for (int index = 1; index < 2000; index += 1) {
-        child[index].tile = -1;
+        return entry->length;
     }
 
-    int toScreenX;
-    int toScreenY;
-    tile_coord(to, &toScreenX, &toScreenY, object->elevation);
-
-    int closedPathNodeListLength = 0;
-    int openPathNodeListLength = 1;
-    PathNode temp;
+    path_cache_misses++;
 
-    while (1) {
-        int v63 = -1;
-
-        PathNode* prev = NULL;
-        int v12 = 0;
-        for (int index = 0; v12 < openPathNodeListLength; index += 1) {
-            PathNode* curr = &(child[index]);
-            if (curr->tile != -1) {
-                v12++;
-                if (v63 == -1 || (curr->field_C + curr->field_10) < (prev->field_C + prev->field_10)) {
-                    prev = curr;
-                    v63 = index;
-                }
-            }
-        }
-
-        PathNode* curr = &(child[v63]);
-
-        memcpy(&temp, curr, sizeof(temp));
-
-        openPathNodeListLength -= 1;
+    int length = make_path_func(object, from, to, rotations, a5, obj_blocking_at);
 
-        curr->tile = -1;
-
-        if (temp.tile == to) {
-            if (openPathNodeListLength == 0) {
-                openPathNodeListLength = 1;
-            }
-            break;
+    entry = path_cache_add(PATH_CACHE_KIND_PATH, object, from, to, a5, NULL);
+    if (entry != NULL) {
+        entry->length = length;
+        if (rotations != NULL && length <= PATH_CACHE_MAX_ROTATIONS) {
+            memcpy(entry->rotations, rotations, length);
+            entry->hasRotations = true;
         }
+    }
 
-        PathNode* curr1 = &(dad[closedPathNodeListLength]);
-        memcpy(curr1, &temp, sizeof(temp));
-
-        closedPathNodeListLength += 1;
+    return length;
+}
 
-        if (closedPathNodeListLength == 20000) {
+// 0x4159E8
+int make_path_func(Object* object, int from, int to, unsigned char* rotations, int a5, PathBuilderCallback* callback)
+{
+    if (a5) {
+        if (callback(object, to, object->elevation) != NULL) {
             return 0;
         }
+    }
 
-        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
-            int tile = tile_num_in_direction(temp.tile, rotation, 1);
-            int bit = 1 << (tile & 7);
-            if ((seen[tile / 8] & bit) != 0) {
-                continue;
-            }
-
-            if (tile != to) {
-                Object* v24 = callback(object, tile, object->elevation);
-                if (v24 != NULL) {
-                    if (!anim_can_use_door(object, v24)) {
-                        continue;
-                    }
-                }
-            }
-
-            int v25 = 0;
-            for (; v25 < 20000; v25++) {
-                if (child[v25].tile == -1) {
-                    break;
-                }
-            }
-
-            openPathNodeListLength += 1;
-
-            if (openPathNodeListLength == 20000) {
-                return 0;
-            }
-
-            seen[tile / 8] |= bit;
-
-            PathNode* v27 = &(child[v25]);
-            v27->tile = tile;
-            v27->from = temp.tile;
-            v27->rotation = rotation;
+    // CE: Search is in `path_find` (see `path.cc`).
+    return path_find(object, from, to, rotations, !isInCombat(), callback, anim_can_use_door);
+}
 
-            int newX;
-            int newY;
-            tile_coord(tile, &newX, &newY, object->elevation);
+// Returns cached result of path query, or `NULL` if there is no such query
+// or blockers on object's elevation changed since it was cached.
+static PathCacheEntry* path_cache_find(PathCacheKind kind, Object* object, int from, int to, int flags, Object** obstaclePtr)
+{
+    unsigned int epoch = obj_blocking_epoch(object->elevation);
+    if (epoch == 0) {
+        return NULL;
+    }
 
-            v27->field_C = idist(newX, newY, toScreenX, toScreenY);
-            v27->field_10 = temp.field_10 + 50;
+    bool inCombat = kind == PATH_CACHE_KIND_PATH && isInCombat();
+    Object* obstacle = obstaclePtr != NULL ? *obstaclePtr : NULL;
 
-            if (isNotInCombat && temp.rotation != rotation) {
-                v27->field_10 += 10;
-            }
+    for (int index = 0; index < PATH_CACHE_CAPACITY; index++) {
+        PathCacheEntry* entry = &(path_cache[index]);
+        if (entry->epoch == epoch
+            && entry->kind == kind
+            && entry->object == object
+            && entry->from == from
+            && entry->to == to
+            && entry->elevation == object->elevation
+            && entry->centerTile == tile_center_tile
+            && entry->flags == flags
+            && entry->inCombat == inCombat
+            && entry->hasObstacle == (obstaclePtr != NULL)
+            && entry->obstacleIn == obstacle) {
+            return entry;
         }
+    }
 
-        if (openPathNodeListLength == 0) {
-            break;
-        }
+    return NULL;
+}
+
+// Claims cache entry for path query about to be made. The caller is
+// responsible for filling in results.
+//
+// An existing entry for the same query (i.e. cached without rotations) is
+// reused instead of adding a duplicate.
+static PathCacheEntry* path_cache_add(PathCacheKind kind, Object* object, int from, int to, int flags, Object** obstaclePtr)
+{
+    unsigned int epoch = obj_blocking_epoch(object->elevation);
+    if (epoch == 0) {
+        return NULL;
     }
 
-    if (openPathNodeListLength != 0) {
-        unsigned char* v39 = rotations;
-        int index = 0;
-        for (; index < 20000; index++) {
-            if (temp.tile == from) {
-                break;
-            }
+    PathCacheEntry* entry = path_cache_find(kind, object, from, to, flags, obstaclePtr);
+    if (entry == NULL) {
+        entry = &(path_cache[path_cache_next]);
+        path_cache_next = (path_cache_next + 1) % PATH_CACHE_CAPACITY;
+    }
 
-            if (v39 != NULL) {
-                *v39 = temp.rotation & 0xFF;
-                v39 += 1;
-            }
+    entry->epoch = epoch;
+    entry->kind = kind;
+    entry->object = object;
+    entry->from = from;
+    entry->to = to;
+    entry->elevation = object->elevation;
+    entry->centerTile = tile_center_tile;
+    entry->flags = flags;
+    entry->inCombat = kind == PATH_CACHE_KIND_PATH && isInCombat();
+    entry->hasObstacle = obstaclePtr != NULL;
+    entry->obstacleIn = obstaclePtr != NULL ? *obstaclePtr : NULL;
+    entry->obstacleOut = NULL;
+    entry->hasRotations = false;
+    entry->length = 0;
 
-            int j = 0;
-            while (dad[j].tile != temp.from) {
-                j++;
-            }
+    return entry;
+}
 
-            PathNode* v36 = &(dad[j]);
-            memcpy(&temp, v36, sizeof(temp));
-        }
+void path_cache_clear()
+{
+    for (int index = 0; index < PATH_CACHE_CAPACITY; index++) {
+        path_cache[index].epoch = 0;
+    }
 
-        if (rotations != NULL) {
-            // Looks like array resevering, probably because A* finishes it's path from end to start,
-            // this probably reverses it start-to-end.
-            unsigned char* beginning = rotations;
-            unsigned char* ending = rotations + index - 1;
-            int middle = index / 2;
-            for (int index = 0; index < middle; index++) {
-                unsigned char rotation = *ending;
-                *ending = *beginning;
-                *beginning = rotation;
-
-                ending -= 1;
-                beginning += 1;
-            }
-        }
+    path_cache_next = 0;
+}
 
-        return index;
+bool path_cache_stats(char* dest, size_t size)
+{
+    if (dest == NULL) {
+        return false;
     }
 
-    return 0;
+    unsigned int total = path_cache_hits + path_cache_misses;
+    snprintf(dest, size,
+        "Path cache: %u hits, %u misses (%u%% hit rate).\n",
+        path_cache_hits,
+        path_cache_misses,
+        total != 0 ? path_cache_hits * 100 / total : 0);
+
+    return true;
 }
 
 // 0x415D9C
@@ -1973,7 +1972,37 @@ int EST(int tile1, int tile2)
 // 0x415E0C
 int make_straight_path(Object* a1, int from, int to, StraightPathNode* pathNodes, Object** a5, int a6)
 {
-    return make_straight_path_func(a1, from, to, pathNodes, a5, a6, obj_blocking_at);
+    // Only path lengths and obstacles are cached, path nodes depend on
+    // current screen position.
+    if (pathNodes != NULL) {
+        return make_straight_path_func(a1, from, to, pathNodes, a5, a6, obj_blocking_at);
+    }
+
+    PathCacheEntry* entry = path_cache_find(PATH_CACHE_KIND_STRAIGHT_PATH, a1, from, to, a6, a5);
+    if (entry != NULL) {
+        path_cache_hits++;
+
+        if (a5 != NULL) {
+            *a5 = entry->obstacleOut;
+        }
+
+        return entry->length;
+    }
+
+    path_cache_misses++;
+
+    entry = path_cache_add(PATH_CACHE_KIND_STRAIGHT_PATH, a1, from, to, a6, a5);
+
+    int length = make_straight_path_func(a1, from, to, NULL, a5, a6, obj_blocking_at);
+
+    if (entry != NULL) {
+        entry->length = length;
+        if (a5 != NULL) {
+            entry->obstacleOut = *a5;
+        }
+    }
+
+    return length;
 }
 
 // TODO: Rather complex, but understandable, needs testing.
@@ -2171,10 +2200,17 @@ static int anim_move_to_object(Object* from, Object* to, int a3, int anim, int a
     bool hidden = (to->flags & OBJECT_HIDDEN);
     to->flags |= OBJECT_HIDDEN;
 
+    // CE: `to` no longer blocks, paths cached with it in place (and paths
+    // cached below without it) must not be reused.
+    if (!hidden) {
+        obj_blocking_invalidate(to->elevation);
+    }
+
     int moveSadIndex = anim_move(from, to->tile, to->elevation, -1, anim, 0, animationSequenceIndex);
 
     if (!hidden) {
         to->flags &= ~OBJECT_HIDDEN;
+        obj_blocking_invalidate(to->elevation);
     }
 
     if (moveSadIndex == -1) {
@@ -2775,6 +2811,8 @@ void object_animate()
         return;
     }
 
+    int previousPhase = benchmark_phase_enter(BENCHMARK_PHASE_ANIMATION);
+
     anim_in_bk = 1;
 
     for (int index = 0; index < curr_sad; index++) {
@@ -2935,6 +2973,8 @@ void object_animate()
     anim_in_bk = 0;
 
     object_anim_compact();
+
+    benchmark_phase_leave(previousPhase);
 }
 
 // 0x417880
@@ -1,6 +1,8 @@
 #ifndef FALLOUT_GAME_ANIMATION_H_
 #define FALLOUT_GAME_ANIMATION_H_
 
+#include <stddef.h>
+
 #include "game/object_types.h"
 
 namespace fallout {
@@ -152,6 +154,8 @@ int idist(int a1, int a2, int a3, int a4);
 int EST(int tile1, int tile2);
 int make_straight_path(Object* a1, int from, int to, StraightPathNode* pathNodes, Object** a5, int a6);
 int make_straight_path_func(Object* a1, int from, int to, StraightPathNode* pathNodes, Object** a5, int a6, PathBuilderCallback* callback);
+void path_cache_clear();
+bool path_cache_stats(char* dest, size_t size);
 int anim_move_on_stairs(Object* obj, int tile, int elevation, int anim, int animationSequenceIndex);
 int check_for_falling(Object* obj, int anim, int a3);
 void object_animate();
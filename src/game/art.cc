@@ -983,6 +983,32 @@ void art_data_free(void* ptr)
     mem_free(ptr);
 }
 
+// Starts loading art file for `fid` in the background, so that subsequent
+// `art_data_size`/`art_data_load` do not have to wait for disk and LZSS. Does
+// nothing if the art is already cached.
+void art_prefetch(int fid)
+{
+    DB_DATABASE* oldDb = INVALID_DATABASE_HANDLE;
+
+    if (cache_query(&art_cache, fid)) {
+        return;
+    }
+
+    if (FID_TYPE(fid) == OBJ_TYPE_CRITTER) {
+        oldDb = db_current();
+        db_select(critter_db_handle);
+    }
+
+    char* artFileName = art_get_name(fid);
+    if (artFileName != NULL) {
+        db_prefetch(artFileName);
+    }
+
+    if (oldDb != INVALID_DATABASE_HANDLE) {
+        db_select(oldDb);
+    }
+}
+
 // 0x4192C8
 int art_id(int objectType, int frmId, int animType, int a3, int rotation)
 {
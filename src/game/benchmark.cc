@@ -0,0 +1,324 @@
+#include "game/benchmark.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include <SDL.h>
+
+#include "audio_engine.h"
+#include "game/game.h"
+#include "game/gconfig.h"
+#include "game/map.h"
+#include "game/object.h"
+#include "game/scripts.h"
+#include "platform_compat.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/input.h"
+#include "profiler.h"
+
+namespace fallout {
+
+#define BENCHMARK_DEFAULT_STEP 16
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+// Set in value returned by `benchmark_phase_enter` when the phase has opened
+// a profiler zone (capture can be toggled while phase is active).
+#define BENCHMARK_PHASE_PROFILER_ZONE 0x100
+
+typedef struct BenchmarkFrame {
+    unsigned int time;
+    Uint64 ticks[BENCHMARK_PHASE_COUNT];
+} BenchmarkFrame;
+
+static void benchmark_account();
+static unsigned long long benchmark_state_hash();
+static unsigned long long benchmark_hash_int(unsigned long long hash, int value);
+static double benchmark_ticks_to_ms(Uint64 ticks);
+static int benchmark_write_csv(FILE* stream, unsigned long long hash);
+static int benchmark_write_json(FILE* stream, unsigned long long hash);
+
+static const char* benchmark_phase_names[BENCHMARK_PHASE_COUNT] = {
+    "other",
+    "render",
+    "scripts",
+    "animation",
+    "ai",
+    "audio",
+};
+
+static bool benchmark_active = false;
+
+// Name of selfrun recording (in `selfrun` folder).
+static char benchmark_selfrun[COMPAT_MAX_PATH];
+
+// Native path of the report, `.json` extension selects JSON, everything else
+// is written as CSV.
+static char benchmark_output[COMPAT_MAX_PATH];
+
+// Duration of every frame on the fixed clock (in ms).
+static int benchmark_step = BENCHMARK_DEFAULT_STEP;
+
+static std::vector<BenchmarkFrame> benchmark_frames;
+
+// Frame being measured.
+static BenchmarkFrame benchmark_frame;
+
+// Phase currently accumulating time.
+static int benchmark_phase = BENCHMARK_PHASE_OTHER;
+
+// Performance counter value when `benchmark_phase` was last accounted.
+static Uint64 benchmark_phase_start;
+
+bool benchmark_init()
+{
+    char* selfrun;
+    if (!config_get_string(&game_config, GAME_CONFIG_BENCHMARK_KEY, GAME_CONFIG_BENCHMARK_SELFRUN_KEY, &selfrun) || *selfrun == '\0') {
+        return false;
+    }
+
+    strncpy(benchmark_selfrun, selfrun, sizeof(benchmark_selfrun) - 1);
+
+    char* output;
+    if (config_get_string(&game_config, GAME_CONFIG_BENCHMARK_KEY, GAME_CONFIG_BENCHMARK_OUTPUT_KEY, &output) && *output != '\0') {
+        strncpy(benchmark_output, output, sizeof(benchmark_output) - 1);
+    } else {
+        strcpy(benchmark_output, "benchmark.csv");
+    }
+
+    int step;
+    if (config_get_value(&game_config, GAME_CONFIG_BENCHMARK_KEY, GAME_CONFIG_BENCHMARK_STEP_KEY, &step) && step > 0) {
+        benchmark_step = step;
+    }
+
+    enableFixedTime();
+    audioEngineSetHeadless(true);
+
+    benchmark_active = true;
+
+    debug_printf("Benchmark: %s, %d ms per frame, report to %s\n", benchmark_selfrun, benchmark_step, benchmark_output);
+
+    return true;
+}
+
+bool benchmark_is_active()
+{
+    return benchmark_active;
+}
+
+const char* benchmark_get_selfrun()
+{
+    return benchmark_selfrun;
+}
+
+int benchmark_phase_enter(int phase)
+{
+    int previousPhase = benchmark_phase;
+
+    if (gProfilerCapturing.load(std::memory_order_relaxed)) {
+        profilerBeginZone(benchmark_phase_names[phase]);
+        previousPhase |= BENCHMARK_PHASE_PROFILER_ZONE;
+    }
+
+    if (benchmark_active) {
+        benchmark_account();
+        benchmark_phase = phase;
+    }
+
+    return previousPhase;
+}
+
+void benchmark_phase_leave(int previousPhase)
+{
+    if ((previousPhase & BENCHMARK_PHASE_PROFILER_ZONE) != 0) {
+        profilerEndZone();
+    }
+
+    if (benchmark_active) {
+        benchmark_account();
+        benchmark_phase = previousPhase & ~BENCHMARK_PHASE_PROFILER_ZONE;
+    }
+}
+
+// Adds time elapsed since last call to the current phase.
+static void benchmark_account()
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    benchmark_frame.ticks[benchmark_phase] += now - benchmark_phase_start;
+    benchmark_phase_start = now;
+}
+
+void benchmark_frame_begin()
+{
+    if (!benchmark_active) {
+        return;
+    }
+
+    memset(&benchmark_frame, 0, sizeof(benchmark_frame));
+    benchmark_frame.time = get_time();
+    benchmark_phase = BENCHMARK_PHASE_OTHER;
+    benchmark_phase_start = SDL_GetPerformanceCounter();
+}
+
+void benchmark_frame_end()
+{
+    if (!benchmark_active) {
+        return;
+    }
+
+    // There is no audio device to pull samples, mix one step worth of sound
+    // here so that audio costs are part of the frame.
+    int previousPhase = benchmark_phase_enter(BENCHMARK_PHASE_AUDIO);
+    audioEngineRender(benchmark_step);
+    benchmark_phase_leave(previousPhase);
+
+    benchmark_frames.push_back(benchmark_frame);
+
+    advanceFixedTime(benchmark_step);
+}
+
+int benchmark_write_report()
+{
+    if (!benchmark_active) {
+        return -1;
+    }
+
+    unsigned long long hash = benchmark_state_hash();
+    debug_printf("Benchmark: %d frames, state hash %016llx\n", (int)benchmark_frames.size(), hash);
+
+    FILE* stream = compat_fopen(benchmark_output, "wt");
+    if (stream == NULL) {
+        debug_printf("Benchmark: unable to open %s\n", benchmark_output);
+        return -1;
+    }
+
+    int rc;
+    const char* extension = strrchr(benchmark_output, '.');
+    if (extension != NULL && compat_stricmp(extension, ".json") == 0) {
+        rc = benchmark_write_json(stream, hash);
+    } else {
+        rc = benchmark_write_csv(stream, hash);
+    }
+
+    fclose(stream);
+
+    return rc;
+}
+
+// Fingerprints game state the replay can affect so that two runs of the same
+// recording can be compared.
+static unsigned long long benchmark_state_hash()
+{
+    unsigned long long hash = FNV_OFFSET_BASIS;
+
+    hash = benchmark_hash_int(hash, game_time());
+    hash = benchmark_hash_int(hash, map_get_index_number());
+    hash = benchmark_hash_int(hash, map_elevation);
+
+    for (int index = 0; index < num_game_global_vars; index++) {
+        hash = benchmark_hash_int(hash, game_global_vars[index]);
+    }
+
+    for (Object* obj = obj_find_first(); obj != NULL; obj = obj_find_next()) {
+        hash = benchmark_hash_int(hash, obj->id);
+        hash = benchmark_hash_int(hash, obj->pid);
+        hash = benchmark_hash_int(hash, obj->tile);
+        hash = benchmark_hash_int(hash, obj->elevation);
+        hash = benchmark_hash_int(hash, obj->rotation);
+        hash = benchmark_hash_int(hash, obj->fid);
+        hash = benchmark_hash_int(hash, obj->flags);
+
+        if (FID_TYPE(obj->fid) == OBJ_TYPE_CRITTER) {
+            hash = benchmark_hash_int(hash, obj->data.critter.hp);
+            hash = benchmark_hash_int(hash, obj->data.critter.combat.results);
+        }
+    }
+
+    return hash;
+}
+
+static unsigned long long benchmark_hash_int(unsigned long long hash, int value)
+{
+    unsigned int bits = (unsigned int)value;
+    for (int index = 0; index < 4; index++) {
+        hash ^= (bits >> (index * 8)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static double benchmark_ticks_to_ms(Uint64 ticks)
+{
+    return (double)ticks * 1000.0 / (double)SDL_GetPerformanceFrequency();
+}
+
+static int benchmark_write_csv(FILE* stream, unsigned long long hash)
+{
+    fprintf(stream, "# selfrun=%s step=%d frames=%d state_hash=%016llx\n",
+        benchmark_selfrun,
+        benchmark_step,
+        (int)benchmark_frames.size(),
+        hash);
+
+    fprintf(stream, "frame,time,total_ms");
+    for (int phase = 0; phase < BENCHMARK_PHASE_COUNT; phase++) {
+        fprintf(stream, ",%s_ms", benchmark_phase_names[phase]);
+    }
+    fprintf(stream, "\n");
+
+    for (size_t index = 0; index < benchmark_frames.size(); index++) {
+        BenchmarkFrame* frame = &(benchmark_frames[index]);
+
+        Uint64 total = 0;
+        for (int phase = 0; phase < BENCHMARK_PHASE_COUNT; phase++) {
+            total += frame->ticks[phase];
+        }
+
+        fprintf(stream, "%d,%u,%.4f", (int)index, frame->time, benchmark_ticks_to_ms(total));
+        for (int phase = 0; phase < BENCHMARK_PHASE_COUNT; phase++) {
+            fprintf(stream, ",%.4f", benchmark_ticks_to_ms(frame->ticks[phase]));
+        }
+        fprintf(stream, "\n");
+    }
+
+    return 0;
+}
+
+static int benchmark_write_json(FILE* stream, unsigned long long hash)
+{
+    // NOTE: Recording name comes from the command line, it's not escaped.
+    fprintf(stream, "{\n");
+    fprintf(stream, "  \"selfrun\": \"%s\",\n", benchmark_selfrun);
+    fprintf(stream, "  \"step\": %d,\n", benchmark_step);
+    fprintf(stream, "  \"state_hash\": \"%016llx\",\n", hash);
+    fprintf(stream, "  \"frames\": [");
+
+    for (size_t index = 0; index < benchmark_frames.size(); index++) {
+        BenchmarkFrame* frame = &(benchmark_frames[index]);
+
+        Uint64 total = 0;
+        for (int phase = 0; phase < BENCHMARK_PHASE_COUNT; phase++) {
+            total += frame->ticks[phase];
+        }
+
+        fprintf(stream, "%s\n    {\"frame\": %d, \"time\": %u, \"total_ms\": %.4f",
+            index != 0 ? "," : "",
+            (int)index,
+            frame->time,
+            benchmark_ticks_to_ms(total));
+        for (int phase = 0; phase < BENCHMARK_PHASE_COUNT; phase++) {
+            fprintf(stream, ", \"%s_ms\": %.4f", benchmark_phase_names[phase], benchmark_ticks_to_ms(frame->ticks[phase]));
+        }
+        fprintf(stream, "}");
+    }
+
+    fprintf(stream, "\n  ]\n");
+    fprintf(stream, "}\n");
+
+    return 0;
+}
+
+} // namespace fallout
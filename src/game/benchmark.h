@@ -0,0 +1,51 @@
+#ifndef FALLOUT_GAME_BENCHMARK_H_
+#define FALLOUT_GAME_BENCHMARK_H_
+
+namespace fallout {
+
+// Subsystems the benchmark attributes frame time to. Time spent outside of
+// any of them is reported as `other`.
+typedef enum BenchmarkPhase {
+    BENCHMARK_PHASE_OTHER,
+    BENCHMARK_PHASE_RENDER,
+    BENCHMARK_PHASE_SCRIPTS,
+    BENCHMARK_PHASE_ANIMATION,
+    BENCHMARK_PHASE_AI,
+    BENCHMARK_PHASE_AUDIO,
+    BENCHMARK_PHASE_COUNT,
+} BenchmarkPhase;
+
+// Reads `[benchmark]` section of the game config (usually given on the
+// command line, e.g. `"[benchmark]selfrun=combat.sdf"`). When a recording is
+// specified the game runs headless with a fixed clock.
+bool benchmark_init();
+
+// Returns true if the game was started in benchmark mode.
+bool benchmark_is_active();
+
+// Returns selfrun recording the benchmark replays.
+const char* benchmark_get_selfrun();
+
+// Starts attributing time to `phase`, returns the value that should be passed
+// to `benchmark_phase_leave` to restore previous attribution. Nested phases
+// are exclusive, the time is accounted to the innermost one only.
+//
+// Phases are also profiler zones (named after the phase), so the same call
+// sites show up in the profiler trace whether or not benchmark is running.
+// The pair must not be crossed by `longjmp`.
+int benchmark_phase_enter(int phase);
+void benchmark_phase_leave(int previousPhase);
+
+void benchmark_frame_begin();
+
+// Finishes frame record, mixes audio and advances the fixed clock by one
+// step.
+void benchmark_frame_end();
+
+// Writes collected frame timings and final state hash to the output file.
+// Should be called while the map is still loaded.
+int benchmark_write_report();
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_BENCHMARK_H_ */
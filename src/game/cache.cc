@@ -14,6 +14,7 @@ namespace fallout {
 static bool cache_add(Cache* cache, int key, int* indexPtr);
 static bool cache_insert(Cache* cache, CacheEntry* cacheEntry, int index);
 static int cache_find(Cache* cache, int key, int* indexPtr);
+static void cache_remove(Cache* cache, CacheEntry* cacheEntry);
 static int cache_create_item(CacheEntry** cacheEntryPtr);
 static bool cache_init_item(CacheEntry* cacheEntry);
 static bool cache_destroy_item(Cache* cache, CacheEntry* cacheEntry);
@@ -24,6 +25,15 @@ static bool cache_purge(Cache* cache);
 static bool cache_resize_array(Cache* cache, int newCapacity);
 static int cache_compare_make_room(const void* a1, const void* a2);
 static int cache_compare_reset_counter(const void* a1, const void* a2);
+static unsigned int cache_hash(int key, int capacity);
+static bool cache_index_resize(Cache* cache, int newCapacity);
+static void cache_index_insert(Cache* cache, CacheEntry* cacheEntry);
+static void cache_index_remove(Cache* cache, CacheEntry* cacheEntry);
+static void cache_eviction_queue_push(Cache* cache, CacheEntry* cacheEntry);
+static void cache_eviction_queue_remove(Cache* cache, CacheEntry* cacheEntry);
+static void cache_eviction_queue_rebuild(Cache* cache);
+static void cache_eviction_queue_sift_up(Cache* cache, int index);
+static void cache_eviction_queue_sift_down(Cache* cache, int index);
 
 // 0x4FEC7C
 static int lock_sound_ticker = 0;
@@ -41,16 +51,24 @@ bool cache_init(Cache* cache, CacheSizeProc* sizeProc, CacheReadProc* readProc,
     cache->entriesCapacity = CACHE_ENTRIES_INITIAL_CAPACITY;
     cache->hits = 0;
     cache->entries = (CacheEntry**)mem_malloc(sizeof(*cache->entries) * cache->entriesCapacity);
+    cache->index = NULL;
+    cache->indexCapacity = 0;
+    cache->evictionQueue = (CacheEntry**)mem_malloc(sizeof(*cache->evictionQueue) * cache->entriesCapacity);
+    cache->evictionQueueLength = 0;
     cache->sizeProc = sizeProc;
     cache->readProc = readProc;
     cache->freeProc = freeProc;
 
-    if (cache->entries == NULL) {
+    if (cache->entries == NULL || cache->evictionQueue == NULL) {
         return false;
     }
 
     memset(cache->entries, 0, sizeof(*cache->entries) * cache->entriesCapacity);
 
+    if (!cache_index_resize(cache, cache->entriesCapacity)) {
+        return false;
+    }
+
     return true;
 }
 
@@ -76,6 +94,20 @@ bool cache_exit(Cache* cache)
         cache->entries = NULL;
     }
 
+    if (cache->index != NULL) {
+        mem_free(cache->index);
+        cache->index = NULL;
+    }
+
+    cache->indexCapacity = 0;
+
+    if (cache->evictionQueue != NULL) {
+        mem_free(cache->evictionQueue);
+        cache->evictionQueue = NULL;
+    }
+
+    cache->evictionQueueLength = 0;
+
     cache->sizeProc = NULL;
     cache->readProc = NULL;
     cache->freeProc = NULL;
@@ -113,6 +145,10 @@ bool cache_lock(Cache* cache, int key, void** data, CacheEntry** cacheEntryPtr)
     if (rc == 2) {
         // Use existing cache entry.
         CacheEntry* cacheEntry = cache->entries[index];
+
+        // CE: `hits` is part of eviction queue ordering, take entry out of
+        // the queue before changing it.
+        cache_eviction_queue_remove(cache, cacheEntry);
         cacheEntry->hits++;
     } else if (rc == 3) {
         // New cache entry is required.
@@ -135,8 +171,16 @@ bool cache_lock(Cache* cache, int key, void** data, CacheEntry** cacheEntryPtr)
     CacheEntry* cacheEntry = cache->entries[index];
     if (cacheEntry->referenceCount == 0) {
         if (!heap_lock(&(cache->heap), cacheEntry->heapHandleIndex, &(cacheEntry->data))) {
+            // CE: Entry is still unreferenced, put it back (in case it was
+            // taken out above).
+            if (cacheEntry->evictionQueueIndex == -1) {
+                cache_eviction_queue_push(cache, cacheEntry);
+            }
             return false;
         }
+
+        // Referenced entries cannot be evicted.
+        cache_eviction_queue_remove(cache, cacheEntry);
     }
 
     cacheEntry->referenceCount++;
@@ -169,6 +213,7 @@ bool cache_unlock(Cache* cache, CacheEntry* cacheEntry)
 
     if (cacheEntry->referenceCount == 0) {
         heap_unlock(&(cache->heap), cacheEntry->heapHandleIndex);
+        cache_eviction_queue_push(cache, cacheEntry);
     }
 
     return true;
@@ -193,9 +238,7 @@ int cache_discard(Cache* cache, int key)
         return 0;
     }
 
-    cacheEntry->flags |= CACHE_ENTRY_MARKED_FOR_EVICTION;
-
-    cache_purge(cache);
+    cache_remove(cache, cacheEntry);
 
     return 1;
 }
@@ -424,19 +467,10 @@ static bool cache_add(Cache* cache, int key, int* indexPtr)
             cacheEntry->size = size;
             cacheEntry->key = key;
 
-            bool isNewKey = true;
-            if (*indexPtr < cache->entriesLength) {
-                if (key < cache->entries[*indexPtr]->key) {
-                    if (*indexPtr == 0 || key > cache->entries[*indexPtr - 1]->key) {
-                        isNewKey = false;
-                    }
-                }
-            }
-
-            if (isNewKey) {
-                if (cache_find(cache, key, indexPtr) != 3) {
-                    break;
-                }
+            // Making room might have evicted some entries, which invalidates
+            // insertion point.
+            if (cache_find(cache, key, indexPtr) != 3) {
+                break;
             }
 
             if (!cache_insert(cache, cacheEntry, *indexPtr)) {
@@ -465,13 +499,25 @@ static bool cache_insert(Cache* cache, CacheEntry* cacheEntry, int index)
         }
     }
 
-    // Move entries below insertion point.
-    memmove(&(cache->entries[index + 1]), &(cache->entries[index]), sizeof(*cache->entries) * (cache->entriesLength - index));
+    // Entries are unordered, move entry at insertion point to the end.
+    if (index != cache->entriesLength) {
+        CacheEntry* movedEntry = cache->entries[index];
+        cache->entries[cache->entriesLength] = movedEntry;
+        movedEntry->entriesIndex = cache->entriesLength;
+    }
 
     cache->entries[index] = cacheEntry;
+    cacheEntry->entriesIndex = index;
     cache->entriesLength++;
     cache->size += cacheEntry->size;
 
+    cache_index_insert(cache, cacheEntry);
+
+    cacheEntry->evictionQueueIndex = -1;
+    if (cacheEntry->referenceCount == 0) {
+        cache_eviction_queue_push(cache, cacheEntry);
+    }
+
     return true;
 }
 
@@ -483,42 +529,45 @@ static bool cache_insert(Cache* cache, CacheEntry* cacheEntry, int index)
 // 0x41F354
 static int cache_find(Cache* cache, int key, int* indexPtr)
 {
-    int length = cache->entriesLength;
-    if (length == 0) {
-        *indexPtr = 0;
-        return 3;
-    }
-
-    int r = length - 1;
-    int l = 0;
-    int mid;
-    int cmp;
-
-    do {
-        mid = (l + r) / 2;
+    unsigned int mask = cache->indexCapacity - 1;
+    unsigned int slot = cache_hash(key, cache->indexCapacity);
 
-        cmp = key - cache->entries[mid]->key;
-        if (cmp == 0) {
-            *indexPtr = mid;
+    while (cache->index[slot] != NULL) {
+        CacheEntry* cacheEntry = cache->index[slot];
+        if (cacheEntry->key == key) {
+            *indexPtr = cacheEntry->entriesIndex;
             return 2;
         }
 
-        if (cmp > 0) {
-            l = l + 1;
-        } else {
-            r = r - 1;
-        }
-    } while (r >= l);
-
-    if (cmp < 0) {
-        *indexPtr = mid;
-    } else {
-        *indexPtr = mid + 1;
+        slot = (slot + 1) & mask;
     }
 
+    *indexPtr = cache->entriesLength;
+
     return 3;
 }
 
+// Removes unreferenced entry from the cache and destroys it.
+static void cache_remove(Cache* cache, CacheEntry* cacheEntry)
+{
+    cache_index_remove(cache, cacheEntry);
+    cache_eviction_queue_remove(cache, cacheEntry);
+
+    // Fill the gap with the last entry.
+    int index = cacheEntry->entriesIndex;
+    cache->entriesLength--;
+    if (index != cache->entriesLength) {
+        CacheEntry* movedEntry = cache->entries[cache->entriesLength];
+        cache->entries[index] = movedEntry;
+        movedEntry->entriesIndex = index;
+    }
+
+    cache->size -= cacheEntry->size;
+
+    // NOTE: Uninline.
+    cache_destroy_item(cache, cacheEntry);
+}
+
 // 0x41F3C0
 static int cache_create_item(CacheEntry** cacheEntryPtr)
 {
@@ -543,6 +592,8 @@ static bool cache_init_item(CacheEntry* cacheEntry)
     cacheEntry->hits = 0;
     cacheEntry->flags = 0;
     cacheEntry->mru = 0;
+    cacheEntry->entriesIndex = -1;
+    cacheEntry->evictionQueueIndex = -1;
     return true;
 }
 
@@ -571,6 +622,7 @@ static bool cache_unlock_all(Cache* cache)
         if (cacheEntry->referenceCount != 0) {
             heap_unlock(heap, cacheEntry->heapHandleIndex);
             cacheEntry->referenceCount = 0;
+            cache_eviction_queue_push(cache, cacheEntry);
         }
     }
 
@@ -600,7 +652,10 @@ static bool cache_reset_counter(Cache* cache)
 
     cache->hits = cache->entriesLength;
 
-    // FIXME: Obviously leak `entries`.
+    mem_free(entries);
+
+    // Eviction order depends on `mru`.
+    cache_eviction_queue_rebuild(cache);
 
     return true;
 }
@@ -621,60 +676,54 @@ static bool cache_make_room(Cache* cache, int size)
         return true;
     }
 
-    CacheEntry** entries = (CacheEntry**)mem_malloc(sizeof(*entries) * cache->entriesLength);
-    if (entries != NULL) {
-        memcpy(entries, cache->entries, sizeof(*entries) * cache->entriesLength);
-        qsort(entries, cache->entriesLength, sizeof(*entries), cache_compare_make_room);
-
-        // The sweeping threshold is 20% of cache size plus size for the new
-        // entry. Once the threshold is reached the marking process stops.
-        int threshold = size + (int)((double)cache->size * 0.2);
-
-        int accum = 0;
-        int index;
-        for (index = 0; index < cache->entriesLength; index++) {
-            CacheEntry* entry = entries[index];
-            if (entry->referenceCount == 0) {
-                if (entry->size >= threshold) {
-                    entry->flags |= CACHE_ENTRY_MARKED_FOR_EVICTION;
-
-                    // We've just found one huge entry, there is no point to
-                    // mark individual smaller entries in the code path below,
-                    // reset the accumulator to skip it entirely.
-                    accum = 0;
-                    break;
-                } else {
-                    accum += entry->size;
-
-                    if (accum >= threshold) {
-                        break;
-                    }
-                }
-            }
+    // The sweeping threshold is 20% of cache size plus size for the new
+    // entry. Once the threshold is reached the marking process stops.
+    int threshold = size + (int)((double)cache->size * 0.2);
+
+    // Take unreferenced entries from the eviction queue, least valuable
+    // first, until enough space is accumulated. Taken entries are parked at
+    // the end of the queue storage, which is never reached by the queue
+    // itself, because it cannot be longer than `entriesLength`.
+    CacheEntry** taken = cache->evictionQueue + cache->entriesCapacity;
+    int takenLength = 0;
+    CacheEntry* hugeEntry = NULL;
+    int accum = 0;
+    while (cache->evictionQueueLength > 0) {
+        CacheEntry* entry = cache->evictionQueue[0];
+        cache_eviction_queue_remove(cache, entry);
+
+        if (entry->size >= threshold) {
+            // We've just found one huge entry, there is no point to evict
+            // individual smaller entries taken so far.
+            hugeEntry = entry;
+            accum = 0;
+            break;
         }
 
-        if (accum != 0) {
-            // The loop below assumes index to be positioned on the entry, where
-            // accumulator stopped. If we've reached the end, reposition
-            // it to the last entry.
-            if (index == cache->entriesLength) {
-                index -= 1;
-            }
+        takenLength++;
+        *(taken - takenLength) = entry;
 
-            // Loop backwards from the point we've stopped and mark all
-            // unreferenced entries for sweeping.
-            for (; index >= 0; index--) {
-                CacheEntry* entry = entries[index];
-                if (entry->referenceCount == 0) {
-                    entry->flags |= CACHE_ENTRY_MARKED_FOR_EVICTION;
-                }
-            }
+        accum += entry->size;
+        if (accum >= threshold) {
+            break;
         }
+    }
 
-        mem_free(entries);
+    if (accum != 0) {
+        for (int index = 1; index <= takenLength; index++) {
+            cache_remove(cache, *(taken - index));
+        }
+    } else {
+        // Return entries in reverse order, so that growing queue never
+        // overwrites parked entries which are yet to be returned.
+        for (int index = takenLength; index >= 1; index--) {
+            cache_eviction_queue_push(cache, *(taken - index));
+        }
     }
 
-    cache_purge(cache);
+    if (hugeEntry != NULL) {
+        cache_remove(cache, hugeEntry);
+    }
 
     if (cache->maxSize - cache->size >= size) {
         return true;
@@ -694,18 +743,9 @@ static bool cache_purge(Cache* cache)
                 // unmark it.
                 cacheEntry->flags &= ~CACHE_ENTRY_MARKED_FOR_EVICTION;
             } else {
-                int cacheEntrySize = cacheEntry->size;
-
-                // NOTE: Uninline.
-                cache_destroy_item(cache, cacheEntry);
-
-                // Move entries up.
-                memmove(&(cache->entries[index]), &(cache->entries[index + 1]), sizeof(*cache->entries) * ((cache->entriesLength - index) - 1));
-
-                cache->entriesLength--;
-                cache->size -= cacheEntrySize;
-
-                // The entry was removed, compensate index.
+                // Last entry is moved into removed entry's place, compensate
+                // index to check it.
+                cache_remove(cache, cacheEntry);
                 index--;
             }
         }
@@ -727,8 +767,22 @@ static bool cache_resize_array(Cache* cache, int newCapacity)
     }
 
     cache->entries = entries;
+
+    CacheEntry** evictionQueue = (CacheEntry**)mem_realloc(cache->evictionQueue, sizeof(*cache->evictionQueue) * newCapacity);
+    if (evictionQueue == NULL) {
+        return false;
+    }
+
+    cache->evictionQueue = evictionQueue;
     cache->entriesCapacity = newCapacity;
 
+    // Keep hash index load factor at 50% or less.
+    if (newCapacity * 2 > cache->indexCapacity) {
+        if (!cache_index_resize(cache, newCapacity)) {
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -776,4 +830,168 @@ static int cache_compare_reset_counter(const void* a1, const void* a2)
     }
 }
 
+static unsigned int cache_hash(int key, int capacity)
+{
+    unsigned int hash = (unsigned int)key * 0x9E3779B1;
+    hash ^= hash >> 16;
+    return hash & (capacity - 1);
+}
+
+// Rebuilds hash index to accommodate given number of entries.
+static bool cache_index_resize(Cache* cache, int newCapacity)
+{
+    int indexCapacity = 16;
+    while (indexCapacity < newCapacity * 2) {
+        indexCapacity *= 2;
+    }
+
+    CacheEntry** index = (CacheEntry**)mem_malloc(sizeof(*index) * indexCapacity);
+    if (index == NULL) {
+        return false;
+    }
+
+    memset(index, 0, sizeof(*index) * indexCapacity);
+
+    if (cache->index != NULL) {
+        mem_free(cache->index);
+    }
+
+    cache->index = index;
+    cache->indexCapacity = indexCapacity;
+
+    for (int entryIndex = 0; entryIndex < cache->entriesLength; entryIndex++) {
+        cache_index_insert(cache, cache->entries[entryIndex]);
+    }
+
+    return true;
+}
+
+static void cache_index_insert(Cache* cache, CacheEntry* cacheEntry)
+{
+    unsigned int mask = cache->indexCapacity - 1;
+    unsigned int slot = cache_hash(cacheEntry->key, cache->indexCapacity);
+    while (cache->index[slot] != NULL) {
+        slot = (slot + 1) & mask;
+    }
+
+    cache->index[slot] = cacheEntry;
+}
+
+static void cache_index_remove(Cache* cache, CacheEntry* cacheEntry)
+{
+    unsigned int mask = cache->indexCapacity - 1;
+    unsigned int slot = cache_hash(cacheEntry->key, cache->indexCapacity);
+    while (cache->index[slot] != cacheEntry) {
+        if (cache->index[slot] == NULL) {
+            return;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    // Shift following entries of the probe sequence back to fill the gap,
+    // so that lookups never stop at it.
+    unsigned int hole = slot;
+    unsigned int next = (slot + 1) & mask;
+    while (cache->index[next] != NULL) {
+        unsigned int home = cache_hash(cache->index[next]->key, cache->indexCapacity);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            cache->index[hole] = cache->index[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    cache->index[hole] = NULL;
+}
+
+static void cache_eviction_queue_push(Cache* cache, CacheEntry* cacheEntry)
+{
+    int index = cache->evictionQueueLength;
+    cache->evictionQueueLength++;
+
+    cache->evictionQueue[index] = cacheEntry;
+    cacheEntry->evictionQueueIndex = index;
+
+    cache_eviction_queue_sift_up(cache, index);
+}
+
+static void cache_eviction_queue_remove(Cache* cache, CacheEntry* cacheEntry)
+{
+    int index = cacheEntry->evictionQueueIndex;
+    if (index == -1) {
+        return;
+    }
+
+    cacheEntry->evictionQueueIndex = -1;
+
+    cache->evictionQueueLength--;
+    if (index == cache->evictionQueueLength) {
+        return;
+    }
+
+    CacheEntry* lastEntry = cache->evictionQueue[cache->evictionQueueLength];
+    cache->evictionQueue[index] = lastEntry;
+    lastEntry->evictionQueueIndex = index;
+
+    cache_eviction_queue_sift_up(cache, index);
+    cache_eviction_queue_sift_down(cache, lastEntry->evictionQueueIndex);
+}
+
+static void cache_eviction_queue_rebuild(Cache* cache)
+{
+    for (int index = cache->evictionQueueLength / 2 - 1; index >= 0; index--) {
+        cache_eviction_queue_sift_down(cache, index);
+    }
+}
+
+static void cache_eviction_queue_sift_up(Cache* cache, int index)
+{
+    CacheEntry** queue = cache->evictionQueue;
+    CacheEntry* cacheEntry = queue[index];
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (cache_compare_make_room(&cacheEntry, &(queue[parent])) >= 0) {
+            break;
+        }
+
+        queue[index] = queue[parent];
+        queue[index]->evictionQueueIndex = index;
+        index = parent;
+    }
+
+    queue[index] = cacheEntry;
+    cacheEntry->evictionQueueIndex = index;
+}
+
+static void cache_eviction_queue_sift_down(Cache* cache, int index)
+{
+    CacheEntry** queue = cache->evictionQueue;
+    CacheEntry* cacheEntry = queue[index];
+    int length = cache->evictionQueueLength;
+
+    while (1) {
+        int child = index * 2 + 1;
+        if (child >= length) {
+            break;
+        }
+
+        if (child + 1 < length && cache_compare_make_room(&(queue[child + 1]), &(queue[child])) < 0) {
+            child++;
+        }
+
+        if (cache_compare_make_room(&(queue[child]), &cacheEntry) >= 0) {
+            break;
+        }
+
+        queue[index] = queue[child];
+        queue[index]->evictionQueueIndex = index;
+        index = child;
+    }
+
+    queue[index] = cacheEntry;
+    cacheEntry->evictionQueueIndex = index;
+}
+
 } // namespace fallout
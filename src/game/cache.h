@@ -48,6 +48,13 @@ typedef struct CacheEntry {
     unsigned int mru;
 
     int heapHandleIndex;
+
+    // Position of this entry in `entries` array of it's cache.
+    int entriesIndex;
+
+    // Position of this entry in eviction queue of it's cache, or -1 if entry
+    // is referenced and cannot be evicted.
+    int evictionQueueIndex;
 } CacheEntry;
 
 typedef struct Cache {
@@ -66,9 +73,23 @@ typedef struct Cache {
     // Total number of hits during cache lifetime.
     unsigned int hits;
 
-    // List of cache entries.
+    // List of cache entries (unordered).
     CacheEntry** entries;
 
+    // Open-addressing hash table of `entries` by key. Empty slots are `NULL`.
+    CacheEntry** index;
+
+    // The capacity of `index` array, always a power of two.
+    int indexCapacity;
+
+    // Binary min-heap of unreferenced entries, the least valuable entry
+    // (fewest hits, then least recently used) is at the top. Has the same
+    // capacity as `entries` array.
+    CacheEntry** evictionQueue;
+
+    // The length of `evictionQueue` array.
+    int evictionQueueLength;
+
     CacheSizeProc* sizeProc;
     CacheReadProc* readProc;
     CacheFreeProc* freeProc;
@@ -6,6 +6,7 @@
 
 #include "game/actions.h"
 #include "game/anim.h"
+#include "game/benchmark.h"
 #include "game/combat.h"
 #include "game/config.h"
 #include "game/critter.h"
@@ -1196,10 +1197,13 @@ Object* combat_ai(Object* critter, Object* target)
     combatData = &(critter->data.critter.combat);
     ai = ai_cap(critter);
 
+    int previousPhase = benchmark_phase_enter(BENCHMARK_PHASE_AI);
+
     if ((combatData->maneuver & CRITTER_MANUEVER_FLEEING) != 0
         || (combatData->results & ai->hurt_too_much) != 0
         || stat_level(critter, STAT_CURRENT_HIT_POINTS) < ai->min_hp) {
         ai_run_away(critter);
+        benchmark_phase_leave(previousPhase);
         return target;
     }
 
@@ -1245,6 +1249,8 @@ Object* combat_ai(Object* critter, Object* target)
         }
     }
 
+    benchmark_phase_leave(previousPhase);
+
     return target;
 }
 
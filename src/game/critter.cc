@@ -765,6 +765,7 @@ void critter_kill(Object* critter, int anim, bool refresh_window)
 
     if (critter->pid != 16777265 && critter->pid != 16777266 && critter->pid != 16777224) {
         critter->flags |= OBJECT_NO_BLOCK;
+        obj_blocking_invalidate(critter->elevation);
         if ((critter->flags & OBJECT_FLAT) == 0) {
             obj_toggle_flat(critter, &tempRect);
         }
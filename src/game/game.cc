@@ -6,6 +6,7 @@
 #include "game/actions.h"
 #include "game/anim.h"
 #include "game/automap.h"
+#include "game/benchmark.h"
 #include "game/bmpdlog.h"
 #include "game/combat.h"
 #include "game/combatai.h"
@@ -57,6 +58,7 @@
 #include "plib/gnw/memory.h"
 #include "plib/gnw/svga.h"
 #include "plib/gnw/text.h"
+#include "profiler.h"
 
 namespace fallout {
 
@@ -137,6 +139,10 @@ int game_init(const char* windowTitle, bool isMapper, int font, int flags, int a
 
     game_in_mapper = isMapper;
 
+    // CE: Benchmark mode needs fixed clock and headless audio before any of
+    // the subsystems below start.
+    benchmark_init();
+
     if (game_init_databases() == -1) {
         gconfig_exit(false);
         return -1;
@@ -149,6 +155,7 @@ int game_init(const char* windowTitle, bool isMapper, int font, int flags, int a
     video_options.height = 480;
     video_options.fullscreen = true;
     video_options.scale = 1;
+    video_options.headless = benchmark_is_active();
 
     Config resolutionConfig;
     if (config_init(&resolutionConfig)) {
@@ -180,7 +187,14 @@ int game_init(const char* windowTitle, bool isMapper, int font, int flags, int a
 
     tweaks_init();
 
+    // CE: Frame profiler is configured in tweaks.ini.
+    profilerInit(tweaks_profiler_output());
+    if (tweaks_profiler_enabled()) {
+        profilerStart();
+    }
+
     initWindow(&video_options, flags);
+    win_set_show_repaints(tweaks_show_repaints());
     palette_init();
 
     if (!game_in_mapper) {
@@ -192,6 +206,7 @@ int game_init(const char* windowTitle, bool isMapper, int font, int flags, int a
     text_font(font);
 
     register_screendump(KEY_F12, game_screendump);
+    register_profiler_key(tweaks_profiler_key() != 0 ? tweaks_profiler_key() : -1);
     register_pause(-1, NULL);
 
     tile_disable_refresh();
@@ -424,13 +439,18 @@ void game_exit()
     FMExit();
     windowClose();
     db_exit();
+    profilerExit();
     tweaks_exit();
-    gconfig_exit(true);
+
+    // CE: Do not persist benchmark settings given on the command line.
+    gconfig_exit(!benchmark_is_active());
 }
 
 // 0x43B748
 int game_handle_input(int eventCode, bool isInCombatMode)
 {
+    ProfilerZone zone("game_handle_input");
+
     // NOTE: Uninline.
     if (game_state() == GAME_STATE_5) {
         dialogue_system_enter();
@@ -1227,10 +1247,12 @@ int game_quit_with_confirm()
 static int game_init_databases()
 {
     int hashing;
+    int mmap_enabled;
     char* main_file_name;
     char* patch_file_name;
 
     hashing = 0;
+    mmap_enabled = 0;
     main_file_name = NULL;
     patch_file_name = NULL;
 
@@ -1238,6 +1260,11 @@ static int game_init_databases()
         db_enable_hash_table();
     }
 
+    // CE: Serve DAT entries from a memory mapping unless disabled.
+    if (config_get_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_MMAP_KEY, &mmap_enabled) && mmap_enabled != 0) {
+        db_enable_mmap();
+    }
+
     config_get_string(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_MASTER_DAT_KEY, &main_file_name);
     if (*main_file_name == '\0') {
         main_file_name = NULL;
@@ -1323,6 +1350,11 @@ static void game_splash_screen()
 
     int splashWindowX = (screenGetWidth() - SPLASH_WIDTH) / 2;
     int splashWindowY = (screenGetHeight() - SPLASH_HEIGHT) / 2;
+
+    // CE: Paint pending window changes first, otherwise they would cover
+    // splash on the next present.
+    win_compose();
+
     scr_blit(data, SPLASH_WIDTH, SPLASH_HEIGHT, 0, 0, SPLASH_WIDTH, SPLASH_HEIGHT, splashWindowX, splashWindowY);
     palette_fade_to(palette);
 
@@ -13,6 +13,7 @@ namespace fallout {
 #define GAME_CONFIG_SOUND_KEY "sound"
 #define GAME_CONFIG_MAPPER_KEY "mapper"
 #define GAME_CONFIG_DEBUG_KEY "debug"
+#define GAME_CONFIG_BENCHMARK_KEY "benchmark"
 
 #define GAME_CONFIG_EXECUTABLE_KEY "executable"
 #define GAME_CONFIG_MASTER_DAT_KEY "master_dat"
@@ -27,6 +28,8 @@ namespace fallout {
 #define GAME_CONFIG_COLOR_CYCLING_KEY "color_cycling"
 #define GAME_CONFIG_CYCLE_SPEED_FACTOR_KEY "cycle_speed_factor"
 #define GAME_CONFIG_HASHING_KEY "hashing"
+#define GAME_CONFIG_MMAP_KEY "mmap"
+#define GAME_CONFIG_PACKED_SAVES_KEY "packed_saves"
 #define GAME_CONFIG_SPLASH_KEY "splash"
 #define GAME_CONFIG_FREE_SPACE_KEY "free_space"
 #define GAME_CONFIG_TIMES_RUN_KEY "times_run"
@@ -81,6 +84,9 @@ namespace fallout {
 #define GAME_CONFIG_RUN_MAPPER_AS_GAME_KEY "run_mapper_as_game"
 #define GAME_CONFIG_DEFAULT_F8_AS_GAME_KEY "default_f8_as_game"
 #define GAME_CONFIG_PLAYER_SPEEDUP_KEY "player_speedup"
+#define GAME_CONFIG_BENCHMARK_SELFRUN_KEY "selfrun"
+#define GAME_CONFIG_BENCHMARK_OUTPUT_KEY "output"
+#define GAME_CONFIG_BENCHMARK_STEP_KEY "step"
 
 #define ENGLISH "english"
 #define FRENCH "french"
@@ -4,6 +4,7 @@
 #include <string.h>
 
 #include "game/anim.h"
+#include "game/benchmark.h"
 #include "game/combat.h"
 #include "game/gconfig.h"
 #include "game/item.h"
@@ -717,6 +718,10 @@ int gsound_background_play(const char* fileName, int a2, int a3, int a4)
         return -1;
     }
 
+    // CE: Music is read from plain files (not `db`), so it can be refilled on
+    // the streaming thread.
+    soundSetThreadedIO(gsound_background_tag, true);
+
     if (a4 == 16) {
         rc = soundLoop(gsound_background_tag, 0xFFFF);
         if (rc != SOUND_NO_ERROR) {
@@ -1025,6 +1030,12 @@ int gsound_speech_play(const char* fname, int a2, int a3, int a4, const char* ba
         return -1;
     }
 
+    // CE: ACM speech is read through `db`, only MP3 speech is read from plain
+    // files and can be refilled on the streaming thread.
+    if (gsound_speech_is_mp3) {
+        soundSetThreadedIO(gsound_speech_tag, true);
+    }
+
     if (a4 == 16) {
         if (soundLoop(gsound_speech_tag, 0xFFFF)) {
             if (gsound_debug) {
@@ -1649,7 +1660,9 @@ int gsound_play_sfx_file(const char* name)
 // 0x44932C
 static void gsound_bkg_proc()
 {
+    int previousPhase = benchmark_phase_enter(BENCHMARK_PHASE_AUDIO);
     soundUpdate();
+    benchmark_phase_leave(previousPhase);
 }
 
 // 0x449334
@@ -1,5 +1,7 @@
 #include "game/light.h"
 
+#include <unordered_map>
+
 #include "game/map_defs.h"
 #include "game/object.h"
 #include "game/perk.h"
@@ -13,6 +15,9 @@ static int ambient_light = LIGHT_LEVEL_MAX;
 // 0x59CF1C
 static int tile_intensity[ELEVATION_COUNT][HEX_GRID_SIZE];
 
+// Light sources currently applied to `tile_intensity`.
+static std::unordered_map<Object*, LightSource> light_sources;
+
 // 0x46CA70
 int light_init()
 {
@@ -164,6 +169,49 @@ void light_reset_tiles()
             tile_intensity[elevation][tile] = 655;
         }
     }
+
+    light_sources.clear();
+}
+
+// Applies light source contributions and remembers them on behalf of
+// `owner`. The contents of `source` are moved away.
+void light_add_source(Object* owner, LightSource* source)
+{
+    for (const LightContribution& contribution : source->contributions) {
+        light_add_to_tile(source->elevation, contribution.tile, contribution.intensity);
+    }
+
+    light_sources[owner] = std::move(*source);
+}
+
+// Takes back everything `owner` has added with `light_add_source`. Returns
+// `false` if it has no light applied. Removed source is moved to `source`
+// unless it's NULL.
+bool light_remove_source(Object* owner, LightSource* source)
+{
+    auto it = light_sources.find(owner);
+    if (it == light_sources.end()) {
+        return false;
+    }
+
+    for (const LightContribution& contribution : it->second.contributions) {
+        light_subtract_from_tile(it->second.elevation, contribution.tile, contribution.intensity);
+    }
+
+    if (source != NULL) {
+        *source = std::move(it->second);
+    }
+
+    light_sources.erase(it);
+
+    return true;
+}
+
+// Drops record of `owner` light without touching tiles. Should be called when
+// object is freed so that its address can be reused.
+void light_forget_source(Object* owner)
+{
+    light_sources.erase(owner);
 }
 
 } // namespace fallout
@@ -1,6 +1,11 @@
 #ifndef FALLOUT_GAME_LIGHT_H_
 #define FALLOUT_GAME_LIGHT_H_
 
+#include <vector>
+
+#include "game/object_types.h"
+#include "plib/gnw/rect.h"
+
 namespace fallout {
 
 #define LIGHT_LEVEL_MAX 65536
@@ -11,6 +16,24 @@ namespace fallout {
 
 typedef void(AdjustLightIntensityProc)(int elevation, int tile, int intensity);
 
+typedef struct LightContribution {
+    int tile;
+    int intensity;
+} LightContribution;
+
+// Everything a light source has added to `tile_intensity`, so it can be taken
+// back without tracing the light again.
+typedef struct LightSource {
+    int elevation;
+    int tile;
+    int distance;
+
+    // Bounds of lit objects relative to the screen position of `tile`.
+    Rect bounds;
+
+    std::vector<LightContribution> contributions;
+} LightSource;
+
 int light_init();
 void light_reset();
 void light_exit();
@@ -24,6 +47,9 @@ void light_set_tile(int elevation, int tile, int intensity);
 void light_add_to_tile(int elevation, int tile, int intensity);
 void light_subtract_from_tile(int elevation, int tile, int intensity);
 void light_reset_tiles();
+void light_add_source(Object* owner, LightSource* source);
+bool light_remove_source(Object* owner, LightSource* source);
+void light_forget_source(Object* owner);
 
 } // namespace fallout
 
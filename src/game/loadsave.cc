@@ -6,6 +6,9 @@
 #include <time.h>
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
 
 #include "game/automap.h"
 #include "game/bmpdlog.h"
@@ -22,6 +25,7 @@
 #include "game/gsound.h"
 #include "game/intface.h"
 #include "game/item.h"
+#include "game/lspack.h"
 #include "game/map.h"
 #include "game/object.h"
 #include "game/options.h"
@@ -64,6 +68,12 @@ namespace fallout {
 #define LS_PREVIEW_HEIGHT 133
 #define LS_PREVIEW_SIZE ((LS_PREVIEW_WIDTH) * (LS_PREVIEW_HEIGHT))
 
+// Size of save file header (including thumbnail) read by `LoadHeader`.
+#define LS_HEADER_SIZE (131 + LS_PREVIEW_SIZE + 128)
+
+#define LS_PACK_FILE_NAME "SLOT.PAK"
+#define LS_PACK_BACKUP_FILE_NAME "SLOT.PBK"
+
 #define LS_COMMENT_WINDOW_X 169
 #define LS_COMMENT_WINDOW_Y 116
 
@@ -127,6 +137,16 @@ typedef enum LoadSaveFrm {
     LOAD_SAVE_FRM_COUNT,
 } LoadSaveFrm;
 
+// Copy of a single file between save slot and game.
+typedef struct LoadSaveCopyJob {
+    char source[COMPAT_MAX_PATH];
+    char dest[COMPAT_MAX_PATH];
+    int rc;
+} LoadSaveCopyJob;
+
+// Maximum number of threads copying map files.
+#define LOAD_SAVE_COPY_MAX_THREADS 4
+
 static int QuickSnapShot();
 static int LSGameStart(int windowType);
 static int LSGameEnd(int windowType);
@@ -148,6 +168,12 @@ static int GameMap2Slot(DB_FILE* stream);
 static int SlotMap2Game(DB_FILE* stream);
 static int mygets(char* dest, DB_FILE* stream);
 static int copy_file(const char* a1, const char* a2);
+static int copy_files(std::vector<LoadSaveCopyJob>& jobs);
+static void copy_files_worker(std::vector<LoadSaveCopyJob>* jobs, std::atomic<size_t>* next);
+static void add_copy_job(std::vector<LoadSaveCopyJob>& jobs, const char* source, const char* dest);
+static int SavePack();
+static void add_pack_source(std::vector<LsPackSource>& sources, const char* name, const char* path, int offset, int length, bool compress);
+static DB_FILE* OpenPackedSave(int slot, bool headerOnly, unsigned char** dataPtr);
 static int SaveBackup();
 static int RestoreSave();
 static int LoadObjDudeCid(DB_FILE* stream);
@@ -185,6 +211,18 @@ static int automap_db_flag = 0;
 // 0x505970
 static char* patches = NULL;
 
+// CE: Whether slot being saved is packed (see `SavePack`).
+static bool save_packed = false;
+
+// CE: Files `GameMap2Slot` leaves for `SavePack`.
+static std::vector<LoadSaveCopyJob> save_packed_files;
+
+// CE: Whether `SaveBackup` has backed up slot pack.
+static int pack_backup_flag = 0;
+
+// CE: Whether slot being loaded is packed.
+static bool load_packed = false;
+
 // 0x505974
 static char emgpath[] = "\\FALLOUT\\CD\\DATA\\SAVEGAME";
 
@@ -1510,6 +1548,19 @@ static int SaveSlot()
 
     gsound_background_pause();
 
+    // CE: Maps of a packed slot that was loaded earlier might still be in
+    // that slot's pack, which is about to be replaced.
+    if (lspack_extract_all_deferred() == -1) {
+        debug_printf("\nLOADSAVE: ** Error extracting maps from save slot pack! **\n");
+        gsound_background_unpause();
+        return -1;
+    }
+
+    int packedSaves = 0;
+    config_get_value(&game_config, GAME_CONFIG_SYSTEM_KEY, GAME_CONFIG_PACKED_SAVES_KEY, &packedSaves);
+    save_packed = packedSaves != 0;
+    save_packed_files.clear();
+
     snprintf(gmpath, sizeof(gmpath), "%s\\%s", patches, "SAVEGAME");
     compat_mkdir(gmpath);
 
@@ -1570,8 +1621,28 @@ static int SaveSlot()
 
     db_fclose(flptr);
 
+    // CE: Pack slot, or put files in place as usual if that fails.
+    if (save_packed) {
+        if (SavePack() == -1) {
+            debug_printf("\nLOADSAVE: Warning, can't pack save slot!\n");
+            if (copy_files(save_packed_files) == -1) {
+                debug_printf("\nLOADSAVE: ** Error copying map files to save slot! **\n");
+                save_packed_files.clear();
+                RestoreSave();
+                snprintf(gmpath, sizeof(gmpath), "%s\\%s%.2d\\", "SAVEGAME", "SLOT", slot_cursor + 1);
+                MapDirErase(gmpath, "BAK");
+                partyMemberUnPrepSave();
+                gsound_background_unpause();
+                return -1;
+            }
+        }
+
+        save_packed_files.clear();
+    }
+
     snprintf(gmpath, sizeof(gmpath), "%s\\%s%.2d\\", "SAVEGAME", "SLOT", slot_cursor + 1);
     MapDirErase(gmpath, "BAK");
+    MapDirEraseFile(gmpath, LS_PACK_BACKUP_FILE_NAME);
 
     lsgmesg.num = 140;
     if (message_search(&lsgame_msgfl, &lsgmesg)) {
@@ -1610,17 +1681,29 @@ static int LoadSlot(int slot)
     LoadSaveSlotData* ptr = &(LSData[slot]);
     debug_printf("\nLOADSAVE: Load name: %s\n", ptr->description);
 
+    // CE: Slot without SAVE.DAT might be packed.
+    unsigned char* packedData = NULL;
+
     flptr = db_fopen(gmpath, "rb");
+    if (flptr == NULL) {
+        flptr = OpenPackedSave(slot_cursor, false, &packedData);
+    }
+
     if (flptr == NULL) {
         debug_printf("\nLOADSAVE: ** Error opening load game file for reading! **\n");
         loadingGame = 0;
         return -1;
     }
 
+    load_packed = packedData != NULL;
+
     long pos = db_ftell(flptr);
     if (LoadHeader(slot) == -1) {
         debug_printf("\nLOADSAVE: ** Error reading save  game header! **\n");
         db_fclose(flptr);
+        if (packedData != NULL) {
+            mem_free(packedData);
+        }
         game_reset();
         loadingGame = 0;
         return -1;
@@ -1636,6 +1719,9 @@ static int LoadSlot(int slot)
             int v12 = db_ftell(flptr);
             debug_printf("LOADSAVE: Load function #%d data size read: %d bytes.\n", index, db_ftell(flptr) - pos);
             db_fclose(flptr);
+            if (packedData != NULL) {
+                mem_free(packedData);
+            }
             game_reset();
             loadingGame = 0;
             return -1;
@@ -1646,6 +1732,9 @@ static int LoadSlot(int slot)
 
     debug_printf("LOADSAVE: Total load data read: %ld bytes.\n", db_ftell(flptr));
     db_fclose(flptr);
+    if (packedData != NULL) {
+        mem_free(packedData);
+    }
 
     snprintf(str, sizeof(str), "%s\\", "MAPS");
     MapDirErase(str, "BAK");
@@ -1880,10 +1969,27 @@ static int GetSlotList()
     for (; index < 10; index += 1) {
         snprintf(str, sizeof(str), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", index + 1, "SAVE.DAT");
 
+        // CE: Slot without SAVE.DAT might be packed.
+        bool packed = false;
+        unsigned char* packedData = NULL;
+        if (db_dir_entry(str, &de) != 0) {
+            snprintf(str, sizeof(str), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", index + 1, LS_PACK_FILE_NAME);
+            packed = true;
+        }
+
         if (db_dir_entry(str, &de) != 0) {
             LSstatus[index] = SLOT_STATE_EMPTY;
         } else {
-            flptr = db_fopen(str, "rb");
+            if (packed) {
+                flptr = OpenPackedSave(index, true, &packedData);
+                if (flptr == NULL) {
+                    debug_printf("LOADSAVE: ** Save file #%d corrupt! **", index);
+                    LSstatus[index] = SLOT_STATE_ERROR;
+                    continue;
+                }
+            } else {
+                flptr = db_fopen(str, "rb");
+            }
 
             if (flptr == NULL) {
                 debug_printf("\nLOADSAVE: ** Error opening save  game for reading! **\n");
@@ -1903,6 +2009,10 @@ static int GetSlotList()
             }
 
             db_fclose(flptr);
+
+            if (packedData != NULL) {
+                mem_free(packedData);
+            }
         }
     }
     return index;
@@ -2032,6 +2142,19 @@ static int LoadTumbSlot(int a1)
 
         stream = db_fopen(str, "rb");
         if (stream == NULL) {
+            // CE: Thumbnail of a packed slot is read straight from its
+            // header chunk, which is never compressed.
+            snprintf(str, sizeof(str), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot_cursor + 1, LS_PACK_FILE_NAME);
+            LsPack* pack = lspack_open(str);
+            if (pack != NULL) {
+                int rc = lspack_read_chunk_part(pack, "SAVE.HDR", 131, thumbnail_image[0], LS_PREVIEW_SIZE);
+                lspack_close(pack);
+
+                if (rc != -1) {
+                    return 0;
+                }
+            }
+
             debug_printf("\nLOADSAVE: ** (A) Error reading thumbnail #%d! **\n", a1);
             return -1;
         }
@@ -2319,10 +2442,14 @@ static int GameMap2Slot(DB_FILE* stream)
         return -1;
     }
 
+    unsigned int start = get_time();
+
     if (map_save_in_game(false) == -1) {
         return -1;
     }
 
+    debug_printf("\nLOADSAVE: Map saved in %u ms.\n", elapsed_time(start));
+
     snprintf(str0, sizeof(str0), "%s\\*.%s", "MAPS", "SAV");
 
     char** fileNameList;
@@ -2353,6 +2480,9 @@ static int GameMap2Slot(DB_FILE* stream)
     strcat(gmpath, str0);
     compat_remove(gmpath);
 
+    // CE: Collect all files first and copy them at once, see `copy_files`.
+    std::vector<LoadSaveCopyJob> jobs;
+
     for (int index = 0; index < fileNameListLength; index += 1) {
         char* string = fileNameList[index];
         if (db_fwrite(string, strlen(string) + 1, 1, stream) == -1) {
@@ -2362,10 +2492,7 @@ static int GameMap2Slot(DB_FILE* stream)
 
         snprintf(str0, sizeof(str0), "%s\\%s", "MAPS", string);
         snprintf(str1, sizeof(str1), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot_cursor + 1, string);
-        if (copy_file(str0, str1) == -1) {
-            db_free_file_list(&fileNameList, NULL);
-            return -1;
-        }
+        add_copy_job(jobs, str0, str1);
     }
 
     db_free_file_list(&fileNameList, NULL);
@@ -2373,9 +2500,16 @@ static int GameMap2Slot(DB_FILE* stream)
     strmfe(str0, "AUTOMAP.DB", "SAV");
     snprintf(str1, sizeof(str1), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot_cursor + 1, str0);
     snprintf(str0, sizeof(str0), "%s\\%s", "MAPS", "AUTOMAP.DB");
+    add_copy_job(jobs, str0, str1);
 
-    if (copy_file(str0, str1) == -1) {
-        return -1;
+    // CE: Packed slot takes files straight from MAPS once save data is
+    // written, see `SavePack`.
+    if (save_packed) {
+        save_packed_files = jobs;
+    } else {
+        if (copy_files(jobs) == -1) {
+            return -1;
+        }
     }
 
     snprintf(str0, sizeof(str0), "%s\\%s", "MAPS", "AUTOMAP.DB");
@@ -2420,9 +2554,25 @@ static int SlotMap2Game(DB_FILE* stream)
         return -1;
     }
 
+    lspack_forget_deferred();
+
     snprintf(str0, sizeof(str0), "%s\\%s\\%s", patches, "MAPS", "AUTOMAP.DB");
     compat_remove(str0);
 
+    // CE: Maps of a packed slot are extracted only when they are loaded (see
+    // `map_load`), so only the current one is extracted right away.
+    LsPack* pack = NULL;
+    if (load_packed) {
+        snprintf(str0, sizeof(str0), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot_cursor + 1, LS_PACK_FILE_NAME);
+        pack = lspack_open(str0);
+        if (pack == NULL) {
+            return -1;
+        }
+    }
+
+    // CE: Collect all files first and copy them at once, see `copy_files`.
+    std::vector<LoadSaveCopyJob> jobs;
+
     for (int index = 0; index < fileNameListLength; index += 1) {
         char fileName[COMPAT_MAX_PATH];
         if (mygets(fileName, stream) == -1) {
@@ -2432,17 +2582,36 @@ static int SlotMap2Game(DB_FILE* stream)
         snprintf(str0, sizeof(str0), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot_cursor + 1, fileName);
         snprintf(str1, sizeof(str1), "%s\\%s", "MAPS", fileName);
 
-        if (copy_file(str0, str1) == -1) {
-            debug_printf("LOADSAVE: returning 7\n");
-            return -1;
+        if (pack != NULL) {
+            if (lspack_defer_chunk(pack, fileName, str1) == -1) {
+                lspack_close(pack);
+                return -1;
+            }
+        } else {
+            add_copy_job(jobs, str0, str1);
         }
     }
 
+    if (copy_files(jobs) == -1) {
+        debug_printf("LOADSAVE: returning 7\n");
+        lspack_close(pack);
+        return -1;
+    }
+
     const char* automapFileName = strmfe(str1, "AUTOMAP.DB", "SAV");
     snprintf(str0, sizeof(str0), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot_cursor + 1, automapFileName);
     snprintf(str1, sizeof(str1), "%s\\%s", "MAPS", "AUTOMAP.DB");
-    if (copy_file(str0, str1) == -1) {
-        return -1;
+    if (pack != NULL) {
+        int rc = lspack_extract_chunk(pack, strrchr(str0, '\\') + 1, str1);
+        lspack_close(pack);
+
+        if (rc == -1) {
+            return -1;
+        }
+    } else {
+        if (copy_file(str0, str1) == -1) {
+            return -1;
+        }
     }
 
     int saved_automap_size;
@@ -2466,11 +2635,15 @@ static int SlotMap2Game(DB_FILE* stream)
         return -1;
     }
 
+    unsigned int start = get_time();
+
     if (map_load_in_game(LSData[slot_cursor].fileName) == -1) {
         debug_printf("LOADSAVE: returning 13\n");
         return -1;
     }
 
+    debug_printf("\nLOADSAVE: Map loaded in %u ms.\n", elapsed_time(start));
+
     return 0;
 }
 
@@ -2573,11 +2746,184 @@ out:
     return result;
 }
 
+static void add_copy_job(std::vector<LoadSaveCopyJob>& jobs, const char* source, const char* dest)
+{
+    LoadSaveCopyJob job;
+    snprintf(job.source, sizeof(job.source), "%s", source);
+    snprintf(job.dest, sizeof(job.dest), "%s", dest);
+    job.rc = -1;
+    jobs.push_back(job);
+}
+
+// Copies a batch of files (paths are relative to patches directory, as in
+// `copy_file`).
+//
+// Files are copied on several threads directly by the filesystem, which
+// clones them without copying data where it supports copy-on-write. Hard
+// links are not used since game overwrites map files in place. Destination
+// files are created with `db_fopen` on this thread first so that database
+// knows about them. Files which cannot be copied this way (for example when
+// source is not in patches directory) go through `copy_file`.
+static int copy_files(std::vector<LoadSaveCopyJob>& jobs)
+{
+    unsigned int start = get_time();
+
+    for (LoadSaveCopyJob& job : jobs) {
+        DB_FILE* stream = db_fopen(job.dest, "wb");
+        if (stream == NULL) {
+            return -1;
+        }
+        db_fclose(stream);
+    }
+
+    std::atomic<size_t> next(0);
+
+    size_t threadCount = std::min(jobs.size(), (size_t)LOAD_SAVE_COPY_MAX_THREADS);
+    std::vector<std::thread> threads;
+    for (size_t index = 1; index < threadCount; index++) {
+        threads.emplace_back(copy_files_worker, &jobs, &next);
+    }
+
+    copy_files_worker(&jobs, &next);
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    int slowCopies = 0;
+    for (LoadSaveCopyJob& job : jobs) {
+        if (job.rc != 0) {
+            if (copy_file(job.source, job.dest) == -1) {
+                return -1;
+            }
+            slowCopies++;
+        }
+    }
+
+    debug_printf("\nLOADSAVE: Copied %d files (%d through database) in %u ms.\n",
+        (int)jobs.size(),
+        slowCopies,
+        elapsed_time(start));
+
+    return 0;
+}
+
+static void copy_files_worker(std::vector<LoadSaveCopyJob>* jobs, std::atomic<size_t>* next)
+{
+    char source[COMPAT_MAX_PATH];
+    char dest[COMPAT_MAX_PATH];
+
+    while (true) {
+        size_t index = next->fetch_add(1);
+        if (index >= jobs->size()) {
+            break;
+        }
+
+        LoadSaveCopyJob* job = &((*jobs)[index]);
+        snprintf(source, sizeof(source), "%s\\%s", patches, job->source);
+        snprintf(dest, sizeof(dest), "%s\\%s", patches, job->dest);
+        job->rc = compat_copy_file(source, dest);
+    }
+}
+
+// CE: Moves SAVE.DAT and files collected by `GameMap2Slot` into slot pack.
+//
+// SAVE.DAT header (which includes thumbnail) is a separate chunk that is not
+// compressed, so that slot list can be shown without unpacking save data.
+// Every other file is a chunk named after the file it replaces in the slot.
+static int SavePack()
+{
+    unsigned int start = get_time();
+
+    std::vector<LsPackSource> sources;
+
+    snprintf(str0, sizeof(str0), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot_cursor + 1, "SAVE.DAT");
+    add_pack_source(sources, "SAVE.HDR", str0, 0, LS_HEADER_SIZE, false);
+    add_pack_source(sources, "SAVE.DAT", str0, LS_HEADER_SIZE, -1, true);
+
+    for (LoadSaveCopyJob& job : save_packed_files) {
+        add_pack_source(sources, strrchr(job.dest, '\\') + 1, job.source, 0, -1, true);
+    }
+
+    snprintf(gmpath, sizeof(gmpath), "%s\\%s%.2d\\", "SAVEGAME", "SLOT", slot_cursor + 1);
+    snprintf(str1, sizeof(str1), "%s%s", gmpath, LS_PACK_FILE_NAME);
+
+    if (lspack_write(str1, sources.data(), (int)sources.size()) == -1) {
+        MapDirEraseFile(gmpath, LS_PACK_FILE_NAME);
+        return -1;
+    }
+
+    MapDirEraseFile(gmpath, "SAVE.DAT");
+
+    debug_printf("\nLOADSAVE: Packed %d files in %u ms.\n", (int)sources.size(), elapsed_time(start));
+
+    return 0;
+}
+
+static void add_pack_source(std::vector<LsPackSource>& sources, const char* name, const char* path, int offset, int length, bool compress)
+{
+    LsPackSource source;
+    snprintf(source.name, sizeof(source.name), "%s", name);
+    snprintf(source.path, sizeof(source.path), "%s", path);
+    source.offset = offset;
+    source.length = length;
+    source.compress = compress;
+    sources.push_back(source);
+}
+
+// CE: Opens save data of packed slot as a memory stream. Only header is read
+// when `headerOnly` is set. Memory backing the stream is returned in
+// `dataPtr` and should be freed after the stream is closed.
+static DB_FILE* OpenPackedSave(int slot, bool headerOnly, unsigned char** dataPtr)
+{
+    char path[COMPAT_MAX_PATH];
+    snprintf(path, sizeof(path), "%s\\%s%.2d\\%s", "SAVEGAME", "SLOT", slot + 1, LS_PACK_FILE_NAME);
+
+    LsPack* pack = lspack_open(path);
+    if (pack == NULL) {
+        return NULL;
+    }
+
+    int headerSize = lspack_chunk_size(pack, "SAVE.HDR");
+    int dataSize = headerOnly ? 0 : lspack_chunk_size(pack, "SAVE.DAT");
+    if (headerSize == -1 || dataSize == -1) {
+        lspack_close(pack);
+        return NULL;
+    }
+
+    unsigned char* data = (unsigned char*)mem_malloc(headerSize + dataSize + 1);
+    if (data == NULL) {
+        lspack_close(pack);
+        return NULL;
+    }
+
+    if (lspack_read_chunk(pack, "SAVE.HDR", data, headerSize) == -1
+        || (!headerOnly && lspack_read_chunk(pack, "SAVE.DAT", data + headerSize, dataSize) == -1)) {
+        debug_printf("\nLOADSAVE: ** Error reading save slot pack %s! **\n", path);
+        lspack_close(pack);
+        mem_free(data);
+        return NULL;
+    }
+
+    lspack_close(pack);
+
+    DB_FILE* stream = db_fopen_mem(data, headerSize + dataSize);
+    if (stream == NULL) {
+        mem_free(data);
+        return NULL;
+    }
+
+    *dataPtr = data;
+
+    return stream;
+}
+
 // 0x471C3C
 void KillOldMaps()
 {
     snprintf(str, sizeof(str), "%s\\", "MAPS");
     MapDirErase(str, "SAV");
+    lspack_forget_deferred();
 }
 
 // 0x471C68
@@ -2623,6 +2969,24 @@ static int SaveBackup()
     debug_printf("\nLOADSAVE: Backing up save slot files..\n");
 
     snprintf(gmpath, sizeof(gmpath), "%s\\%s\\%s%.2d\\", patches, "SAVEGAME", "SLOT", slot_cursor + 1);
+
+    // CE: Packed slot is backed up as a whole.
+    snprintf(str0, sizeof(str0), "%s%s", gmpath, LS_PACK_FILE_NAME);
+    snprintf(str1, sizeof(str1), "%s%s", gmpath, LS_PACK_BACKUP_FILE_NAME);
+
+    pack_backup_flag = 0;
+
+    DB_FILE* pack_stream = db_fopen(str0, "rb");
+    if (pack_stream != NULL) {
+        db_fclose(pack_stream);
+        compat_remove(str1);
+        if (compat_rename(str0, str1) != 0) {
+            return -1;
+        }
+
+        pack_backup_flag = 1;
+    }
+
     strcpy(str0, gmpath);
 
     strcat(str0, "SAVE.DAT");
@@ -2695,6 +3059,18 @@ static int RestoreSave()
 
     EraseSave();
 
+    // CE: Packed slot has nothing but the pack.
+    if (pack_backup_flag) {
+        snprintf(gmpath, sizeof(gmpath), "%s\\%s\\%s%.2d\\", patches, "SAVEGAME", "SLOT", slot_cursor + 1);
+        snprintf(str0, sizeof(str0), "%s%s", gmpath, LS_PACK_FILE_NAME);
+        snprintf(str1, sizeof(str1), "%s%s", gmpath, LS_PACK_BACKUP_FILE_NAME);
+        if (compat_rename(str1, str0) != 0) {
+            return -1;
+        }
+
+        return 0;
+    }
+
     snprintf(gmpath, sizeof(gmpath), "%s\\%s\\%s%.2d\\", patches, "SAVEGAME", "SLOT", slot_cursor + 1);
     strcpy(str0, gmpath);
     strcat(str0, "SAVE.DAT");
@@ -2788,6 +3164,10 @@ static int EraseSave()
     strcat(str0, "SAVE.DAT");
     compat_remove(str0);
 
+    strcpy(str0, gmpath);
+    strcat(str0, LS_PACK_FILE_NAME);
+    compat_remove(str0);
+
     snprintf(gmpath, sizeof(gmpath), "%s\\%s%.2d\\", "SAVEGAME", "SLOT", slot_cursor + 1);
     snprintf(str0, sizeof(str0), "%s*.%s", gmpath, "SAV");
 
@@ -0,0 +1,519 @@
+// CE: Packed save slot container.
+//
+// Pack is a single file with an index of named chunks followed by chunk
+// data. Each chunk is stored as is or compressed with LZSS (the same flavor
+// that is used in DAT files). All integers are big-endian.
+//
+// Layout:
+//   signature (16 bytes), version, chunk count
+//   chunk headers: name (16 bytes), offset, length, packed length, flags
+//   chunk data
+//
+// Chunks can be read individually, so that only the data that is needed is
+// touched. Extraction of chunks can be deferred until the file they are
+// supposed to land in is actually needed (see `lspack_defer_chunk`).
+
+#include "game/lspack.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "plib/db/db.h"
+#include "plib/db/lzss.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/memory.h"
+
+namespace fallout {
+
+#define LSPACK_SIGNATURE "FALLOUT SAVE PAK"
+#define LSPACK_SIGNATURE_LENGTH 16
+#define LSPACK_VERSION 1
+#define LSPACK_MAX_CHUNKS 1024
+#define LSPACK_HEADER_SIZE (LSPACK_SIGNATURE_LENGTH + 8)
+#define LSPACK_CHUNK_HEADER_SIZE (LSPACK_CHUNK_NAME_LENGTH + 16)
+
+typedef enum LsPackChunkFlags {
+    LSPACK_CHUNK_LZSS = 0x01,
+} LsPackChunkFlags;
+
+typedef struct LsPackChunk {
+    char name[LSPACK_CHUNK_NAME_LENGTH];
+    int offset;
+    int length;
+    int packedLength;
+    int flags;
+} LsPackChunk;
+
+typedef struct LsPack {
+    char path[COMPAT_MAX_PATH];
+    DB_FILE* stream;
+    std::vector<LsPackChunk> chunks;
+} LsPack;
+
+typedef struct LsPackDeferredChunk {
+    char packPath[COMPAT_MAX_PATH];
+    char path[COMPAT_MAX_PATH];
+    LsPackChunk chunk;
+} LsPackDeferredChunk;
+
+static int lspack_write_header(DB_FILE* stream, std::vector<LsPackChunk>& chunks);
+static int lspack_read_source(LsPackSource* source, unsigned char** dataPtr, int* lengthPtr);
+static LsPackChunk* lspack_find_chunk(LsPack* pack, const char* name);
+static int lspack_read_chunk_data(DB_FILE* stream, LsPackChunk* chunk, unsigned char* dest);
+static int lspack_extract_chunk_data(DB_FILE* stream, LsPackChunk* chunk, const char* path);
+
+// Chunks waiting for `lspack_extract_deferred`.
+static std::vector<LsPackDeferredChunk> lspack_deferred;
+
+// Writes pack at `path` (relative to database) made of `count` chunks taken
+// from `sources`. Returns -1 on error, in which case the pack is incomplete
+// and should be removed by the caller.
+int lspack_write(const char* path, LsPackSource* sources, int count)
+{
+    DB_FILE* stream;
+    unsigned char* data;
+    unsigned char* packed;
+    int length;
+    int packedLength;
+    int offset;
+    int index;
+    int rc;
+
+    if (count < 0 || count > LSPACK_MAX_CHUNKS) {
+        return -1;
+    }
+
+    stream = db_fopen(path, "wb");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    // Chunk headers are not known yet, reserve room for them and write them
+    // again once all chunks are in place.
+    std::vector<LsPackChunk> chunks(count);
+    if (lspack_write_header(stream, chunks) == -1) {
+        db_fclose(stream);
+        return -1;
+    }
+
+    rc = 0;
+    offset = LSPACK_HEADER_SIZE + count * LSPACK_CHUNK_HEADER_SIZE;
+    for (index = 0; index < count; index++) {
+        LsPackSource* source = &(sources[index]);
+        LsPackChunk* chunk = &(chunks[index]);
+
+        if (lspack_read_source(source, &data, &length) == -1) {
+            debug_printf("\nLSPACK: Error reading %s!\n", source->path);
+            rc = -1;
+            break;
+        }
+
+        strncpy(chunk->name, source->name, LSPACK_CHUNK_NAME_LENGTH - 1);
+        chunk->offset = offset;
+        chunk->length = length;
+        chunk->packedLength = length;
+        chunk->flags = 0;
+
+        packed = NULL;
+        if (source->compress && length > 0) {
+            packed = (unsigned char*)mem_malloc(length);
+            if (packed != NULL) {
+                // Keep chunk as is unless compression actually saves space.
+                packedLength = lzss_encode_block(data, length, packed, length);
+                if (packedLength != -1 && packedLength < length) {
+                    chunk->packedLength = packedLength;
+                    chunk->flags |= LSPACK_CHUNK_LZSS;
+                }
+            }
+        }
+
+        if (chunk->packedLength != 0) {
+            if (db_fwrite((chunk->flags & LSPACK_CHUNK_LZSS) != 0 ? packed : data, chunk->packedLength, 1, stream) != 1) {
+                rc = -1;
+            }
+        }
+
+        if (packed != NULL) {
+            mem_free(packed);
+        }
+
+        mem_free(data);
+
+        if (rc == -1) {
+            break;
+        }
+
+        offset += chunk->packedLength;
+    }
+
+    if (rc == 0) {
+        if (db_fseek(stream, 0, SEEK_SET) != 0 || lspack_write_header(stream, chunks) == -1) {
+            rc = -1;
+        }
+    }
+
+    db_fclose(stream);
+
+    return rc;
+}
+
+// Opens pack at `path` and reads its index. Returns NULL if file does not
+// exist or is not a valid pack.
+LsPack* lspack_open(const char* path)
+{
+    DB_FILE* stream;
+    char signature[LSPACK_SIGNATURE_LENGTH];
+    int header[2];
+    int fields[4];
+    int index;
+    long fileLength;
+
+    stream = db_fopen(path, "rb");
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    fileLength = db_filelength(stream);
+
+    if (db_fread(signature, LSPACK_SIGNATURE_LENGTH, 1, stream) != 1
+        || memcmp(signature, LSPACK_SIGNATURE, LSPACK_SIGNATURE_LENGTH) != 0
+        || db_freadIntCount(stream, header, 2) == -1
+        || header[0] != LSPACK_VERSION
+        || header[1] < 0
+        || header[1] > LSPACK_MAX_CHUNKS) {
+        debug_printf("\nLSPACK: Invalid pack %s!\n", path);
+        db_fclose(stream);
+        return NULL;
+    }
+
+    LsPack* pack = new LsPack();
+    snprintf(pack->path, sizeof(pack->path), "%s", path);
+    pack->stream = stream;
+    pack->chunks.resize(header[1]);
+
+    for (index = 0; index < header[1]; index++) {
+        LsPackChunk* chunk = &(pack->chunks[index]);
+        if (db_fread(chunk->name, LSPACK_CHUNK_NAME_LENGTH, 1, stream) != 1
+            || db_freadIntCount(stream, fields, 4) == -1
+            || fields[0] < 0
+            || fields[1] < 0
+            || fields[2] < 0
+            || fields[0] > fileLength
+            || fields[2] > fileLength - fields[0]
+            || ((fields[3] & LSPACK_CHUNK_LZSS) == 0 && fields[1] != fields[2])) {
+            debug_printf("\nLSPACK: Invalid pack %s!\n", path);
+            lspack_close(pack);
+            return NULL;
+        }
+
+        chunk->name[LSPACK_CHUNK_NAME_LENGTH - 1] = '\0';
+        chunk->offset = fields[0];
+        chunk->length = fields[1];
+        chunk->packedLength = fields[2];
+        chunk->flags = fields[3];
+    }
+
+    return pack;
+}
+
+void lspack_close(LsPack* pack)
+{
+    if (pack == NULL) {
+        return;
+    }
+
+    db_fclose(pack->stream);
+    delete pack;
+}
+
+// Returns unpacked size of chunk `name`, or -1 if there is no such chunk.
+int lspack_chunk_size(LsPack* pack, const char* name)
+{
+    LsPackChunk* chunk;
+
+    chunk = lspack_find_chunk(pack, name);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    return chunk->length;
+}
+
+// Reads entire chunk `name` into `dest`, which should be at least
+// `lspack_chunk_size` bytes. Returns chunk size or -1 on error.
+int lspack_read_chunk(LsPack* pack, const char* name, unsigned char* dest, int size)
+{
+    LsPackChunk* chunk;
+
+    chunk = lspack_find_chunk(pack, name);
+    if (chunk == NULL || chunk->length > size) {
+        return -1;
+    }
+
+    return lspack_read_chunk_data(pack->stream, chunk, dest);
+}
+
+// Reads `size` bytes at `offset` of chunk `name` without reading the rest of
+// it. Only works for stored chunks.
+int lspack_read_chunk_part(LsPack* pack, const char* name, int offset, unsigned char* dest, int size)
+{
+    LsPackChunk* chunk;
+
+    chunk = lspack_find_chunk(pack, name);
+    if (chunk == NULL || (chunk->flags & LSPACK_CHUNK_LZSS) != 0) {
+        return -1;
+    }
+
+    if (offset < 0 || size < 0 || offset > chunk->length || size > chunk->length - offset) {
+        return -1;
+    }
+
+    if (db_fseek(pack->stream, chunk->offset + offset, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    if (size != 0 && db_fread(dest, size, 1, pack->stream) != 1) {
+        return -1;
+    }
+
+    return size;
+}
+
+// Writes chunk `name` to database file `path`.
+int lspack_extract_chunk(LsPack* pack, const char* name, const char* path)
+{
+    LsPackChunk* chunk;
+
+    chunk = lspack_find_chunk(pack, name);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    return lspack_extract_chunk_data(pack->stream, chunk, path);
+}
+
+// Remembers that chunk `name` should be written to database file `path`, but
+// only when `lspack_extract_deferred` asks for it. The pack must stay in
+// place until then.
+int lspack_defer_chunk(LsPack* pack, const char* name, const char* path)
+{
+    LsPackChunk* chunk;
+    LsPackDeferredChunk deferred;
+
+    chunk = lspack_find_chunk(pack, name);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    snprintf(deferred.packPath, sizeof(deferred.packPath), "%s", pack->path);
+    snprintf(deferred.path, sizeof(deferred.path), "%s", path);
+    deferred.chunk = *chunk;
+    lspack_deferred.push_back(deferred);
+
+    return 0;
+}
+
+// Extracts deferred chunk which belongs to `path`, if any. Returns 0 when
+// there is nothing to extract.
+int lspack_extract_deferred(const char* path)
+{
+    DB_FILE* stream;
+    int rc;
+
+    for (size_t index = 0; index < lspack_deferred.size(); index++) {
+        if (compat_stricmp(lspack_deferred[index].path, path) == 0) {
+            LsPackDeferredChunk deferred = lspack_deferred[index];
+            lspack_deferred.erase(lspack_deferred.begin() + index);
+
+            stream = db_fopen(deferred.packPath, "rb");
+            if (stream == NULL) {
+                return -1;
+            }
+
+            rc = lspack_extract_chunk_data(stream, &(deferred.chunk), deferred.path);
+            db_fclose(stream);
+
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+// Extracts all deferred chunks. Should be called before anything that
+// expects them to be present, or before the pack is modified.
+int lspack_extract_all_deferred()
+{
+    int rc;
+
+    rc = 0;
+    while (!lspack_deferred.empty()) {
+        if (lspack_extract_deferred(lspack_deferred.back().path) == -1) {
+            rc = -1;
+        }
+    }
+
+    return rc;
+}
+
+void lspack_forget_deferred()
+{
+    lspack_deferred.clear();
+}
+
+static int lspack_write_header(DB_FILE* stream, std::vector<LsPackChunk>& chunks)
+{
+    int header[2];
+    int fields[4];
+
+    header[0] = LSPACK_VERSION;
+    header[1] = (int)chunks.size();
+
+    if (db_fwrite(LSPACK_SIGNATURE, LSPACK_SIGNATURE_LENGTH, 1, stream) != 1) {
+        return -1;
+    }
+
+    if (db_fwriteIntCount(stream, header, 2) == -1) {
+        return -1;
+    }
+
+    for (LsPackChunk& chunk : chunks) {
+        if (db_fwrite(chunk.name, LSPACK_CHUNK_NAME_LENGTH, 1, stream) != 1) {
+            return -1;
+        }
+
+        fields[0] = chunk.offset;
+        fields[1] = chunk.length;
+        fields[2] = chunk.packedLength;
+        fields[3] = chunk.flags;
+        if (db_fwriteIntCount(stream, fields, 4) == -1) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int lspack_read_source(LsPackSource* source, unsigned char** dataPtr, int* lengthPtr)
+{
+    DB_FILE* stream;
+    unsigned char* data;
+    int fileLength;
+    int length;
+
+    stream = db_fopen(source->path, "rb");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    fileLength = db_filelength(stream);
+    if (fileLength == -1 || source->offset < 0 || source->offset > fileLength) {
+        db_fclose(stream);
+        return -1;
+    }
+
+    length = fileLength - source->offset;
+    if (source->length != -1 && source->length < length) {
+        length = source->length;
+    }
+
+    data = (unsigned char*)mem_malloc(length != 0 ? length : 1);
+    if (data == NULL) {
+        db_fclose(stream);
+        return -1;
+    }
+
+    if (db_fseek(stream, source->offset, SEEK_SET) != 0
+        || (length != 0 && db_fread(data, length, 1, stream) != 1)) {
+        mem_free(data);
+        db_fclose(stream);
+        return -1;
+    }
+
+    db_fclose(stream);
+
+    *dataPtr = data;
+    *lengthPtr = length;
+
+    return 0;
+}
+
+static LsPackChunk* lspack_find_chunk(LsPack* pack, const char* name)
+{
+    for (LsPackChunk& chunk : pack->chunks) {
+        if (compat_stricmp(chunk.name, name) == 0) {
+            return &chunk;
+        }
+    }
+
+    return NULL;
+}
+
+static int lspack_read_chunk_data(DB_FILE* stream, LsPackChunk* chunk, unsigned char* dest)
+{
+    unsigned char* packed;
+    int rc;
+
+    if (db_fseek(stream, chunk->offset, SEEK_SET) != 0) {
+        return -1;
+    }
+
+    if ((chunk->flags & LSPACK_CHUNK_LZSS) == 0) {
+        if (chunk->length != 0 && db_fread(dest, chunk->length, 1, stream) != 1) {
+            return -1;
+        }
+
+        return chunk->length;
+    }
+
+    packed = (unsigned char*)mem_malloc(chunk->packedLength != 0 ? chunk->packedLength : 1);
+    if (packed == NULL) {
+        return -1;
+    }
+
+    rc = -1;
+    if (chunk->packedLength == 0 || db_fread(packed, chunk->packedLength, 1, stream) == 1) {
+        if (lzss_decode_block(packed, chunk->packedLength, dest, chunk->length) == chunk->length) {
+            rc = chunk->length;
+        }
+    }
+
+    mem_free(packed);
+
+    return rc;
+}
+
+static int lspack_extract_chunk_data(DB_FILE* stream, LsPackChunk* chunk, const char* path)
+{
+    DB_FILE* out;
+    unsigned char* data;
+    int rc;
+
+    data = (unsigned char*)mem_malloc(chunk->length != 0 ? chunk->length : 1);
+    if (data == NULL) {
+        return -1;
+    }
+
+    rc = -1;
+    if (lspack_read_chunk_data(stream, chunk, data) != -1) {
+        out = db_fopen(path, "wb");
+        if (out != NULL) {
+            if (chunk->length == 0 || db_fwrite(data, chunk->length, 1, out) == 1) {
+                rc = 0;
+            }
+            db_fclose(out);
+        }
+    }
+
+    mem_free(data);
+
+    if (rc == -1) {
+        debug_printf("\nLSPACK: Error extracting %s!\n", path);
+    }
+
+    return rc;
+}
+
+} // namespace fallout
@@ -0,0 +1,37 @@
+#ifndef FALLOUT_GAME_LSPACK_H_
+#define FALLOUT_GAME_LSPACK_H_
+
+#include "platform_compat.h"
+
+namespace fallout {
+
+#define LSPACK_CHUNK_NAME_LENGTH 16
+
+typedef struct LsPack LsPack;
+
+// Describes where `lspack_write` takes chunk data from: `length` bytes of
+// database file `path` starting at `offset` (-1 length means up to the end
+// of file).
+typedef struct LsPackSource {
+    char name[LSPACK_CHUNK_NAME_LENGTH];
+    char path[COMPAT_MAX_PATH];
+    int offset;
+    int length;
+    bool compress;
+} LsPackSource;
+
+int lspack_write(const char* path, LsPackSource* sources, int count);
+LsPack* lspack_open(const char* path);
+void lspack_close(LsPack* pack);
+int lspack_chunk_size(LsPack* pack, const char* name);
+int lspack_read_chunk(LsPack* pack, const char* name, unsigned char* dest, int size);
+int lspack_read_chunk_part(LsPack* pack, const char* name, int offset, unsigned char* dest, int size);
+int lspack_extract_chunk(LsPack* pack, const char* name, const char* path);
+int lspack_defer_chunk(LsPack* pack, const char* name, const char* path);
+int lspack_extract_deferred(const char* path);
+int lspack_extract_all_deferred();
+void lspack_forget_deferred();
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_LSPACK_H_ */
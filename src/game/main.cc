@@ -15,6 +15,7 @@
 
 #include "game/amutex.h"
 #include "game/art.h"
+#include "game/benchmark.h"
 #include "game/credits.h"
 #include "game/cycle.h"
 #include "game/endgame.h"
@@ -44,6 +45,7 @@
 #include "plib/gnw/intrface.h"
 #include "plib/gnw/svga.h"
 #include "plib/gnw/text.h"
+#include "profiler.h"
 
 namespace fallout {
 
@@ -61,6 +63,7 @@ static bool main_selfrun_init();
 static void main_selfrun_exit();
 static void main_selfrun_record();
 static void main_selfrun_play();
+static int main_selfrun_benchmark();
 static void main_death_scene();
 static void main_death_voiceover_callback();
 
@@ -96,6 +99,19 @@ int gnw_main(int argc, char** argv)
         return 1;
     }
 
+    // CE: Benchmark replays single recording and quits, there is no need for
+    // intro movies and main menu.
+    if (benchmark_is_active()) {
+        int rc = main_selfrun_benchmark();
+
+        // NOTE: Uninline.
+        main_exit_system();
+
+        autorun_mutex_destroy();
+
+        return rc == 0 ? 0 : 1;
+    }
+
     gmovie_play(MOVIE_IPLOGO, GAME_MOVIE_FADE_IN);
     gmovie_play(MOVIE_INTRO, 0);
 
@@ -320,6 +336,8 @@ static void main_game_loop()
     scr_enable();
 
     while (game_user_wants_to_quit == 0) {
+        ProfilerZone zone("frame");
+
         sharedFpsLimiter.mark();
 
         int keyCode = get_input();
@@ -430,6 +448,33 @@ static void main_selfrun_record()
     }
 }
 
+// CE: Plays selfrun recording specified in benchmark settings with the same
+// setup as `main_selfrun_play` and writes benchmark report.
+static int main_selfrun_benchmark()
+{
+    SelfrunData selfrunData;
+    if (selfrun_prep_playback(benchmark_get_selfrun(), &selfrunData) != 0) {
+        debug_printf("Benchmark: unable to load selfrun %s\n", benchmark_get_selfrun());
+        return -1;
+    }
+
+    roll_set_seed(0xBEEFFEED);
+
+    // NOTE: Uninline.
+    main_reset_system();
+
+    proto_dude_init("premade\\combat.gcd");
+    main_load_new(selfrunData.mapFileName);
+    selfrun_benchmark_loop(&selfrunData);
+
+    int rc = benchmark_write_report();
+
+    // NOTE: Uninline.
+    main_unload_new();
+
+    return rc;
+}
+
 // 0x472CA0
 static void main_selfrun_play()
 {
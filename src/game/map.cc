@@ -20,6 +20,7 @@
 #include "game/item.h"
 #include "game/light.h"
 #include "game/loadsave.h"
+#include "game/lspack.h"
 #include "game/object.h"
 #include "game/palette.h"
 #include "game/pipboy.h"
@@ -869,6 +870,9 @@ int map_load(char* file_name)
 
         file_path = map_file_path(file_name);
 
+        // CE: Saved map might still be in the pack of the loaded save slot.
+        lspack_extract_deferred(file_path);
+
         stream = db_fopen(file_path, "rb");
         strcpy(extension, ".MAP");
         db_fclose(stream);
@@ -1843,16 +1847,19 @@ static int map_read_MapData(MapHeader* ptr, DB_FILE* stream)
 {
     if (db_freadInt32(stream, &(ptr->version)) == -1) return -1;
     if (db_freadInt8List(stream, ptr->name, 16) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->enteringTile)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->enteringElevation)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->enteringRotation)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->localVariablesCount)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->scriptIndex)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->flags)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->darkness)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->globalVariablesCount)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->field_34)) == -1) return -1;
-    if (db_freadInt32(stream, &(ptr->lastVisitTime)) == -1) return -1;
+    // CE: Read fixed fields at once.
+    int fields[10];
+    if (db_freadInt32List(stream, fields, 10) == -1) return -1;
+    ptr->enteringTile = fields[0];
+    ptr->enteringElevation = fields[1];
+    ptr->enteringRotation = fields[2];
+    ptr->localVariablesCount = fields[3];
+    ptr->scriptIndex = fields[4];
+    ptr->flags = fields[5];
+    ptr->darkness = fields[6];
+    ptr->globalVariablesCount = fields[7];
+    ptr->field_34 = fields[8];
+    ptr->lastVisitTime = fields[9];
     if (db_freadInt32List(stream, ptr->field_3C, 44) == -1) return -1;
 
     return 0;
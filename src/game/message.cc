@@ -5,6 +5,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+
 #include "game/gconfig.h"
 #include "game/roll.h"
 #include "platform_compat.h"
@@ -16,10 +18,23 @@ namespace fallout {
 
 #define BADWORD_LENGTH_MAX 80
 
+// Numbers are stored in dense table when it's at most this many times larger
+// than the number of entries, otherwise in hash table.
+#define MESSAGE_INDEX_DENSITY 4
+
+// Buffer holding the whole message file. Fields are unescaped in place and
+// entries of the list point into `data`.
+typedef struct MessageArena {
+    MessageArena* next;
+    char data[1];
+} MessageArena;
+
 static bool message_find(MessageList* msg, int num, int* out_index);
-static bool message_add(MessageList* msg, MessageListItem* new_entry);
 static bool message_parse_number(int* out_num, const char* str);
-static int message_load_field(DB_FILE* file, char* str);
+static int message_load_field(char** pos, char* end, char** str);
+static void message_sort(MessageList* msg, int sorted_num);
+static void message_index_build(MessageList* msg);
+static unsigned int message_index_hash(int num);
 
 // 0x505B10
 static char** bad_word = NULL;
@@ -124,6 +139,11 @@ bool message_init(MessageList* messageList)
     if (messageList != NULL) {
         messageList->entries_num = 0;
         messageList->entries = NULL;
+        messageList->index = NULL;
+        messageList->index_size = 0;
+        messageList->index_base = 0;
+        messageList->index_dense = false;
+        messageList->arena = NULL;
     }
     return true;
 }
@@ -131,23 +151,15 @@ bool message_init(MessageList* messageList)
 // 0x4766D4
 bool message_exit(MessageList* messageList)
 {
-    int i;
-    MessageListItem* entry;
-
     if (messageList == NULL) {
         return false;
     }
 
-    for (i = 0; i < messageList->entries_num; i++) {
-        entry = &(messageList->entries[i]);
-
-        if (entry->audio != NULL) {
-            mem_free(entry->audio);
-        }
-
-        if (entry->text != NULL) {
-            mem_free(entry->text);
-        }
+    // CE: Entries point into arenas, they are not freed one by one.
+    while (messageList->arena != NULL) {
+        MessageArena* next = messageList->arena->next;
+        mem_free(messageList->arena);
+        messageList->arena = next;
     }
 
     messageList->entries_num = 0;
@@ -157,18 +169,33 @@ bool message_exit(MessageList* messageList)
         messageList->entries = NULL;
     }
 
+    if (messageList->index != NULL) {
+        mem_free(messageList->index);
+        messageList->index = NULL;
+    }
+
+    messageList->index_size = 0;
+
     return true;
 }
 
+// CE: Reads the whole file at once and parses it in place. Entries are
+// appended in file order and sorted once at the end, instead of inserting
+// every line into sorted array.
+//
 // 0x476814
 bool message_load(MessageList* messageList, const char* path)
 {
     char* language;
     char localized_path[COMPAT_MAX_PATH];
     DB_FILE* file_ptr;
-    char num[MESSAGE_LIST_ITEM_FIELD_MAX_SIZE];
-    char audio[MESSAGE_LIST_ITEM_FIELD_MAX_SIZE];
-    char text[MESSAGE_LIST_ITEM_FIELD_MAX_SIZE];
+    long file_size;
+    MessageArena* arena;
+    char* pos;
+    char* end;
+    char* num;
+    int capacity;
+    int sorted_num;
     int rc;
     bool success;
     MessageListItem entry;
@@ -194,22 +221,42 @@ bool message_load(MessageList* messageList, const char* path)
         return false;
     }
 
-    entry.num = 0;
-    entry.audio = audio;
-    entry.text = text;
+    file_size = db_filelength(file_ptr);
+    if (file_size < 0) {
+        db_fclose(file_ptr);
+        return false;
+    }
+
+    arena = (MessageArena*)mem_malloc(sizeof(*arena) + file_size);
+    if (arena == NULL) {
+        db_fclose(file_ptr);
+        return false;
+    }
+
+    file_size = db_fread(arena->data, 1, file_size, file_ptr);
+    db_fclose(file_ptr);
+
+    arena->next = messageList->arena;
+    messageList->arena = arena;
+
+    pos = arena->data;
+    end = arena->data + file_size;
+
+    capacity = messageList->entries_num;
+    sorted_num = messageList->entries_num;
 
     while (1) {
-        rc = message_load_field(file_ptr, num);
+        rc = message_load_field(&pos, end, &num);
         if (rc != 0) {
             break;
         }
 
-        if (message_load_field(file_ptr, audio) != 0) {
+        if (message_load_field(&pos, end, &(entry.audio)) != 0) {
             debug_printf("\nError loading audio field.\n", localized_path);
             goto err;
         }
 
-        if (message_load_field(file_ptr, text) != 0) {
+        if (message_load_field(&pos, end, &(entry.text)) != 0) {
             debug_printf("\nError loading text field.\n", localized_path);
             goto err;
         }
@@ -219,10 +266,19 @@ bool message_load(MessageList* messageList, const char* path)
             goto err;
         }
 
-        if (!message_add(messageList, &entry)) {
-            debug_printf("\nError adding message.\n", localized_path);
-            goto err;
+        if (messageList->entries_num == capacity) {
+            capacity = capacity * 2 + 16;
+
+            MessageListItem* entries = (MessageListItem*)mem_realloc(messageList->entries, sizeof(*entries) * capacity);
+            if (entries == NULL) {
+                debug_printf("\nError adding message.\n", localized_path);
+                goto err;
+            }
+
+            messageList->entries = entries;
         }
+
+        messageList->entries[messageList->entries_num++] = entry;
     }
 
     if (rc == 1) {
@@ -232,10 +288,13 @@ bool message_load(MessageList* messageList, const char* path)
 err:
 
     if (!success) {
-        debug_printf("Error loading message file %s at offset %x.", localized_path, db_ftell(file_ptr));
+        debug_printf("Error loading message file %s at offset %x.", localized_path, (int)(pos - arena->data));
     }
 
-    db_fclose(file_ptr);
+    // Entries parsed before an error are kept, as they were in original
+    // code.
+    message_sort(messageList, sorted_num);
+    message_index_build(messageList);
 
     return success;
 }
@@ -293,6 +352,10 @@ bool message_make_path(char* dest, size_t size, const char* path)
     return true;
 }
 
+// CE: Looks number up in index, falls back to bisection when index could
+// not be allocated. Original code narrowed range by one entry at a time which
+// made it a linear scan.
+//
 // 0x476A78
 bool message_find(MessageList* msg, int num, int* out_index)
 {
@@ -304,6 +367,33 @@ bool message_find(MessageList* msg, int num, int* out_index)
         return false;
     }
 
+    if (msg->index != NULL) {
+        int index = 0;
+        if (msg->index_dense) {
+            unsigned int offset = (unsigned int)num - (unsigned int)msg->index_base;
+            if (offset < (unsigned int)msg->index_size) {
+                index = msg->index[offset];
+            }
+        } else {
+            unsigned int mask = msg->index_size - 1;
+            unsigned int slot = message_index_hash(num) & mask;
+            while (msg->index[slot] != 0) {
+                if (msg->entries[msg->index[slot] - 1].num == num) {
+                    index = msg->index[slot];
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+
+        if (index == 0) {
+            return false;
+        }
+
+        *out_index = index - 1;
+        return true;
+    }
+
     r = msg->entries_num - 1;
     l = 0;
 
@@ -316,9 +406,9 @@ bool message_find(MessageList* msg, int num, int* out_index)
         }
 
         if (cmp > 0) {
-            l = l + 1;
+            l = mid + 1;
         } else {
-            r = r - 1;
+            r = mid - 1;
         }
     } while (r >= l);
 
@@ -331,64 +421,96 @@ bool message_find(MessageList* msg, int num, int* out_index)
     return false;
 }
 
-// 0x476AD0
-bool message_add(MessageList* msg, MessageListItem* new_entry)
+// Restores order of entries after new ones were appended past [sorted_num].
+// When number repeats the entry added last wins, like it replaced previous
+// one in original code.
+static void message_sort(MessageList* msg, int sorted_num)
 {
+    MessageListItem* entries = msg->entries;
     int index;
-    MessageListItem* entries;
-    MessageListItem* existing_entry;
 
-    if (message_find(msg, new_entry->num, &index)) {
-        existing_entry = &(msg->entries[index]);
-
-        if (existing_entry->audio != NULL) {
-            mem_free(existing_entry->audio);
+    for (index = sorted_num; index < msg->entries_num; index++) {
+        if (index != 0 && entries[index - 1].num >= entries[index].num) {
+            break;
         }
+    }
 
-        if (existing_entry->text != NULL) {
-            mem_free(existing_entry->text);
-        }
-    } else {
-        if (msg->entries != NULL) {
-            entries = (MessageListItem*)mem_realloc(msg->entries, sizeof(MessageListItem) * (msg->entries_num + 1));
-            if (entries == NULL) {
-                return false;
-            }
+    if (index == msg->entries_num) {
+        return;
+    }
 
-            msg->entries = entries;
+    std::stable_sort(entries, entries + msg->entries_num, [](const MessageListItem& a, const MessageListItem& b) {
+        return a.num < b.num;
+    });
 
-            if (index != msg->entries_num) {
-                // Move all items below insertion point
-                memmove(&(msg->entries[index + 1]), &(msg->entries[index]), sizeof(MessageListItem) * (msg->entries_num - index));
-            }
-        } else {
-            msg->entries = (MessageListItem*)mem_malloc(sizeof(MessageListItem));
-            if (msg->entries == NULL) {
-                return false;
-            }
-            msg->entries_num = 0;
-            index = 0;
+    int length = 0;
+    for (index = 0; index < msg->entries_num; index++) {
+        if (index + 1 < msg->entries_num && entries[index + 1].num == entries[index].num) {
+            continue;
         }
 
-        existing_entry = &(msg->entries[index]);
-        existing_entry->audio = 0;
-        existing_entry->text = 0;
-        msg->entries_num++;
+        entries[length++] = entries[index];
     }
 
-    existing_entry->audio = mem_strdup(new_entry->audio);
-    if (existing_entry->audio == NULL) {
-        return false;
+    msg->entries_num = length;
+}
+
+// Builds lookup table for sorted entries. Sequential numbering (the usual
+// case) gets dense table indexed by `num - index_base`, sparse numbering gets
+// hash table which is at most half full.
+static void message_index_build(MessageList* msg)
+{
+    if (msg->index != NULL) {
+        mem_free(msg->index);
+        msg->index = NULL;
     }
 
-    existing_entry->text = mem_strdup(new_entry->text);
-    if (existing_entry->text == NULL) {
-        return false;
+    msg->index_size = 0;
+
+    if (msg->entries_num == 0) {
+        return;
     }
 
-    existing_entry->num = new_entry->num;
+    long long span = (long long)msg->entries[msg->entries_num - 1].num - msg->entries[0].num + 1;
+    if (span <= (long long)msg->entries_num * MESSAGE_INDEX_DENSITY) {
+        msg->index_dense = true;
+        msg->index_base = msg->entries[0].num;
+        msg->index_size = (int)span;
+    } else {
+        msg->index_dense = false;
+        msg->index_base = 0;
+        msg->index_size = 16;
+        while (msg->index_size < msg->entries_num * 2) {
+            msg->index_size *= 2;
+        }
+    }
 
-    return true;
+    msg->index = (int*)mem_malloc(sizeof(*msg->index) * msg->index_size);
+    if (msg->index == NULL) {
+        msg->index_size = 0;
+        return;
+    }
+
+    memset(msg->index, 0, sizeof(*msg->index) * msg->index_size);
+
+    for (int index = 0; index < msg->entries_num; index++) {
+        int num = msg->entries[index].num;
+        if (msg->index_dense) {
+            msg->index[num - msg->index_base] = index + 1;
+        } else {
+            unsigned int mask = msg->index_size - 1;
+            unsigned int slot = message_index_hash(num) & mask;
+            while (msg->index[slot] != 0) {
+                slot = (slot + 1) & mask;
+            }
+            msg->index[slot] = index + 1;
+        }
+    }
+}
+
+static unsigned int message_index_hash(int num)
+{
+    return (unsigned int)num * 2654435761U;
 }
 
 // 0x476D80
@@ -419,8 +541,9 @@ bool message_parse_number(int* out_num, const char* str)
     return success;
 }
 
-// Read next message file field, the `str` should be at least
-// `MESSAGE_LIST_ITEM_FIELD_MAX_SIZE` bytes long.
+// Reads next message file field from the buffer at [pos] and advances [pos]
+// past it. Field is unescaped in place (newlines are dropped) and [str] is
+// set to point to it.
 //
 // Returns:
 // 0 - ok
@@ -429,48 +552,66 @@ bool message_parse_number(int* out_num, const char* str)
 // 3 - unterminated field
 // 4 - limit exceeded (> `MESSAGE_LIST_ITEM_FIELD_MAX_SIZE`)
 //
+// CE: Reads from memory instead of `DB_FILE`. Since the file is read in
+// binary form `\r\n` is dropped here the same way text mode stream dropped it.
+//
 // 0x476DD4
-int message_load_field(DB_FILE* file, char* str)
+int message_load_field(char** pos, char* end, char** str)
 {
-    int ch;
+    char* src;
+    char* dest;
     int len;
 
-    len = 0;
+    src = *pos;
 
     while (1) {
-        ch = db_fgetc(file);
-        if (ch == -1) {
+        if (src == end) {
+            *pos = src;
             return 1;
         }
 
-        if (ch == '}') {
+        if (*src == '}') {
+            *pos = src;
             debug_printf("\nError reading message file - mismatched delimiters.\n");
             return 2;
         }
 
-        if (ch == '{') {
+        if (*src++ == '{') {
             break;
         }
     }
 
-    while (1) {
-        ch = db_fgetc(file);
+    // Unescaped field is never longer than its source and starts at least
+    // one byte (the opening brace) before it, so the terminator always fits.
+    dest = src - 1;
+    *str = dest;
+    len = 0;
 
-        if (ch == -1) {
+    while (1) {
+        if (src == end) {
+            *pos = src;
             debug_printf("\nError reading message file - EOF reached.\n");
             return 3;
         }
 
+        char ch = *src++;
+
         if (ch == '}') {
-            *(str + len) = '\0';
+            dest[len] = '\0';
+            *pos = src;
             return 0;
         }
 
+        if (ch == '\r' && src != end && *src == '\n') {
+            continue;
+        }
+
         if (ch != '\n') {
-            *(str + len) = ch;
+            dest[len] = ch;
             len++;
 
             if (len >= MESSAGE_LIST_ITEM_FIELD_MAX_SIZE) {
+                *pos = src;
                 debug_printf("\nError reading message file - text exceeds limit.\n");
                 return 4;
             }
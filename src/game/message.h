@@ -14,9 +14,24 @@ typedef struct MessageListItem {
     char* text;
 } MessageListItem;
 
+typedef struct MessageArena MessageArena;
+
 typedef struct MessageList {
     int entries_num;
+
+    // Sorted by `num`.
     MessageListItem* entries;
+
+    // CE: Lookup table from message number to entry index plus one (zero
+    // marks no entry). Either dense table starting at [index_base] or open
+    // addressing hash table, see `message_index_build`.
+    int* index;
+    int index_size;
+    int index_base;
+    bool index_dense;
+
+    // CE: Contents of loaded files, [entries] point into them.
+    MessageArena* arena;
 } MessageList;
 
 int init_message();
@@ -19,15 +19,18 @@
 #include "game/protinst.h"
 #include "game/proto.h"
 #include "game/scripts.h"
+#include "game/shade.h"
 #include "game/textobj.h"
 #include "game/tile.h"
 #include "game/worldmap.h"
 #include "plib/color/color.h"
+#include "plib/db/db.h"
 #include "plib/gnw/debug.h"
 #include "plib/gnw/grbuf.h"
 #include "plib/gnw/input.h"
 #include "plib/gnw/memory.h"
 #include "plib/gnw/svga.h"
+#include "profiler.h"
 
 namespace fallout {
 
@@ -58,9 +61,18 @@ static void obj_insert(ObjectListNode* ptr);
 static int obj_remove(ObjectListNode* a1, ObjectListNode* a2);
 static int obj_connect_to_tile(ObjectListNode* node, int tile_index, int elev, Rect* rect);
 static int obj_adjust_light(Object* obj, int a2, Rect* rect);
+static void obj_light_dirty_rect(int tile, int elevation, int distance, Rect* bounds, Rect* rect);
 static void obj_render_outline(Object* object, Rect* rect);
 static void obj_render_object(Object* object, Rect* rect, int light);
 static int obj_preload_sort(const void* a1, const void* a2);
+static bool obj_is_blocker(Object* obj);
+static void obj_blocking_changed(Object* obj);
+static void obj_blocking_moved(Object* obj, int oldElevation);
+static void obj_index_add(Object* obj);
+static void obj_index_refresh(int tile, int elevation);
+static int obj_index_next_tile(int elevation, int objectType, int tile);
+static unsigned long long obj_index_word(int elevation, int objectType, int word);
+static bool obj_index_test(int elevation, int objectType, int tile);
 
 // 0x505B70
 static bool objInitialized = false;
@@ -265,6 +277,21 @@ static char obj_seen_check[5001];
 // 0x6609A5
 static char obj_seen[5001];
 
+// Per-elevation counters bumped whenever something which can affect
+// `obj_blocking_at` changes on that elevation. Used to validate cached path
+// queries.
+static unsigned int obj_blocking_epochs[ELEVATION_COUNT] = { 1, 1, 1 };
+
+#define OBJ_INDEX_WORD_COUNT ((HEX_GRID_SIZE + 63) / 64)
+
+// Tile occupancy index for `objectTable`, one bitset per elevation and object
+// type, plus one for any type (at `OBJ_TYPE_COUNT`).
+//
+// Bits are set when an object is inserted into a tile list and only cleared
+// by queries which walked the tile and found nothing, so a clear bit always
+// means there is nothing to find (while a set bit can be stale).
+static unsigned long long obj_index[ELEVATION_COUNT][OBJ_TYPE_COUNT + 1][OBJ_INDEX_WORD_COUNT];
+
 // 0x47A590
 int obj_init(unsigned char* buf, int width, int height, int pitch)
 {
@@ -393,26 +420,27 @@ void obj_exit()
 // 0x47A904
 static int obj_read_obj(Object* obj, DB_FILE* stream)
 {
-    int field_74;
-
-    if (db_freadInt(stream, &(obj->id)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->tile)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->x)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->y)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->sx)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->sy)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->frame)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->rotation)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->fid)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->flags)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->elevation)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->pid)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->cid)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->lightDistance)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->lightIntensity)) == -1) return -1;
-    if (db_freadInt(stream, &field_74) == -1) return -1;
-    if (db_freadInt(stream, &(obj->sid)) == -1) return -1;
-    if (db_freadInt(stream, &(obj->messageListIndex)) == -1) return -1;
+    // CE: Read fixed part of the record at once.
+    int fields[18];
+    if (db_freadIntCount(stream, fields, 18) == -1) return -1;
+
+    obj->id = fields[0];
+    obj->tile = fields[1];
+    obj->x = fields[2];
+    obj->y = fields[3];
+    obj->sx = fields[4];
+    obj->sy = fields[5];
+    obj->frame = fields[6];
+    obj->rotation = fields[7];
+    obj->fid = fields[8];
+    obj->flags = fields[9];
+    obj->elevation = fields[10];
+    obj->pid = fields[11];
+    obj->cid = fields[12];
+    obj->lightDistance = fields[13];
+    obj->lightIntensity = fields[14];
+    obj->sid = fields[16];
+    obj->messageListIndex = fields[17];
 
     obj->outline = 0;
     obj->owner = NULL;
@@ -647,24 +675,28 @@ static void object_fix_weapon_ammo(Object* obj)
 // 0x47B000
 static int obj_write_obj(Object* obj, DB_FILE* stream)
 {
-    if (db_fwriteInt(stream, obj->id) == -1) return -1;
-    if (db_fwriteInt(stream, obj->tile) == -1) return -1;
-    if (db_fwriteInt(stream, obj->x) == -1) return -1;
-    if (db_fwriteInt(stream, obj->y) == -1) return -1;
-    if (db_fwriteInt(stream, obj->sx) == -1) return -1;
-    if (db_fwriteInt(stream, obj->sy) == -1) return -1;
-    if (db_fwriteInt(stream, obj->frame) == -1) return -1;
-    if (db_fwriteInt(stream, obj->rotation) == -1) return -1;
-    if (db_fwriteInt(stream, obj->fid) == -1) return -1;
-    if (db_fwriteInt(stream, obj->flags) == -1) return -1;
-    if (db_fwriteInt(stream, obj->elevation) == -1) return -1;
-    if (db_fwriteInt(stream, obj->pid) == -1) return -1;
-    if (db_fwriteInt(stream, obj->cid) == -1) return -1;
-    if (db_fwriteInt(stream, obj->lightDistance) == -1) return -1;
-    if (db_fwriteInt(stream, obj->lightIntensity) == -1) return -1;
-    if (db_fwriteInt(stream, obj->outline) == -1) return -1;
-    if (db_fwriteInt(stream, obj->sid) == -1) return -1;
-    if (db_fwriteInt(stream, obj->messageListIndex) == -1) return -1;
+    // CE: Write fixed part of the record at once.
+    int fields[18] = {
+        obj->id,
+        obj->tile,
+        obj->x,
+        obj->y,
+        obj->sx,
+        obj->sy,
+        obj->frame,
+        obj->rotation,
+        obj->fid,
+        obj->flags,
+        obj->elevation,
+        obj->pid,
+        obj->cid,
+        obj->lightDistance,
+        obj->lightIntensity,
+        obj->outline,
+        obj->sid,
+        obj->messageListIndex,
+    };
+    if (db_fwriteIntCount(stream, fields, 18) == -1) return -1;
     if (proto_write_protoUpdateData(obj, stream) == -1) return -1;
 
     return 0;
@@ -767,6 +799,8 @@ void obj_render_pre_roof(Rect* rect, int elevation)
         return;
     }
 
+    ProfilerZone zone("obj_render_pre_roof");
+
     Rect updatedRect;
     if (rect_inside_bound(rect, &buf_rect, &updatedRect) != 0) {
         return;
@@ -1087,7 +1121,13 @@ int obj_connect(Object* object, int tile, int elevation, Rect* rect)
 
     objectListNode->obj = object;
 
-    return obj_connect_to_tile(objectListNode, tile, elevation, rect);
+    if (obj_connect_to_tile(objectListNode, tile, elevation, rect) == -1) {
+        return -1;
+    }
+
+    obj_blocking_changed(object);
+
+    return 0;
 }
 
 // 0x47BC00
@@ -1103,6 +1143,8 @@ int obj_disconnect(Object* obj, Rect* rect)
         return -1;
     }
 
+    obj_blocking_changed(obj);
+
     if (obj_adjust_light(obj, 1, rect) == -1) {
         if (rect != NULL) {
             obj_bound(obj, rect);
@@ -1258,6 +1300,7 @@ int obj_move(Object* a1, int a2, int a3, int elevation, Rect* a5)
     ObjectListNode* node = NULL;
     ObjectListNode* previousNode;
     int v22 = 0;
+    int oldElevation = a1->elevation;
 
     int tile = a1->tile;
     if (hexGridTileIsValid(tile)) {
@@ -1325,6 +1368,7 @@ int obj_move(Object* a1, int a2, int a3, int elevation, Rect* a5)
 
     if (v22) {
         obj_insert(node);
+        obj_blocking_moved(a1, oldElevation);
     }
 
     if (a5 != NULL) {
@@ -1393,6 +1437,8 @@ int obj_move_to_tile(Object* obj, int tile, int elevation, Rect* rect)
         return -1;
     }
 
+    obj_blocking_moved(obj, oldElevation);
+
     if (rect != NULL) {
         rect_min_bound(rect, &v23, rect);
     }
@@ -1527,6 +1573,9 @@ int obj_change_fid(Object* obj, int fid, Rect* dirtyRect)
         obj->fid = fid;
     }
 
+    // Object might have changed type.
+    obj_index_add(obj);
+
     return 0;
 }
 
@@ -1830,6 +1879,8 @@ int obj_turn_on(Object* obj, Rect* rect)
     obj->flags &= ~OBJECT_HIDDEN;
     obj->outline &= ~OUTLINE_DISABLED;
 
+    obj_blocking_changed(obj);
+
     if (obj_adjust_light(obj, 0, rect) == -1) {
         if (rect != NULL) {
             obj_bound(obj, rect);
@@ -1866,6 +1917,8 @@ int obj_turn_off(Object* object, Rect* rect)
 
     object->flags |= OBJECT_HIDDEN;
 
+    obj_blocking_changed(object);
+
     if ((object->outline & OUTLINE_TYPE_MASK) != 0) {
         object->outline |= OUTLINE_DISABLED;
     }
@@ -2067,6 +2120,8 @@ void obj_remove_all()
 
     scr_remove_all();
 
+    obj_blocking_invalidate(-1);
+
     for (int tile = 0; tile < HEX_GRID_SIZE; tile++) {
         node = objectTable[tile];
         prev = NULL;
@@ -2138,6 +2193,12 @@ Object* obj_find_next()
 
     while (find_tile < HEX_GRID_SIZE) {
         if (objectListNode == NULL) {
+            // Iterates every elevation, skip tiles empty on all of them.
+            find_tile = obj_index_next_tile(-1, -1, find_tile);
+            if (find_tile >= HEX_GRID_SIZE) {
+                break;
+            }
+
             objectListNode = objectTable[find_tile++];
         }
 
@@ -2161,7 +2222,8 @@ Object* obj_find_first_at(int elevation)
     find_elev = elevation;
     find_tile = 0;
 
-    for (find_tile = 0; find_tile < HEX_GRID_SIZE; find_tile++) {
+    for (find_tile = obj_index_next_tile(elevation, -1, 0); find_tile < HEX_GRID_SIZE; find_tile = obj_index_next_tile(elevation, -1, find_tile + 1)) {
+        bool occupied = false;
         ObjectListNode* objectListNode = objectTable[find_tile];
         while (objectListNode != NULL) {
             Object* object = objectListNode->obj;
@@ -2170,9 +2232,14 @@ Object* obj_find_first_at(int elevation)
                     find_ptr = objectListNode;
                     return object;
                 }
+                occupied = true;
             }
             objectListNode = objectListNode->next;
         }
+
+        if (!occupied) {
+            obj_index_refresh(find_tile, elevation);
+        }
     }
 
     find_ptr = NULL;
@@ -2190,6 +2257,11 @@ Object* obj_find_next_at()
 
     while (find_tile < HEX_GRID_SIZE) {
         if (objectListNode == NULL) {
+            find_tile = obj_index_next_tile(find_elev, -1, find_tile);
+            if (find_tile >= HEX_GRID_SIZE) {
+                break;
+            }
+
             objectListNode = objectTable[find_tile++];
         }
 
@@ -2348,6 +2420,180 @@ Object* obj_blocking_at(Object* a1, int tile, int elev)
     return NULL;
 }
 
+// Returns counter which changes whenever result of `obj_blocking_at` on
+// given elevation might have changed.
+unsigned int obj_blocking_epoch(int elevation)
+{
+    if (!elevationIsValid(elevation)) {
+        return 0;
+    }
+
+    return obj_blocking_epochs[elevation];
+}
+
+// Marks blockers on given elevation (or all elevations when `elevation` is
+// -1) as changed.
+//
+// Most changes are tracked automatically when objects are connected, moved
+// or hidden. This function is for code that alters blocking-related flags
+// or door states directly.
+void obj_blocking_invalidate(int elevation)
+{
+    for (int index = 0; index < ELEVATION_COUNT; index++) {
+        if (elevation == -1 || elevation == index) {
+            obj_blocking_epochs[index] += 1;
+
+            // Zero is reserved for "never valid".
+            if (obj_blocking_epochs[index] == 0) {
+                obj_blocking_epochs[index] = 1;
+            }
+        }
+    }
+}
+
+// Returns true if object can be returned by `obj_blocking_at`.
+static bool obj_is_blocker(Object* obj)
+{
+    if ((obj->flags & OBJECT_NO_BLOCK) != 0) {
+        return false;
+    }
+
+    int type = FID_TYPE(obj->fid);
+    return type == OBJ_TYPE_CRITTER
+        || type == OBJ_TYPE_SCENERY
+        || type == OBJ_TYPE_WALL;
+}
+
+// Bumps blocking epoch of object's elevation unless object can never be
+// returned by `obj_blocking_at`.
+static void obj_blocking_changed(Object* obj)
+{
+    if (obj_is_blocker(obj)) {
+        obj_blocking_invalidate(obj->elevation);
+    }
+}
+
+// Same as `obj_blocking_changed` for object that has just been moved from
+// `oldElevation`. Called once the move is complete, so a step bumps epoch
+// once and paths cached in between steps of other critters stay usable.
+static void obj_blocking_moved(Object* obj, int oldElevation)
+{
+    if (!obj_is_blocker(obj)) {
+        return;
+    }
+
+    obj_blocking_invalidate(obj->elevation);
+
+    if (oldElevation != obj->elevation && elevationIsValid(oldElevation)) {
+        obj_blocking_invalidate(oldElevation);
+    }
+}
+
+// Marks object's tile as occupied in tile occupancy index.
+static void obj_index_add(Object* obj)
+{
+    if (!hexGridTileIsValid(obj->tile) || !elevationIsValid(obj->elevation)) {
+        return;
+    }
+
+    int word = obj->tile / 64;
+    unsigned long long bit = 1ULL << (obj->tile % 64);
+
+    int type = FID_TYPE(obj->fid);
+    if (type < OBJ_TYPE_COUNT) {
+        obj_index[obj->elevation][type][word] |= bit;
+    }
+
+    obj_index[obj->elevation][OBJ_TYPE_COUNT][word] |= bit;
+}
+
+// Rebuilds index bits of given tile from its object list.
+static void obj_index_refresh(int tile, int elevation)
+{
+    if (!hexGridTileIsValid(tile) || !elevationIsValid(elevation)) {
+        return;
+    }
+
+    int word = tile / 64;
+    unsigned long long bit = 1ULL << (tile % 64);
+
+    for (int type = 0; type <= OBJ_TYPE_COUNT; type++) {
+        obj_index[elevation][type][word] &= ~bit;
+    }
+
+    ObjectListNode* objectListNode = objectTable[tile];
+    while (objectListNode != NULL) {
+        if (objectListNode->obj->elevation == elevation) {
+            obj_index_add(objectListNode->obj);
+        }
+        objectListNode = objectListNode->next;
+    }
+}
+
+// Returns first tile starting from `tile` which might contain objects of
+// given type (-1 - any type) on given elevation (-1 - any elevation), or
+// `HEX_GRID_SIZE` if there are none.
+static int obj_index_next_tile(int elevation, int objectType, int tile)
+{
+    if (tile < 0) {
+        tile = 0;
+    }
+
+    if (tile >= HEX_GRID_SIZE) {
+        return HEX_GRID_SIZE;
+    }
+
+    if (objectType == -1) {
+        objectType = OBJ_TYPE_COUNT;
+    }
+
+    // Index does not know about such objects, visit every tile.
+    if ((elevation != -1 && !elevationIsValid(elevation)) || objectType < 0 || objectType > OBJ_TYPE_COUNT) {
+        return tile;
+    }
+
+    int word = tile / 64;
+    unsigned long long mask = obj_index_word(elevation, objectType, word) & (~0ULL << (tile % 64));
+
+    while (mask == 0) {
+        word++;
+        if (word >= OBJ_INDEX_WORD_COUNT) {
+            return HEX_GRID_SIZE;
+        }
+        mask = obj_index_word(elevation, objectType, word);
+    }
+
+    tile = word * 64;
+    while ((mask & 1) == 0) {
+        mask >>= 1;
+        tile++;
+    }
+
+    return tile < HEX_GRID_SIZE ? tile : HEX_GRID_SIZE;
+}
+
+// Returns index bits of given word, elevation -1 merges bits of every
+// elevation.
+static unsigned long long obj_index_word(int elevation, int objectType, int word)
+{
+    if (elevation != -1) {
+        return obj_index[elevation][objectType][word];
+    }
+
+    unsigned long long bits = 0;
+    for (int index = 0; index < ELEVATION_COUNT; index++) {
+        bits |= obj_index[index][objectType][word];
+    }
+    return bits;
+}
+
+// Returns `false` if given tile definitely has no objects of given type (-1 -
+// any type) on given elevation.
+static bool obj_index_test(int elevation, int objectType, int tile)
+{
+    return obj_index_next_tile(elevation, objectType, tile) == tile;
+}
+
 // 0x47D3D8
 int obj_scroll_blocking_at(int tile, int elev)
 {
@@ -2422,17 +2668,24 @@ int obj_create_list(int tile, int elevation, int objectType, Object*** objectLis
 
     int count = 0;
     if (tile == -1) {
-        for (int index = 0; index < HEX_GRID_SIZE; index++) {
+        for (int index = obj_index_next_tile(elevation, objectType, 0); index < HEX_GRID_SIZE; index = obj_index_next_tile(elevation, objectType, index + 1)) {
+            bool occupied = false;
             ObjectListNode* objectListNode = objectTable[index];
             while (objectListNode != NULL) {
                 Object* obj = objectListNode->obj;
-                if ((obj->flags & OBJECT_HIDDEN) == 0
-                    && obj->elevation == elevation
+                if (obj->elevation == elevation
                     && FID_TYPE(obj->fid) == objectType) {
-                    count++;
+                    if ((obj->flags & OBJECT_HIDDEN) == 0) {
+                        count++;
+                    }
+                    occupied = true;
                 }
                 objectListNode = objectListNode->next;
             }
+
+            if (!occupied) {
+                obj_index_refresh(index, elevation);
+            }
         }
     } else {
         ObjectListNode* objectListNode = objectTable[tile];
@@ -2457,7 +2710,7 @@ int obj_create_list(int tile, int elevation, int objectType, Object*** objectLis
     }
 
     if (tile == -1) {
-        for (int index = 0; index < HEX_GRID_SIZE; index++) {
+        for (int index = obj_index_next_tile(elevation, objectType, 0); index < HEX_GRID_SIZE; index = obj_index_next_tile(elevation, objectType, index + 1)) {
             ObjectListNode* objectListNode = objectTable[index];
             while (objectListNode) {
                 Object* obj = objectListNode->obj;
@@ -2524,90 +2777,51 @@ void dark_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int
     unsigned char* sp = src;
     unsigned char* dp = dest + destPitch * destY + destX;
 
-    int srcStep = srcPitch - srcWidth;
-    int destStep = destPitch - srcWidth;
     // TODO: Name might be confusing.
     int lightModifier = light >> 9;
 
-    for (int y = 0; y < srcHeight; y++) {
-        for (int x = 0; x < srcWidth; x++) {
-            unsigned char b = *sp;
-            if (b != 0) {
-                if (b < 0xE5) {
-                    b = intensityColorTable[b][lightModifier];
-                }
-
-                *dp = b;
-            }
-
-            sp++;
-            dp++;
-        }
+    // CE: Light is the same for every pixel, so shade palette once instead
+    // of looking up column of `intensityColorTable` per pixel.
+    unsigned char shade[256];
+    shade_build_table(shade, lightModifier, true);
 
-        sp += srcStep;
-        dp += destStep;
+    for (int y = 0; y < srcHeight; y++) {
+        shade_dark_trans_row(sp, dp, srcWidth, shade);
+        sp += srcPitch;
+        dp += destPitch;
     }
 }
 
 // 0x47D7E4
 void dark_translucent_trans_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destX, int destY, int destPitch, int light, unsigned char* a10, unsigned char* a11)
 {
-    int srcStep = srcPitch - srcWidth;
-    int destStep = destPitch - srcWidth;
     int lightModifier = light >> 9;
 
     dest += destPitch * destY + destX;
 
-    for (int y = 0; y < srcHeight; y++) {
-        for (int x = 0; x < srcWidth; x++) {
-            unsigned char srcByte = *src;
-            if (srcByte != 0) {
-                unsigned char destByte = *dest;
-                unsigned int index = a11[srcByte] << 8;
-                index = a10[index + destByte];
-                *dest = intensityColorTable[index][lightModifier];
-            }
-
-            src++;
-            dest++;
-        }
+    unsigned char shade[256];
+    shade_build_table(shade, lightModifier, false);
 
-        src += srcStep;
-        dest += destStep;
+    for (int y = 0; y < srcHeight; y++) {
+        shade_dark_translucent_trans_row(src, dest, srcWidth, shade, a10, a11);
+        src += srcPitch;
+        dest += destPitch;
     }
 }
 
 // 0x47D898
 void intensity_mask_buf_to_buf(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int light)
 {
-    int srcStep = srcPitch - srcWidth;
-    int destStep = destPitch - srcWidth;
-    int maskStep = maskPitch - srcWidth;
     light >>= 9;
 
-    for (int y = 0; y < srcHeight; y++) {
-        for (int x = 0; x < srcWidth; x++) {
-            unsigned char b = *src;
-            if (b != 0) {
-                b = intensityColorTable[b][light];
-                unsigned char m = *mask;
-                if (m != 0) {
-                    unsigned char d = *dest;
-                    int q = intensityColorTable[d][128 - m];
-                    m = intensityColorTable[b][m];
-                    b = colorMixAddTable[m][q];
-                }
-                *dest = b;
-            }
-
-            src++;
-            dest++;
-            mask++;
-        }
+    unsigned char shade[256];
+    shade_build_table(shade, light, false);
 
-        src += srcStep;
-        dest += destStep;
-        mask += maskStep;
+    for (int y = 0; y < srcHeight; y++) {
+        shade_intensity_mask_row(src, dest, mask, srcWidth, shade);
+        src += srcPitch;
+        dest += destPitch;
+        mask += maskPitch;
     }
 }
 
@@ -2762,7 +2976,7 @@ int obj_create_intersect_list(int x, int y, int elevation, int objectType, Objec
         int offsetIndex = orderTable[parity][index];
         if (offsetDivTable[offsetIndex] < 30 && offsetModTable[offsetIndex] < 20) {
             int tile = offsetTable[parity][offsetIndex] + upperLeftTile;
-            ObjectListNode* objectListNode = hexGridTileIsValid(tile)
+            ObjectListNode* objectListNode = hexGridTileIsValid(tile) && obj_index_test(elevation, objectType, tile)
                 ? objectTable[tile]
                 : NULL;
             while (objectListNode != NULL) {
@@ -2942,6 +3156,29 @@ void obj_preload_art_cache(int flags)
         v11++;
     }
 
+    // CE: Queue everything to background workers in the same order it is
+    // locked below. The loop below then mostly picks up files that are
+    // already decompressed in memory.
+    art_prefetch(*preload_list);
+
+    for (int i = 1; i < v11; i++) {
+        if (preload_list[i - 1] != preload_list[i]) {
+            art_prefetch(preload_list[i]);
+        }
+    }
+
+    for (int i = 0; i < 4096; i++) {
+        if (arr[i] != 0) {
+            art_prefetch(art_id(OBJ_TYPE_TILE, i, 0, 0, 0));
+        }
+    }
+
+    for (int i = v11; i < preload_list_index; i++) {
+        if (preload_list[i - 1] != preload_list[i]) {
+            art_prefetch(preload_list[i]);
+        }
+    }
+
     CacheEntry* cache_handle;
     if (art_ptr_lock(*preload_list, &cache_handle) != NULL) {
         art_ptr_unlock(cache_handle);
@@ -2972,6 +3209,8 @@ void obj_preload_art_cache(int flags)
         }
     }
 
+    db_prefetch_clear();
+
     mem_free(preload_list);
     preload_list = NULL;
 
@@ -2987,6 +3226,8 @@ static int obj_object_table_init()
         objectTable[tile] = NULL;
     }
 
+    memset(obj_index, 0, sizeof(obj_index));
+
     return 0;
 }
 
@@ -3504,6 +3745,8 @@ static void obj_destroy_object(Object** objectPtr)
         return;
     }
 
+    light_forget_source(*objectPtr);
+
     mem_free(*objectPtr);
 
     *objectPtr = NULL;
@@ -3648,6 +3891,8 @@ static void obj_insert(ObjectListNode* objectListNode)
 
     objectListNode->next = *objectListNodePtr;
     *objectListNodePtr = objectListNode;
+
+    obj_index_add(objectListNode->obj);
 }
 
 // 0x47F13C
@@ -3729,6 +3974,34 @@ static int obj_adjust_light(Object* obj, int a2, Rect* rect)
         return -1;
     }
 
+    // CE: Every light source remembers the tiles it has lit. Turning light
+    // off takes back exactly what was added instead of tracing it again
+    // against (possibly changed) surroundings, so tile light never drifts.
+    // This also means light cannot be applied twice.
+    LightSource source;
+    bool removed = light_remove_source(obj, &source);
+
+    if (a2) {
+        if (!removed) {
+            return -1;
+        }
+
+        if (rect != NULL) {
+            int x;
+            int y;
+            tile_coord(source.tile, &x, &y, source.elevation);
+            rectOffset(&(source.bounds), x, y);
+
+            Rect objectRect;
+            obj_bound(obj, &objectRect);
+            rect_min_bound(&objectRect, &(source.bounds), &objectRect);
+
+            obj_light_dirty_rect(source.tile, source.elevation, source.distance, &objectRect, rect);
+        }
+
+        return 0;
+    }
+
     if (obj->lightIntensity <= 0) {
         return -1;
     }
@@ -3745,8 +4018,10 @@ static int obj_adjust_light(Object* obj, int a2, Rect* rect)
         return -1;
     }
 
-    AdjustLightIntensityProc* adjustLightIntensity = a2 ? light_subtract_from_tile : light_add_to_tile;
-    adjustLightIntensity(obj->elevation, obj->tile, obj->lightIntensity);
+    source.elevation = obj->elevation;
+    source.tile = obj->tile;
+    source.contributions.clear();
+    source.contributions.push_back({ obj->tile, obj->lightIntensity });
 
     Rect objectRect;
     obj_bound(obj, &objectRect);
@@ -4358,7 +4633,7 @@ static int obj_adjust_light(Object* obj, int a2, Rect* rect)
                         }
 
                         if (v12) {
-                            adjustLightIntensity(obj->elevation, tile, v28[index]);
+                            source.contributions.push_back({ tile, v28[index] });
                         }
                     }
                 }
@@ -4368,26 +4643,43 @@ static int obj_adjust_light(Object* obj, int a2, Rect* rect)
         }
     }
 
-    if (rect != NULL) {
-        Rect* lightDistanceRect = &(light_rect[obj->lightDistance]);
-        memcpy(rect, lightDistanceRect, sizeof(*lightDistanceRect));
+    source.distance = obj->lightDistance;
 
-        int x;
-        int y;
-        tile_coord(obj->tile, &x, &y, obj->elevation);
-        x += 16;
-        y += 8;
+    int x;
+    int y;
+    tile_coord(obj->tile, &x, &y, obj->elevation);
+    source.bounds = objectRect;
+    rectOffset(&(source.bounds), -x, -y);
 
-        x -= rect->lrx / 2;
-        y -= rect->lry / 2;
+    light_add_source(obj, &source);
 
-        rectOffset(rect, x, y);
-        rect_min_bound(rect, &objectRect, rect);
+    if (rect != NULL) {
+        obj_light_dirty_rect(obj->tile, obj->elevation, obj->lightDistance, &objectRect, rect);
     }
 
     return 0;
 }
 
+// Calculates area affected by light of given radius at given tile, extended
+// to include `bounds` (lit objects).
+static void obj_light_dirty_rect(int tile, int elevation, int distance, Rect* bounds, Rect* rect)
+{
+    Rect* lightDistanceRect = &(light_rect[distance]);
+    memcpy(rect, lightDistanceRect, sizeof(*lightDistanceRect));
+
+    int x;
+    int y;
+    tile_coord(tile, &x, &y, elevation);
+    x += 16;
+    y += 8;
+
+    x -= rect->lrx / 2;
+    y -= rect->lry / 2;
+
+    rectOffset(rect, x, y);
+    rect_min_bound(rect, bounds, rect);
+}
+
 // 0x4801A0
 static void obj_render_outline(Object* object, Rect* rect)
 {
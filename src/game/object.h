@@ -71,6 +71,8 @@ Object* obj_find_next_at();
 void obj_bound(Object* obj, Rect* rect);
 bool obj_occupied(int tile_num, int elev);
 Object* obj_blocking_at(Object* a1, int tile_num, int elev);
+unsigned int obj_blocking_epoch(int elevation);
+void obj_blocking_invalidate(int elevation);
 int obj_scroll_blocking_at(int tile_num, int elev);
 Object* obj_sight_blocking_at(Object* a1, int tile_num, int elev);
 int obj_dist(Object* object1, Object* object2);
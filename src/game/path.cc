@@ -0,0 +1,295 @@
+#include "game/path.h"
+
+#include <string.h>
+
+#include "game/map_defs.h"
+#include "game/tile.h"
+
+namespace fallout {
+
+// Node in the open list of `path_find`.
+//
+// The original implementation kept open nodes in a flat 2000-slot array,
+// picked the best one with a linear scan (first slot wins on ties), and put
+// new nodes into the lowest free slot. `slot` keeps track of that virtual
+// slot so the heap can break ties the same way and produce identical paths.
+typedef struct PathNode {
+    int tile;
+    // actual type is likely char
+    int rotation;
+    int field_C;
+    int field_10;
+    int slot;
+} PathNode;
+
+static bool path_node_less(const PathNode* a, const PathNode* b);
+static void path_open_push(const PathNode* node);
+static void path_open_pop(PathNode* node);
+static int path_slot_alloc();
+static void path_slot_free(int slot);
+
+// Binary min-heap of open nodes ordered by `path_node_less`.
+static PathNode path_open[20000];
+
+// Number of nodes in `path_open`.
+static int path_open_length;
+
+// Binary min-heap of slots released by popped nodes.
+static int path_free_slots[20000];
+
+// Number of slots in `path_free_slots`.
+static int path_free_slots_length;
+
+// Lowest slot that has never been handed out during current search.
+static int path_next_slot;
+
+// Generation stamp per tile. A tile is seen in current search when its stamp
+// equals `path_generation`, which saves clearing this array on every call.
+static unsigned int path_seen[HEX_GRID_SIZE];
+
+// Current search generation.
+static unsigned int path_generation;
+
+// Tile the path came from for every seen tile.
+static int path_parent[HEX_GRID_SIZE];
+
+// Rotation used to step into every seen tile.
+static unsigned char path_rotation[HEX_GRID_SIZE];
+
+int path_find(Object* object, int from, int to, unsigned char* rotations, bool turnPenalty, PathBuilderCallback* callback, PathDoorCallback* canUseDoor)
+{
+    path_generation += 1;
+    if (path_generation == 0) {
+        memset(path_seen, 0, sizeof(path_seen));
+        path_generation = 1;
+    }
+
+    path_open_length = 0;
+    path_free_slots_length = 0;
+    path_next_slot = 0;
+
+    path_seen[from] = path_generation;
+
+    PathNode temp;
+    temp.tile = from;
+    temp.rotation = 0;
+    temp.field_C = EST(from, to);
+    temp.field_10 = 0;
+    temp.slot = path_slot_alloc();
+    path_open_push(&temp);
+
+    int toScreenX;
+    int toScreenY;
+    tile_coord(to, &toScreenX, &toScreenY, object->elevation);
+
+    int closedPathNodeListLength = 0;
+
+    while (1) {
+        path_open_pop(&temp);
+        path_slot_free(temp.slot);
+
+        if (temp.tile == to) {
+            break;
+        }
+
+        closedPathNodeListLength += 1;
+
+        if (closedPathNodeListLength == 20000) {
+            return 0;
+        }
+
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+            int tile = tile_num_in_direction(temp.tile, rotation, 1);
+            if (path_seen[tile] == path_generation) {
+                continue;
+            }
+
+            if (tile != to) {
+                Object* v24 = callback(object, tile, object->elevation);
+                if (v24 != NULL) {
+                    if (!canUseDoor(object, v24)) {
+                        continue;
+                    }
+                }
+            }
+
+            if (path_open_length + 1 == 20000) {
+                return 0;
+            }
+
+            path_seen[tile] = path_generation;
+            path_parent[tile] = temp.tile;
+            path_rotation[tile] = rotation & 0xFF;
+
+            int newX;
+            int newY;
+            tile_coord(tile, &newX, &newY, object->elevation);
+
+            PathNode node;
+            node.tile = tile;
+            node.rotation = rotation;
+            node.field_C = idist(newX, newY, toScreenX, toScreenY);
+            node.field_10 = temp.field_10 + 50;
+
+            if (turnPenalty && temp.rotation != rotation) {
+                node.field_10 += 10;
+            }
+
+            node.slot = path_slot_alloc();
+            path_open_push(&node);
+        }
+
+        if (path_open_length == 0) {
+            return 0;
+        }
+    }
+
+    int tile = to;
+    int index = 0;
+    for (; index < 20000; index++) {
+        if (tile == from) {
+            break;
+        }
+
+        if (rotations != NULL) {
+            rotations[index] = path_rotation[tile];
+        }
+
+        tile = path_parent[tile];
+    }
+
+    if (rotations != NULL) {
+        // A* finishes it's path from end to start, reverse it start-to-end.
+        unsigned char* beginning = rotations;
+        unsigned char* ending = rotations + index - 1;
+        int middle = index / 2;
+        for (int index = 0; index < middle; index++) {
+            unsigned char rotation = *ending;
+            *ending = *beginning;
+            *beginning = rotation;
+
+            ending -= 1;
+            beginning += 1;
+        }
+    }
+
+    return index;
+}
+
+static bool path_node_less(const PathNode* a, const PathNode* b)
+{
+    int aCost = a->field_C + a->field_10;
+    int bCost = b->field_C + b->field_10;
+    if (aCost != bCost) {
+        return aCost < bCost;
+    }
+
+    return a->slot < b->slot;
+}
+
+static void path_open_push(const PathNode* node)
+{
+    int index = path_open_length;
+    path_open_length += 1;
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!path_node_less(node, &(path_open[parent]))) {
+            break;
+        }
+
+        path_open[index] = path_open[parent];
+        index = parent;
+    }
+
+    path_open[index] = *node;
+}
+
+static void path_open_pop(PathNode* node)
+{
+    *node = path_open[0];
+
+    path_open_length -= 1;
+    if (path_open_length == 0) {
+        return;
+    }
+
+    PathNode* last = &(path_open[path_open_length]);
+
+    int index = 0;
+    while (1) {
+        int child = index * 2 + 1;
+        if (child >= path_open_length) {
+            break;
+        }
+
+        if (child + 1 < path_open_length && path_node_less(&(path_open[child + 1]), &(path_open[child]))) {
+            child += 1;
+        }
+
+        if (!path_node_less(&(path_open[child]), last)) {
+            break;
+        }
+
+        path_open[index] = path_open[child];
+        index = child;
+    }
+
+    path_open[index] = *last;
+}
+
+// Returns lowest slot not occupied by an open node.
+static int path_slot_alloc()
+{
+    if (path_free_slots_length == 0) {
+        return path_next_slot++;
+    }
+
+    int slot = path_free_slots[0];
+
+    path_free_slots_length -= 1;
+    int last = path_free_slots[path_free_slots_length];
+
+    int index = 0;
+    while (1) {
+        int child = index * 2 + 1;
+        if (child >= path_free_slots_length) {
+            break;
+        }
+
+        if (child + 1 < path_free_slots_length && path_free_slots[child + 1] < path_free_slots[child]) {
+            child += 1;
+        }
+
+        if (path_free_slots[child] >= last) {
+            break;
+        }
+
+        path_free_slots[index] = path_free_slots[child];
+        index = child;
+    }
+
+    path_free_slots[index] = last;
+
+    return slot;
+}
+
+static void path_slot_free(int slot)
+{
+    int index = path_free_slots_length;
+    path_free_slots_length += 1;
+
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (path_free_slots[parent] <= slot) {
+            break;
+        }
+
+        path_free_slots[index] = path_free_slots[parent];
+        index = parent;
+    }
+
+    path_free_slots[index] = slot;
+}
+
+} // namespace fallout
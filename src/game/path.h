@@ -0,0 +1,22 @@
+#ifndef FALLOUT_GAME_PATH_H_
+#define FALLOUT_GAME_PATH_H_
+
+#include "game/anim.h"
+#include "game/object_types.h"
+
+namespace fallout {
+
+typedef bool PathDoorCallback(Object* critter, Object* door);
+
+// A* search behind `make_path_func`. Tiles for which `callback` returns an
+// object are passable only if `canUseDoor` allows it (destination tile is not
+// checked). `turnPenalty` makes every change of direction cost extra, which
+// is what the game does outside of combat.
+//
+// Returns number of steps and stores their rotations start to end (when
+// `rotations` is not `NULL`), or 0 if there is no path.
+int path_find(Object* object, int from, int to, unsigned char* rotations, bool turnPenalty, PathBuilderCallback* callback, PathDoorCallback* canUseDoor);
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_PATH_H_ */
@@ -1188,6 +1188,7 @@ int obj_use(Object* a1, Object* a2)
 static int set_door_state_open(Object* a1, Object* a2)
 {
     a1->data.scenery.door.openFlags |= 0x01;
+    obj_blocking_invalidate(a1->elevation);
     return 0;
 }
 
@@ -1195,12 +1196,15 @@ static int set_door_state_open(Object* a1, Object* a2)
 static int set_door_state_closed(Object* a1, Object* a2)
 {
     a1->data.scenery.door.openFlags &= ~0x01;
+    obj_blocking_invalidate(a1->elevation);
     return 0;
 }
 
 // 0x48B81C
 static int check_door_state(Object* a1, Object* a2)
 {
+    obj_blocking_invalidate(a1->elevation);
+
     if ((a1->data.scenery.door.openFlags & 0x01) == 0) {
         a1->flags &= ~OBJECT_OPEN_DOOR;
 
@@ -1551,6 +1555,7 @@ int obj_lock(Object* object)
         break;
     case OBJ_TYPE_SCENERY:
         object->data.scenery.door.openFlags |= OBJ_LOCKED;
+        obj_blocking_invalidate(object->elevation);
         break;
     default:
         return -1;
@@ -1572,6 +1577,7 @@ int obj_unlock(Object* object)
         return 0;
     case OBJ_TYPE_SCENERY:
         object->data.scenery.door.openFlags &= ~OBJ_LOCKED;
+        obj_blocking_invalidate(object->elevation);
         return 0;
     }
 
@@ -437,13 +437,13 @@ static int proto_write_CombatData(CritterCombatData* data, DB_FILE* stream)
 int proto_read_protoUpdateData(Object* obj, DB_FILE* stream)
 {
     Proto* proto;
-    int temp;
 
     Inventory* inventory = &(obj->data.inventory);
-    if (db_freadInt32(stream, &(inventory->length)) == -1) return -1;
-    if (db_freadInt32(stream, &(inventory->capacity)) == -1) return -1;
     // CE: Original code reads inventory items pointer which is meaningless.
-    if (db_freadInt32(stream, &temp) == -1) return -1;
+    int header[3];
+    if (db_freadInt32List(stream, header, 3) == -1) return -1;
+    inventory->length = header[0];
+    inventory->capacity = header[1];
 
     if (PID_TYPE(obj->pid) == OBJ_TYPE_CRITTER) {
         if (db_freadInt32(stream, &(obj->data.critter.field_0)) == -1) return -1;
@@ -793,6 +793,9 @@ int proto_dude_init(const char* path)
 
     if ((obj_dude->flags & OBJECT_NO_BLOCK) != 0) {
         obj_dude->flags &= ~OBJECT_NO_BLOCK;
+
+        // CE: Dude now blocks its tile, drop paths cached through it.
+        obj_blocking_invalidate(obj_dude->elevation);
     }
 
     stat_recalc_derived(obj_dude);
@@ -1,5 +1,9 @@
 #include "game/queue.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
 #include "game/actions.h"
 #include "game/critter.h"
 #include "game/display.h"
@@ -14,18 +18,40 @@
 #include "game/proto.h"
 #include "game/scripts.h"
 #include "plib/gnw/memory.h"
+#include "profiler.h"
 
 namespace fallout {
 
+// CE: Events are kept in a binary min-heap instead of a sorted list, and
+// every event is also linked into the list of its owner's events, so that
+// adding an event costs O(log n) and lookups by owner do not scan the whole
+// queue.
 typedef struct QueueListNode {
     // TODO: Make unsigned.
     int time;
     int type;
     Object* owner;
     void* data;
-    struct QueueListNode* next;
+
+    // CE: Order of events with the same time. Events are processed in the
+    // order they were added, the same way sorted list did.
+    unsigned long long seq;
+
+    // CE: Position in `queue_heap`, -1 when event is not scheduled.
+    int heapIndex;
+
+    // CE: Siblings in the list of events of the same owner.
+    struct QueueListNode* ownerPrev;
+    struct QueueListNode* ownerNext;
 } QueueListNode;
 
+static bool queue_node_less(QueueListNode* a, QueueListNode* b);
+static void queue_sift_up(int index);
+static void queue_sift_down(int index);
+static void queue_insert(QueueListNode* queueListNode);
+static void queue_unlink(QueueListNode* queueListNode);
+static void queue_free_node(QueueListNode* queueListNode);
+static void queue_sorted(std::vector<QueueListNode*>& nodes, int eventType);
 static int queue_destroy(Object* obj, void* data);
 static int queue_explode(Object* obj, void* data);
 static int queue_explode_exit(Object* obj, void* data);
@@ -49,13 +75,33 @@ EventTypeDescription q_func[EVENT_TYPE_COUNT] = {
     { scr_map_q_process, NULL, NULL, NULL, true, NULL },
 };
 
-// 0x662F4C
-static QueueListNode* queue;
+// CE: Scheduled events ordered by time and then by `seq`, the earliest one
+// is at the front.
+static std::vector<QueueListNode*> queue_heap;
+
+// CE: First event of every owner (including `NULL`).
+static std::unordered_map<Object*, QueueListNode*> queue_owners;
+
+// CE: Sequence number of the next added event.
+static unsigned long long queue_next_seq;
+
+// CE: Number of nested `queue_clear_type` calls running clear handlers. While
+// it's not zero removed events are not freed immediately, because
+// `queue_clear_type` may still hold pointers to them.
+static int queue_clearing;
+
+// CE: Removed events waiting for `queue_clear_type` to finish.
+static std::vector<QueueListNode*> queue_removed;
+
+// CE: Events added while `queue_clear_type` runs clear handlers.
+static std::vector<QueueListNode*>* queue_added;
 
 // 0x490670
 void queue_init()
 {
-    queue = NULL;
+    queue_heap.clear();
+    queue_owners.clear();
+    queue_next_seq = 0;
 }
 
 // 0x490680
@@ -80,10 +126,8 @@ int queue_load(DB_FILE* stream)
         return -1;
     }
 
-    queue = NULL;
-
-    QueueListNode** nextPtr = &queue;
-
+    // Events are saved in the order they are processed, so adding them one
+    // by one gives the same order.
     int rc = 0;
     for (int index = 0; index < count; index += 1) {
         QueueListNode* queueListNode = (QueueListNode*)mem_malloc(sizeof(*queueListNode));
@@ -138,25 +182,12 @@ int queue_load(DB_FILE* stream)
             queueListNode->data = NULL;
         }
 
-        queueListNode->next = NULL;
-
-        *nextPtr = queueListNode;
-        nextPtr = &(queueListNode->next);
+        queueListNode->seq = queue_next_seq++;
+        queue_insert(queueListNode);
     }
 
     if (rc == -1) {
-        while (queue != NULL) {
-            QueueListNode* next = queue->next;
-
-            EventTypeDescription* eventTypeDescription = &(q_func[queue->type]);
-            if (eventTypeDescription->freeProc != NULL) {
-                eventTypeDescription->freeProc(queue->data);
-            }
-
-            mem_free(queue);
-
-            queue = next;
-        }
+        queue_clear();
     }
 
     return rc;
@@ -165,22 +196,16 @@ int queue_load(DB_FILE* stream)
 // 0x4907F4
 int queue_save(DB_FILE* stream)
 {
-    QueueListNode* queueListNode;
+    // CE: Heap is not sorted, write events in the order they would be
+    // processed, the same way the list was written.
+    std::vector<QueueListNode*> nodes;
+    queue_sorted(nodes, -1);
 
-    int count = 0;
-
-    queueListNode = queue;
-    while (queueListNode != NULL) {
-        count += 1;
-        queueListNode = queueListNode->next;
-    }
-
-    if (db_fwriteInt(stream, count) == -1) {
+    if (db_fwriteInt(stream, static_cast<int>(nodes.size())) == -1) {
         return -1;
     }
 
-    queueListNode = queue;
-    while (queueListNode != NULL) {
+    for (QueueListNode* queueListNode : nodes) {
         Object* object = queueListNode->owner;
         int objectId = object != NULL ? object->id : -2;
 
@@ -202,8 +227,6 @@ int queue_save(DB_FILE* stream)
                 return -1;
             }
         }
-
-        queueListNode = queueListNode->next;
     }
 
     return 0;
@@ -223,54 +246,37 @@ int queue_add(int delay, Object* obj, void* data, int eventType)
     newQueueListNode->type = eventType;
     newQueueListNode->owner = obj;
     newQueueListNode->data = data;
+    newQueueListNode->seq = queue_next_seq++;
 
     if (obj != NULL) {
         obj->flags |= OBJECT_USED;
     }
 
-    QueueListNode** v3 = &queue;
+    queue_insert(newQueueListNode);
 
-    if (queue != NULL) {
-        QueueListNode* v4;
-
-        do {
-            v4 = *v3;
-            if (v2 < v4->time) {
-                break;
-            }
-            v3 = &(v4->next);
-        } while (v4->next != NULL);
+    if (queue_added != NULL) {
+        queue_added->push_back(newQueueListNode);
     }
 
-    newQueueListNode->next = *v3;
-    *v3 = newQueueListNode;
-
     return 0;
 }
 
 // 0x490908
 int queue_remove(Object* owner)
 {
-    QueueListNode* queueListNode = queue;
-    QueueListNode** queueListNodePtr = &queue;
-
-    while (queueListNode) {
-        if (queueListNode->owner == owner) {
-            QueueListNode* temp = queueListNode;
+    auto it = queue_owners.find(owner);
+    if (it == queue_owners.end()) {
+        return 0;
+    }
 
-            queueListNode = queueListNode->next;
-            *queueListNodePtr = queueListNode;
+    QueueListNode* queueListNode = it->second;
+    while (queueListNode != NULL) {
+        QueueListNode* next = queueListNode->ownerNext;
 
-            EventTypeDescription* eventTypeDescription = &(q_func[temp->type]);
-            if (eventTypeDescription->freeProc != NULL) {
-                eventTypeDescription->freeProc(temp->data);
-            }
+        queue_unlink(queueListNode);
+        queue_free_node(queueListNode);
 
-            mem_free(temp);
-        } else {
-            queueListNodePtr = &(queueListNode->next);
-            queueListNode = queueListNode->next;
-        }
+        queueListNode = next;
     }
 
     return 0;
@@ -279,26 +285,21 @@ int queue_remove(Object* owner)
 // 0x490960
 int queue_remove_this(Object* owner, int eventType)
 {
-    QueueListNode* queueListNode = queue;
-    QueueListNode** queueListNodePtr = &queue;
-
-    while (queueListNode) {
-        if (queueListNode->owner == owner && queueListNode->type == eventType) {
-            QueueListNode* temp = queueListNode;
-
-            queueListNode = queueListNode->next;
-            *queueListNodePtr = queueListNode;
+    auto it = queue_owners.find(owner);
+    if (it == queue_owners.end()) {
+        return 0;
+    }
 
-            EventTypeDescription* eventTypeDescription = &(q_func[temp->type]);
-            if (eventTypeDescription->freeProc != NULL) {
-                eventTypeDescription->freeProc(temp->data);
-            }
+    QueueListNode* queueListNode = it->second;
+    while (queueListNode != NULL) {
+        QueueListNode* next = queueListNode->ownerNext;
 
-            mem_free(temp);
-        } else {
-            queueListNodePtr = &(queueListNode->next);
-            queueListNode = queueListNode->next;
+        if (queueListNode->type == eventType) {
+            queue_unlink(queueListNode);
+            queue_free_node(queueListNode);
         }
+
+        queueListNode = next;
     }
 
     return 0;
@@ -309,13 +310,18 @@ int queue_remove_this(Object* owner, int eventType)
 // 0x4909BC
 bool queue_find(Object* owner, int eventType)
 {
-    QueueListNode* queueListEvent = queue;
+    auto it = queue_owners.find(owner);
+    if (it == queue_owners.end()) {
+        return false;
+    }
+
+    QueueListNode* queueListEvent = it->second;
     while (queueListEvent != NULL) {
-        if (owner == queueListEvent->owner && eventType == queueListEvent->type) {
+        if (eventType == queueListEvent->type) {
             return true;
         }
 
-        queueListEvent = queueListEvent->next;
+        queueListEvent = queueListEvent->ownerNext;
     }
 
     return false;
@@ -324,25 +330,23 @@ bool queue_find(Object* owner, int eventType)
 // 0x4909E4
 int queue_process()
 {
+    ProfilerZone zone("queue_process");
+
     int time = game_time();
     int v1 = 0;
 
-    while (queue != NULL) {
-        QueueListNode* queueListNode = queue;
+    while (!queue_heap.empty()) {
+        QueueListNode* queueListNode = queue_heap[0];
         if (time < queueListNode->time || v1 != 0) {
             break;
         }
 
-        queue = queueListNode->next;
+        queue_unlink(queueListNode);
 
         EventTypeDescription* eventTypeDescription = &(q_func[queueListNode->type]);
         v1 = eventTypeDescription->handlerProc(queueListNode->owner, queueListNode->data);
 
-        if (eventTypeDescription->freeProc != NULL) {
-            eventTypeDescription->freeProc(queueListNode->data);
-        }
-
-        mem_free(queueListNode);
+        queue_free_node(queueListNode);
     }
 
     return v1;
@@ -351,51 +355,72 @@ int queue_process()
 // 0x490A5C
 void queue_clear()
 {
-    QueueListNode* queueListNode = queue;
-    while (queueListNode != NULL) {
-        QueueListNode* next = queueListNode->next;
-
-        EventTypeDescription* eventTypeDescription = &(q_func[queueListNode->type]);
-        if (eventTypeDescription->freeProc != NULL) {
-            eventTypeDescription->freeProc(queueListNode->data);
-        }
-
-        mem_free(queueListNode);
-
-        queueListNode = next;
+    // Events are detached first, free procs must not see half cleared queue.
+    std::vector<QueueListNode*> nodes;
+    nodes.swap(queue_heap);
+    queue_owners.clear();
+
+    for (QueueListNode* queueListNode : nodes) {
+        queueListNode->heapIndex = -1;
+        queue_free_node(queueListNode);
     }
-
-    queue = NULL;
 }
 
 // 0x490AA4
 void queue_clear_type(int eventType, QueueEventHandler* fn)
 {
-    QueueListNode** ptr = &queue;
-    QueueListNode* curr = *ptr;
-
-    while (curr != NULL) {
-        if (eventType == curr->type) {
-            QueueListNode* tmp = curr;
-
-            *ptr = curr->next;
-            curr = *ptr;
-
-            if (fn != NULL && fn(tmp->owner, tmp->data) != 1) {
-                *ptr = tmp;
-                ptr = &(tmp->next);
-            } else {
-                EventTypeDescription* eventTypeDescription = &(q_func[tmp->type]);
-                if (eventTypeDescription->freeProc != NULL) {
-                    eventTypeDescription->freeProc(tmp->data);
-                }
+    std::vector<QueueListNode*> nodes;
+    queue_sorted(nodes, eventType);
 
-                mem_free(tmp);
-            }
+    if (fn == NULL) {
+        for (QueueListNode* queueListNode : nodes) {
+            queue_unlink(queueListNode);
+            queue_free_node(queueListNode);
+        }
+        return;
+    }
+
+    // Clear handlers can add and remove events. Events they remove are kept
+    // allocated until the end, so that `nodes` stays valid. Events of this
+    // type they add are visited as well if they would be placed after the
+    // current one.
+    std::vector<QueueListNode*> added;
+    std::vector<QueueListNode*>* previousAdded = queue_added;
+    queue_added = &added;
+    queue_clearing++;
+
+    for (size_t index = 0; index < nodes.size(); index++) {
+        QueueListNode* queueListNode = nodes[index];
+        if (queueListNode->heapIndex == -1) {
+            continue;
+        }
+
+        // Event is taken out of the queue while its handler runs.
+        queue_unlink(queueListNode);
+
+        if (fn(queueListNode->owner, queueListNode->data) != 1) {
+            queue_insert(queueListNode);
         } else {
-            ptr = &(curr->next);
-            curr = *ptr;
+            queue_free_node(queueListNode);
+        }
+
+        for (QueueListNode* addedNode : added) {
+            if (addedNode->type == eventType && addedNode->heapIndex != -1 && queue_node_less(queueListNode, addedNode)) {
+                auto it = std::upper_bound(nodes.begin() + index + 1, nodes.end(), addedNode, queue_node_less);
+                nodes.insert(it, addedNode);
+            }
+        }
+        added.clear();
+    }
+
+    queue_added = previousAdded;
+    queue_clearing--;
+
+    if (queue_clearing == 0) {
+        for (QueueListNode* queueListNode : queue_removed) {
+            mem_free(queueListNode);
         }
+        queue_removed.clear();
     }
 }
 
@@ -404,11 +429,143 @@ void queue_clear_type(int eventType, QueueEventHandler* fn)
 // 0x490B1C
 int queue_next_time()
 {
-    if (queue == NULL) {
+    if (queue_heap.empty()) {
         return 0;
     }
 
-    return queue->time;
+    return queue_heap[0]->time;
+}
+
+// CE: Returns true if event `a` is processed before `b`.
+static bool queue_node_less(QueueListNode* a, QueueListNode* b)
+{
+    if (a->time != b->time) {
+        return a->time < b->time;
+    }
+
+    return a->seq < b->seq;
+}
+
+static void queue_sift_up(int index)
+{
+    QueueListNode* queueListNode = queue_heap[index];
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (!queue_node_less(queueListNode, queue_heap[parent])) {
+            break;
+        }
+
+        queue_heap[index] = queue_heap[parent];
+        queue_heap[index]->heapIndex = index;
+        index = parent;
+    }
+
+    queue_heap[index] = queueListNode;
+    queueListNode->heapIndex = index;
+}
+
+static void queue_sift_down(int index)
+{
+    int count = static_cast<int>(queue_heap.size());
+    QueueListNode* queueListNode = queue_heap[index];
+    while (true) {
+        int child = index * 2 + 1;
+        if (child >= count) {
+            break;
+        }
+
+        if (child + 1 < count && queue_node_less(queue_heap[child + 1], queue_heap[child])) {
+            child++;
+        }
+
+        if (!queue_node_less(queue_heap[child], queueListNode)) {
+            break;
+        }
+
+        queue_heap[index] = queue_heap[child];
+        queue_heap[index]->heapIndex = index;
+        index = child;
+    }
+
+    queue_heap[index] = queueListNode;
+    queueListNode->heapIndex = index;
+}
+
+// CE: Schedules event and links it into the list of its owner's events.
+static void queue_insert(QueueListNode* queueListNode)
+{
+    queue_heap.push_back(queueListNode);
+    queue_sift_up(static_cast<int>(queue_heap.size()) - 1);
+
+    QueueListNode*& head = queue_owners[queueListNode->owner];
+    queueListNode->ownerPrev = NULL;
+    queueListNode->ownerNext = head;
+    if (head != NULL) {
+        head->ownerPrev = queueListNode;
+    }
+    head = queueListNode;
+}
+
+// CE: Takes event out of the heap and its owner's list. The event itself is
+// left intact.
+static void queue_unlink(QueueListNode* queueListNode)
+{
+    int index = queueListNode->heapIndex;
+    QueueListNode* last = queue_heap.back();
+    queue_heap.pop_back();
+    if (last != queueListNode) {
+        queue_heap[index] = last;
+        last->heapIndex = index;
+        queue_sift_up(index);
+        queue_sift_down(last->heapIndex);
+    }
+    queueListNode->heapIndex = -1;
+
+    if (queueListNode->ownerPrev != NULL) {
+        queueListNode->ownerPrev->ownerNext = queueListNode->ownerNext;
+    } else {
+        auto it = queue_owners.find(queueListNode->owner);
+        if (queueListNode->ownerNext != NULL) {
+            it->second = queueListNode->ownerNext;
+        } else {
+            queue_owners.erase(it);
+        }
+    }
+
+    if (queueListNode->ownerNext != NULL) {
+        queueListNode->ownerNext->ownerPrev = queueListNode->ownerPrev;
+    }
+
+    queueListNode->ownerPrev = NULL;
+    queueListNode->ownerNext = NULL;
+}
+
+// CE: Releases data of unlinked event and the event itself.
+static void queue_free_node(QueueListNode* queueListNode)
+{
+    EventTypeDescription* eventTypeDescription = &(q_func[queueListNode->type]);
+    if (eventTypeDescription->freeProc != NULL) {
+        eventTypeDescription->freeProc(queueListNode->data);
+    }
+
+    if (queue_clearing != 0) {
+        queue_removed.push_back(queueListNode);
+    } else {
+        mem_free(queueListNode);
+    }
+}
+
+// CE: Collects scheduled events of given type (-1 for all) in the order they
+// are going to be processed.
+static void queue_sorted(std::vector<QueueListNode*>& nodes, int eventType)
+{
+    for (QueueListNode* queueListNode : queue_heap) {
+        if (eventType == -1 || queueListNode->type == eventType) {
+            nodes.push_back(queueListNode);
+        }
+    }
+
+    std::sort(nodes.begin(), nodes.end(), queue_node_less);
 }
 
 // 0x490B30
@@ -7,6 +7,7 @@
 
 #include "game/actions.h"
 #include "game/automap.h"
+#include "game/benchmark.h"
 #include "game/combat.h"
 #include "game/critter.h"
 #include "game/elevator.h"
@@ -562,6 +563,8 @@ static void doBkProcesses()
         set = 1;
     }
 
+    int previousPhase = benchmark_phase_enter(BENCHMARK_PHASE_SCRIPTS);
+
     int v0 = get_bk_time();
     if (script_engine_running) {
         lasttime = v0;
@@ -581,6 +584,8 @@ static void doBkProcesses()
             script_chk_timed_events();
         }
     }
+
+    benchmark_phase_leave(previousPhase);
 }
 
 // 0x491F94
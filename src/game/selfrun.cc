@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "game/benchmark.h"
 #include "game/game.h"
 #include "game/gconfig.h"
 #include "platform_compat.h"
@@ -126,6 +127,35 @@ void selfrun_playback_loop(SelfrunData* selfrunData)
     }
 }
 
+// CE: Same as `selfrun_playback_loop`, but runs as fast as possible on a
+// fixed clock, cannot be interrupted, and reports every frame to benchmark.
+void selfrun_benchmark_loop(SelfrunData* selfrunData)
+{
+    if (selfrun_state == SELFRUN_STATE_PLAYING) {
+        char path[COMPAT_MAX_PATH];
+        snprintf(path, sizeof(path), "%s%s", "selfrun\\", selfrunData->recordingFileName);
+
+        if (vcr_play(path, 0, selfrun_playback_callback)) {
+            while (selfrun_state == SELFRUN_STATE_PLAYING) {
+                benchmark_frame_begin();
+
+                int keyCode = get_input();
+                if (keyCode != selfrunData->stopKeyCode) {
+                    game_handle_input(keyCode, false);
+                }
+
+                int previousPhase = benchmark_phase_enter(BENCHMARK_PHASE_RENDER);
+                renderPresent();
+                benchmark_phase_leave(previousPhase);
+
+                benchmark_frame_end();
+            }
+        } else {
+            selfrun_state = SELFRUN_STATE_TURNED_OFF;
+        }
+    }
+}
+
 // 0x496EA8
 int selfrun_prep_recording(const char* recordingName, const char* mapFileName, SelfrunData* selfrunData)
 {
@@ -16,6 +16,7 @@ int selfrun_get_list(char*** fileListPtr, int* fileListLengthPtr);
 int selfrun_free_list(char*** fileListPtr);
 int selfrun_prep_playback(const char* fileName, SelfrunData* selfrunData);
 void selfrun_playback_loop(SelfrunData* selfrunData);
+void selfrun_benchmark_loop(SelfrunData* selfrunData);
 int selfrun_prep_recording(const char* recordingName, const char* mapFileName, SelfrunData* selfrunData);
 void selfrun_recording_loop(SelfrunData* selfrunData);
 
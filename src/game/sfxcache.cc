@@ -29,10 +29,18 @@ typedef struct SoundEffect {
     int fileSize;
     // TODO: Make size_t.
     int position;
-    int dataPosition;
+
+    // CE: Decoded samples (`dataSize` bytes), owned by the cache.
     unsigned char* data;
 } SoundEffect;
 
+// Compressed file being decoded by `sfxc_ad_reader`.
+typedef struct SoundEffectSource {
+    unsigned char* data;
+    int size;
+    int position;
+} SoundEffectSource;
+
 static int sfxc_effect_size(int tag, int* sizePtr);
 static int sfxc_effect_load(int tag, int* sizePtr, unsigned char* data);
 static void sfxc_effect_free(void* ptr);
@@ -42,7 +50,7 @@ static int sfxc_handle_create(int* handlePtr, int id, void* data, CacheEntry* ca
 static void sfxc_handle_destroy(int handle);
 static bool sfxc_handle_is_legal(int a1);
 static bool sfxc_mode_is_legal(int mode);
-static int sfxc_decode(int handle, void* buf, unsigned int size);
+static int sfxc_decode(unsigned char* src, int srcSize, unsigned char* dest, int destSize);
 static unsigned int sfxc_ad_reader(void* stream, void* buf, unsigned int size);
 
 // 0x507A70
@@ -105,6 +113,9 @@ int sfxc_init(int cacheSize, const char* effectsPath)
         return -1;
     }
 
+    // CE: Configured size is the budget for decoded effects (see
+    // `sfxc_effect_size`), so the same setting holds fewer compressed
+    // effects than before, but never more memory.
     if (!cache_init(sfxc_pcache, sfxc_effect_size, sfxc_effect_load, sfxc_effect_free, cacheSize)) {
         mem_free(sfxc_pcache);
         sfxc_handle_list_destroy();
@@ -228,18 +239,10 @@ int sfxc_cached_read(int handle, void* buf, unsigned int size)
         bytesToRead = soundEffect->dataSize - soundEffect->position;
     }
 
-    switch (sfxc_cmpr) {
-    case 0:
-        memcpy(buf, soundEffect->data + soundEffect->position, bytesToRead);
-        break;
-    case 1:
-        if (sfxc_decode(handle, buf, bytesToRead) != 0) {
-            return -1;
-        }
-        break;
-    default:
-        return -1;
-    }
+    // CE: Effects are decoded once when they are loaded into the cache, so
+    // reading is a plain copy regardless of compression. Original code
+    // decoded compressed effects from the very beginning on every read.
+    memcpy(buf, soundEffect->data + soundEffect->position, bytesToRead);
 
     soundEffect->position += bytesToRead;
 
@@ -319,11 +322,14 @@ long sfxc_cached_file_size(int handle)
     return soundEffect->dataSize;
 }
 
+// CE: Reports decoded size so that the cache budget accounts for what is
+// actually kept in memory.
+//
 // 0x4975B4
 static int sfxc_effect_size(int tag, int* sizePtr)
 {
     int size;
-    if (sfxl_size_cached(tag, &size) == -1) {
+    if (sfxl_size_full(tag, &size) == -1) {
         return -1;
     }
 
@@ -332,6 +338,8 @@ static int sfxc_effect_size(int tag, int* sizePtr)
     return 0;
 }
 
+// CE: Decodes compressed effects into the cache entry.
+//
 // 0x4975DC
 static int sfxc_effect_load(int tag, int* sizePtr, unsigned char* data)
 {
@@ -340,18 +348,42 @@ static int sfxc_effect_load(int tag, int* sizePtr, unsigned char* data)
     }
 
     int size;
-    sfxl_size_cached(tag, &size);
+    sfxl_size_full(tag, &size);
+
+    int fileSize;
+    sfxl_size_cached(tag, &fileSize);
 
     char* name;
     sfxl_name(tag, &name);
 
-    if (db_read_to_buf(name, data)) {
+    unsigned char* fileData = data;
+    if (sfxc_cmpr == 1) {
+        fileData = (unsigned char*)mem_malloc(fileSize);
+        if (fileData == NULL) {
+            mem_free(name);
+            return -1;
+        }
+    }
+
+    if (db_read_to_buf(name, fileData)) {
+        if (fileData != data) {
+            mem_free(fileData);
+        }
         mem_free(name);
         return -1;
     }
 
     mem_free(name);
 
+    if (fileData != data) {
+        int rc = sfxc_decode(fileData, fileSize, data, size);
+        mem_free(fileData);
+
+        if (rc != 0) {
+            return -1;
+        }
+    }
+
     *sizePtr = size;
 
     return 0;
@@ -424,7 +456,6 @@ static int sfxc_handle_create(int* handlePtr, int tag, void* data, CacheEntry* c
     sfxl_size_cached(tag, &(soundEffect->fileSize));
 
     soundEffect->position = 0;
-    soundEffect->dataPosition = 0;
 
     soundEffect->data = (unsigned char*)data;
 
@@ -474,41 +505,26 @@ static bool sfxc_mode_is_legal(int mode)
     return true;
 }
 
+// CE: Decodes the whole effect at once (original code decoded requested chunk
+// of the effect with a new decoder on every read).
+//
 // 0x4977F8
-static int sfxc_decode(int handle, void* buf, unsigned int size)
+static int sfxc_decode(unsigned char* src, int srcSize, unsigned char* dest, int destSize)
 {
-    if (!sfxc_handle_is_legal(handle)) {
-        return -1;
-    }
-
-    SoundEffect* soundEffect = &(sfxc_handle_list[handle]);
-    soundEffect->dataPosition = 0;
+    SoundEffectSource source;
+    source.data = src;
+    source.size = srcSize;
+    source.position = 0;
 
     int channels;
     int sampleRate;
     int sampleCount;
-    AudioDecoder* ad = Create_AudioDecoder(sfxc_ad_reader, &handle, &channels, &sampleRate, &sampleCount);
+    AudioDecoder* ad = Create_AudioDecoder(sfxc_ad_reader, &source, &channels, &sampleRate, &sampleCount);
 
-    if (soundEffect->position != 0) {
-        void* temp = mem_malloc(soundEffect->position);
-        if (temp == NULL) {
-            AudioDecoder_Close(ad);
-            return -1;
-        }
-
-        size_t bytesRead = AudioDecoder_Read(ad, temp, soundEffect->position);
-        mem_free(temp);
-
-        if (bytesRead != soundEffect->position) {
-            AudioDecoder_Close(ad);
-            return -1;
-        }
-    }
-
-    size_t bytesRead = AudioDecoder_Read(ad, buf, size);
+    size_t bytesRead = AudioDecoder_Read(ad, dest, destSize);
     AudioDecoder_Close(ad);
 
-    if (bytesRead != size) {
+    if (bytesRead != (size_t)destSize) {
         return -1;
     }
 
@@ -522,17 +538,16 @@ static unsigned int sfxc_ad_reader(void* stream, void* buf, unsigned int size)
         return 0;
     }
 
-    int handle = *reinterpret_cast<int*>(stream);
-    SoundEffect* soundEffect = &(sfxc_handle_list[handle]);
+    SoundEffectSource* source = reinterpret_cast<SoundEffectSource*>(stream);
 
-    unsigned int bytesToRead = soundEffect->fileSize - soundEffect->dataPosition;
+    unsigned int bytesToRead = source->size - source->position;
     if (size <= bytesToRead) {
         bytesToRead = size;
     }
 
-    memcpy(buf, soundEffect->data + soundEffect->dataPosition, bytesToRead);
+    memcpy(buf, source->data + source->position, bytesToRead);
 
-    soundEffect->dataPosition += bytesToRead;
+    source->position += bytesToRead;
 
     return bytesToRead;
 }
@@ -0,0 +1,166 @@
+#include "game/shade.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "plib/color/color.h"
+
+namespace fallout {
+
+// Source rows are classified 8 pixels at a time with a word-wide zero-byte
+// test, transparent groups are skipped and opaque groups are written without
+// per-pixel test.
+//
+// There are no SSE2/NEON versions of these kernels. All of the per-pixel work
+// is lookups into 256-entry (or 64 KB) byte tables, and neither SSE2 nor NEON
+// has gather loads, so vector versions would still do those lookups one
+// byte at a time. The only part that vectorizes is the transparency test,
+// and word-at-a-time gets most of that without per-platform code or runtime
+// CPU dispatch.
+
+static int shade_opaque_run(const unsigned char* src, int length, bool* opaque);
+
+void shade_build_table(unsigned char* table, int lightModifier, bool keepFixedColors)
+{
+    for (int color = 0; color < 256; color++) {
+        if (keepFixedColors && color >= 0xE5) {
+            table[color] = color;
+        } else {
+            table[color] = intensityColorTable[color][lightModifier];
+        }
+    }
+}
+
+void shade_dark_trans_row(const unsigned char* src, unsigned char* dest, int width, const unsigned char* shade)
+{
+    int x = 0;
+    while (x < width) {
+        bool opaque;
+        int run = shade_opaque_run(src, width - x, &opaque);
+        if (run == 0) {
+            run = std::min(8, width - x);
+            for (int index = 0; index < run; index++) {
+                if (src[index] != 0) {
+                    dest[index] = shade[src[index]];
+                }
+            }
+        } else if (opaque) {
+            for (int index = 0; index < run; index++) {
+                dest[index] = shade[src[index]];
+            }
+        }
+
+        src += run;
+        dest += run;
+        x += run;
+    }
+}
+
+void shade_dark_translucent_trans_row(const unsigned char* src, unsigned char* dest, int width, const unsigned char* shade, const unsigned char* blendTable, const unsigned char* blendIndexTable)
+{
+    int x = 0;
+    while (x < width) {
+        bool opaque;
+        int run = shade_opaque_run(src, width - x, &opaque);
+        if (run == 0) {
+            run = std::min(8, width - x);
+            for (int index = 0; index < run; index++) {
+                if (src[index] != 0) {
+                    unsigned int blendIndex = blendIndexTable[src[index]] << 8;
+                    dest[index] = shade[blendTable[blendIndex + dest[index]]];
+                }
+            }
+        } else if (opaque) {
+            for (int index = 0; index < run; index++) {
+                unsigned int blendIndex = blendIndexTable[src[index]] << 8;
+                dest[index] = shade[blendTable[blendIndex + dest[index]]];
+            }
+        }
+
+        src += run;
+        dest += run;
+        x += run;
+    }
+}
+
+void shade_intensity_mask_row(const unsigned char* src, unsigned char* dest, const unsigned char* mask, int width, const unsigned char* shade)
+{
+    int x = 0;
+    while (x < width) {
+        bool opaque;
+        int run = shade_opaque_run(src, width - x, &opaque);
+        bool mixed = run == 0;
+        if (mixed) {
+            run = std::min(8, width - x);
+        }
+
+        if (mixed || opaque) {
+            for (int index = 0; index < run; index++) {
+                if (src[index] == 0) {
+                    continue;
+                }
+
+                unsigned char b = shade[src[index]];
+                unsigned char m = mask[index];
+                if (m != 0) {
+                    unsigned char d = dest[index];
+                    int q = intensityColorTable[d][128 - m];
+                    m = intensityColorTable[b][m];
+                    b = colorMixAddTable[m][q];
+                }
+                dest[index] = b;
+            }
+        }
+
+        src += run;
+        dest += run;
+        mask += run;
+        x += run;
+    }
+}
+
+// Classifies the beginning of a row of source pixels. Returns the length of
+// a run of whole 8-pixel groups which are either all transparent (`opaque`
+// is `false`) or all opaque (`opaque` is `true`). Returns 0 if first group is
+// mixed or row is shorter than 8 pixels, the caller is expected to check
+// next 8 pixels one by one in this case.
+static int shade_opaque_run(const unsigned char* src, int length, bool* opaque)
+{
+    const unsigned long long ones = 0x0101010101010101ULL;
+    const unsigned long long highs = 0x8080808080808080ULL;
+
+    int run = 0;
+    *opaque = false;
+
+    while (run + 8 <= length) {
+        unsigned long long word;
+        memcpy(&word, src + run, sizeof(word));
+
+        bool groupOpaque;
+        if (word == 0) {
+            groupOpaque = false;
+        } else if (((word - ones) & ~word & highs) == 0) {
+            // No zero bytes in this group.
+            groupOpaque = true;
+        } else {
+            break;
+        }
+
+        if (run == 0) {
+            *opaque = groupOpaque;
+        } else if (groupOpaque != *opaque) {
+            break;
+        }
+
+        run += 8;
+    }
+
+    if (run == 0) {
+        *opaque = false;
+    }
+
+    return run;
+}
+
+} // namespace fallout
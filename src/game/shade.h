@@ -0,0 +1,22 @@
+#ifndef FALLOUT_GAME_SHADE_H_
+#define FALLOUT_GAME_SHADE_H_
+
+namespace fallout {
+
+// Row kernels behind `dark_trans_buf_to_buf`,
+// `dark_translucent_trans_buf_to_buf` and `intensity_mask_buf_to_buf`. In
+// every source row 0 is transparent, `shade` is a table built with
+// `shade_build_table` for the light level of the blit.
+
+// Builds palette remap for given light level (`light >> 9`). Colors at or
+// above 0xE5 are palette-animated and are left intact when `keepFixedColors`
+// is set.
+void shade_build_table(unsigned char* table, int lightModifier, bool keepFixedColors);
+
+void shade_dark_trans_row(const unsigned char* src, unsigned char* dest, int width, const unsigned char* shade);
+void shade_dark_translucent_trans_row(const unsigned char* src, unsigned char* dest, int width, const unsigned char* shade, const unsigned char* blendTable, const unsigned char* blendIndexTable);
+void shade_intensity_mask_row(const unsigned char* src, unsigned char* dest, const unsigned char* mask, int width, const unsigned char* shade);
+
+} // namespace fallout
+
+#endif /* FALLOUT_GAME_SHADE_H_ */
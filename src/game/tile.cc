@@ -7,6 +7,7 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#include "game/benchmark.h"
 #include "game/config.h"
 #include "game/gconfig.h"
 #include "game/gmouse.h"
@@ -601,6 +602,8 @@ static void refresh_game(Rect* rect, int elevation)
         return;
     }
 
+    int previousPhase = benchmark_phase_enter(BENCHMARK_PHASE_RENDER);
+
     buf_fill(buf + buf_full * rectToUpdate.uly + rectToUpdate.ulx,
         rectGetWidth(&rectToUpdate),
         rectGetHeight(&rectToUpdate),
@@ -613,6 +616,8 @@ static void refresh_game(Rect* rect, int elevation)
     bounds_render(&rectToUpdate, elevation);
     obj_render_post_roof(&rectToUpdate, elevation);
     blit(&rectToUpdate);
+
+    benchmark_phase_leave(previousPhase);
 }
 
 // 0x49E218
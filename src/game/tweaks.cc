@@ -1,6 +1,9 @@
 #include "game/tweaks.h"
 
+#include <string.h>
+
 #include "game/config.h"
+#include "platform_compat.h"
 #include "plib/gnw/debug.h"
 
 namespace fallout {
@@ -10,6 +13,10 @@ static bool tweak_auto_mouse_mode = false;
 static bool tweak_hover_hide_roof = false;
 static bool tweak_object_tooltip = false;
 static int tweak_highlight_objects_key = 0;
+static bool tweak_profiler_enabled = false;
+static int tweak_profiler_key = 0;
+static char tweak_profiler_output[COMPAT_MAX_PATH] = "profile.json";
+static bool tweak_show_repaints = false;
 
 bool tweaks_init()
 {
@@ -37,6 +44,23 @@ bool tweaks_init()
                 tweak_highlight_objects_key = value;
             }
 
+            if (config_get_value(&tweaksConfig, "Profiler", "Enabled", &value)) {
+                tweak_profiler_enabled = (value != 0);
+            }
+
+            if (config_get_value(&tweaksConfig, "Profiler", "Key", &value)) {
+                tweak_profiler_key = value;
+            }
+
+            char* output;
+            if (config_get_string(&tweaksConfig, "Profiler", "Output", &output) && *output != '\0') {
+                strncpy(tweak_profiler_output, output, sizeof(tweak_profiler_output) - 1);
+            }
+
+            if (config_get_value(&tweaksConfig, "Debug", "ShowRepaints", &value)) {
+                tweak_show_repaints = (value != 0);
+            }
+
             debug_printf("Tweaks loaded from tweaks.ini\n");
             if (tweak_auto_mouse_mode) {
                 debug_printf("  Mouse.AutoMode = 1\n");
@@ -50,6 +74,15 @@ bool tweaks_init()
             if (tweak_highlight_objects_key != 0) {
                 debug_printf("  Accessibility.HighlightKey = %d\n", tweak_highlight_objects_key);
             }
+            if (tweak_profiler_enabled) {
+                debug_printf("  Profiler.Enabled = 1\n");
+            }
+            if (tweak_profiler_key != 0) {
+                debug_printf("  Profiler.Key = %d\n", tweak_profiler_key);
+            }
+            if (tweak_show_repaints) {
+                debug_printf("  Debug.ShowRepaints = 1\n");
+            }
         }
         config_exit(&tweaksConfig);
     }
@@ -68,6 +101,10 @@ void tweaks_exit()
     tweak_hover_hide_roof = false;
     tweak_object_tooltip = false;
     tweak_highlight_objects_key = 0;
+    tweak_profiler_enabled = false;
+    tweak_profiler_key = 0;
+    strcpy(tweak_profiler_output, "profile.json");
+    tweak_show_repaints = false;
     tweaks_initialized = false;
 }
 
@@ -91,4 +128,24 @@ int tweaks_highlight_objects_key()
     return tweak_highlight_objects_key;
 }
 
+bool tweaks_profiler_enabled()
+{
+    return tweak_profiler_enabled;
+}
+
+int tweaks_profiler_key()
+{
+    return tweak_profiler_key;
+}
+
+const char* tweaks_profiler_output()
+{
+    return tweak_profiler_output;
+}
+
+bool tweaks_show_repaints()
+{
+    return tweak_show_repaints;
+}
+
 } // namespace fallout
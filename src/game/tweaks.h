@@ -30,6 +30,21 @@ bool tweaks_object_tooltip();
 // Returns 0 if disabled (not configured in tweaks.ini).
 int tweaks_highlight_objects_key();
 
+// Returns true if frame profiler should capture from startup.
+bool tweaks_profiler_enabled();
+
+// Returns the game key code that starts and stops profiler capture
+// (e.g. 393 for Ctrl+F11). Returns 0 if disabled.
+int tweaks_profiler_key();
+
+// Returns path of the Chrome trace file written when capture stops.
+// Defaults to profile.json.
+const char* tweaks_profiler_output();
+
+// Returns true if screen areas repainted by window compositor should be
+// outlined.
+bool tweaks_show_repaints();
+
 } // namespace fallout
 
 #endif /* FALLOUT_GAME_TWEAKS_H_ */
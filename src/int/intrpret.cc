@@ -15,6 +15,7 @@
 #include "plib/db/db.h"
 #include "plib/gnw/debug.h"
 #include "plib/gnw/input.h"
+#include "profiler.h"
 
 namespace fallout {
 
@@ -46,6 +47,7 @@ static opcode_t popShortStack(unsigned char* a1, int* a2);
 static void detachProgram(Program* program);
 static void purgeProgram(Program* program);
 static opcode_t getOp(Program* program);
+static ProgramDecodedOp* getDecodedOp(Program* program);
 static void checkProgramStrings(Program* program);
 static void op_noop(Program* program);
 static void op_const(Program* program);
@@ -421,6 +423,7 @@ void interpretFreeProgram(Program* program)
 
     delete program->stackValues;
     delete program->returnStackValues;
+    delete program->decodedOps;
 
     myfree(program, __FILE__, __LINE__); // "..\int\INTRPRET.C", 377
 }
@@ -462,6 +465,9 @@ Program* allocateProgram(const char* path)
     program->stackValues = new ProgramStack();
     program->returnStackValues = new ProgramStack();
 
+    program->dataSize = fileSize;
+    program->decodedOps = new ProgramCode(((fileSize + 1) / 2 + PROGRAM_CODE_PAGE_SIZE - 1) / PROGRAM_CODE_PAGE_SIZE);
+
     return program;
 }
 
@@ -477,6 +483,36 @@ static opcode_t getOp(Program* program)
     return fetchWord(program->data, instructionPointer);
 }
 
+// Returns decoded instruction at current instruction pointer, decoding it on
+// the first visit. Returns `NULL` if instruction pointer is odd or outside of
+// the program, such instructions are decoded with `getOp` on every step.
+static ProgramDecodedOp* getDecodedOp(Program* program)
+{
+    int instructionPointer = program->instructionPointer;
+
+    if ((instructionPointer & 1) != 0 || instructionPointer < 0 || instructionPointer + 2 > program->dataSize) {
+        return NULL;
+    }
+
+    int index = instructionPointer / 2;
+    std::vector<ProgramDecodedOp>& page = (*program->decodedOps)[index / PROGRAM_CODE_PAGE_SIZE];
+    if (page.empty()) {
+        page.resize(PROGRAM_CODE_PAGE_SIZE);
+    }
+
+    ProgramDecodedOp* decodedOp = &(page[index % PROGRAM_CODE_PAGE_SIZE]);
+    if (decodedOp->opcode == 0) {
+        decodedOp->opcode = fetchWord(program->data, instructionPointer);
+        if ((decodedOp->opcode & 0x3FF) == (OPCODE_PUSH & 0x3FF) && instructionPointer + 6 <= program->dataSize) {
+            decodedOp->operand = fetchLong(program->data, instructionPointer + 2);
+        } else {
+            decodedOp->operand = 0;
+        }
+    }
+
+    return decodedOp;
+}
+
 // 0x45BC2C
 char* interpretGetString(Program* program, opcode_t opcode, int offset)
 {
@@ -2558,9 +2594,24 @@ void interpret(Program* program, int a2)
         program->field_78 = 1000 * timerFunc() / timerTick;
     }
 
+    // CE: `interpretError` jumps back here, so the zone is closed explicitly
+    // rather than with `ProfilerZone`.
+    bool profiling = gProfilerCapturing.load(std::memory_order_relaxed);
+    if (profiling) {
+        profilerBeginZone("interpret");
+    }
+
+    int zoneDepth = profilerZoneDepth();
+
     currentProgram = program;
 
     if (setjmp(program->env)) {
+        // CE: Errors jump over zones opened by opcode handlers.
+        profilerUnwindZones(zoneDepth);
+        if (profiling) {
+            profilerEndZone();
+        }
+
         currentProgram = oldCurrentProgram;
         program->flags |= PROGRAM_FLAG_EXITED | PROGRAM_FLAG_0x04;
         return;
@@ -2594,8 +2645,17 @@ void interpret(Program* program, int a2)
             program->flags &= ~PROGRAM_IS_WAITING;
         }
 
-        // NOTE: Uninline.
-        opcode_t opcode = getOp(program);
+        // CE: Take pre-decoded instruction when possible.
+        ProgramDecodedOp* decodedOp = getDecodedOp(program);
+
+        opcode_t opcode;
+        if (decodedOp != NULL) {
+            opcode = decodedOp->opcode;
+            program->instructionPointer += 2;
+        } else {
+            // NOTE: Uninline.
+            opcode = getOp(program);
+        }
 
         // TODO: Replace with field_82 and field_80?
         program->flags &= 0xFFFF;
@@ -2606,6 +2666,23 @@ void interpret(Program* program, int a2)
             interpretError(err);
         }
 
+        // CE: `OPCODE_PUSH` is by far the most frequent instruction, run it
+        // in place with pre-decoded operand (same as `op_const`). Compiled
+        // scripts tag pushes with value type (`VALUE_TYPE_INT`, etc.), so
+        // only opcode index is compared.
+        if ((opcode & 0x3FF) == (OPCODE_PUSH & 0x3FF)
+            && decodedOp != NULL
+            && program->instructionPointer + 4 <= program->dataSize
+            && opTable[OPCODE_PUSH & 0x3FF] == op_const) {
+            program->instructionPointer += 4;
+
+            ProgramValue result;
+            result.opcode = opcode;
+            result.integerValue = decodedOp->operand;
+            programStackPushValue(program, result);
+            continue;
+        }
+
         unsigned int opcodeIndex = opcode & 0x3FF;
         OpcodeHandler* handler = opTable[opcodeIndex];
         if (handler == NULL) {
@@ -2628,6 +2705,10 @@ void interpret(Program* program, int a2)
 
     program->flags &= ~PROGRAM_FLAG_0x40;
     currentProgram = oldCurrentProgram;
+
+    if (profiling) {
+        profilerEndZone();
+    }
 }
 
 // Prepares program stacks for executing proc at [address].
@@ -2947,6 +3028,8 @@ void interpretSetCPUBurstSize(int value)
 // 0x461F28
 void updatePrograms()
 {
+    ProfilerZone zone("updatePrograms");
+
     ProgramListNode* curr = head;
     while (curr != NULL) {
         ProgramListNode* next = curr->next;
@@ -148,6 +148,26 @@ typedef struct ProgramValue {
 
 typedef std::vector<ProgramValue> ProgramStack;
 
+// CE: Instruction at a given code offset decoded once, so that `interpret`
+// does not have to reassemble big-endian words on every step.
+typedef struct ProgramDecodedOp {
+    // Opcode at this offset, 0 if the offset was never executed (every valid
+    // opcode has `RAW_VALUE_TYPE_OPCODE` bit set).
+    opcode_t opcode;
+
+    // Immediate value following the opcode (used by `OPCODE_PUSH`).
+    int operand;
+} ProgramDecodedOp;
+
+// CE: Number of decoded instructions in one `ProgramCode` page (covers 512
+// bytes of program data).
+#define PROGRAM_CODE_PAGE_SIZE 256
+
+// Indexed by `instructionPointer / 2 / PROGRAM_CODE_PAGE_SIZE`. Pages are
+// allocated on first execution of any instruction in them, so procedure
+// tables, identifiers, strings and procedures that never run take no memory.
+typedef std::vector<std::vector<ProgramDecodedOp>> ProgramCode;
+
 typedef struct Program Program;
 typedef int(InterpretCheckWaitFunc)(Program* program);
 
@@ -175,6 +195,8 @@ typedef struct Program {
     bool exited;
     ProgramStack* stackValues;
     ProgramStack* returnStackValues;
+    int dataSize;
+    ProgramCode* decodedOps;
 } Program;
 
 typedef char*(InterpretMangleFunc)(char* fileName);
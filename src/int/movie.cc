@@ -20,6 +20,7 @@
 #include "plib/gnw/svga.h"
 #include "plib/gnw/text.h"
 #include "plib/gnw/winmain.h"
+#include "profiler.h"
 
 namespace fallout {
 
@@ -313,9 +314,12 @@ static void movie_MVE_ShowFrame(SDL_Surface* surface, int srcWidth, int srcHeigh
         }
     }
 
+    // CE: Window changes made before this frame must not end up on top of it.
+    win_compose();
+
     SDL_SetSurfacePalette(surface, gSdlSurface->format->palette);
     SDL_BlitSurface(surface, &srcRect, gSdlSurface, &destRect);
-    SDL_BlitSurface(gSdlSurface, NULL, gSdlTextureSurface, NULL);
+    renderAddDirtyRect(&destRect);
     renderPresent();
 }
 
@@ -978,6 +982,8 @@ void movieUpdate()
         return;
     }
 
+    ProfilerZone zone("movieUpdate");
+
     if ((movieFlags & MOVIE_EXTENDED_FLAG_0x02) != 0) {
         debug_printf("Movie aborted\n");
         cleanupMovie(1);
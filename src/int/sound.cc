@@ -11,17 +11,31 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 #include <SDL.h>
 
 #include "audio_engine.h"
 #include "platform_compat.h"
 #include "plib/gnw/debug.h"
+#include "plib/gnw/input.h"
 #include "plib/gnw/memory.h"
 #include "plib/gnw/winmain.h"
+#include "profiler.h"
 
 namespace fallout {
 
+// Fade steps are this many ms apart (interval of original fade timer).
+#define SOUND_FADE_INTERVAL 40
+
+// Bounds of the streaming thread sleep between refills (in ms).
+#define SOUND_STREAM_MIN_INTERVAL 5
+#define SOUND_STREAM_MAX_INTERVAL 100
+
 typedef enum SoundStatusFlags {
     SOUND_STATUS_DONE = 0x01,
     SOUND_STATUS_IS_PLAYING = 0x02,
@@ -38,6 +52,10 @@ typedef struct FadeSound {
     int field_14;
     struct FadeSound* prev;
     struct FadeSound* next;
+
+    // CE: Fade out reached its target on the streaming thread and waits for
+    // `soundUpdate` to stop, pause or delete the sound.
+    bool finished;
 } FadeSound;
 
 static void* defaultMalloc(size_t size);
@@ -54,11 +72,16 @@ static char* defaultMangler(char* fname);
 static void refreshSoundBuffers(Sound* sound);
 static int preloadBuffers(Sound* sound);
 static int addSoundData(Sound* sound, unsigned char* buf, int size);
-static Uint32 doTimerEvent(Uint32 interval, void* param);
-static void removeTimedEvent(SDL_TimerID* timerId);
 static void removeFadeSound(FadeSound* fadeSound);
 static void fadeSounds();
+static void finishFadeSound(FadeSound* fadeSound);
+static int soundStepFades();
 static int internalSoundFade(Sound* sound, int duration, int targetVolume, int a4);
+static void soundLoopCallback(Sound* sound);
+static bool soundStreamOwns(Sound* sound);
+static void soundStreamStart();
+static void soundStreamStop();
+static void soundStreamThread();
 
 // 0x507E04
 static FadeSound* fadeHead = NULL;
@@ -159,7 +182,27 @@ static bool driverInit;
 // 0x6651C4
 static Sound* soundMgrList;
 
-static SDL_TimerID gFadeSoundsTimerId = 0;
+// CE: Time of the last fade step. Fades are stepped by the streaming thread
+// and by `soundUpdate`, whichever gets there first (they used to be stepped
+// by SDL timer on its own thread).
+static unsigned int gFadeSoundsLastTick = 0;
+
+// CE: Guards sound list and sound state shared with the streaming thread.
+// The streaming thread holds it while refilling buffers.
+static std::recursive_mutex gSoundMutex;
+
+// CE: Wakes streaming thread when a sound starts playing or the thread should
+// quit.
+static std::condition_variable_any gSoundStreamWake;
+
+static std::thread* gSoundStreamThread = nullptr;
+static std::thread::id gSoundStreamThreadId;
+
+// Guarded by `gSoundMutex`.
+static bool gSoundStreamQuit = false;
+
+// CE: Total number of streaming underruns (see `refreshSoundBuffers`).
+static std::atomic<int> gSoundUnderruns(0);
 
 // 0x499C80
 static void* defaultMalloc(size_t size)
@@ -309,6 +352,14 @@ static void refreshSoundBuffers(Sound* sound)
         v53 = v6 - sound->lastUpdate;
     }
 
+    // CE: Playback went through every section written ahead of it, or more
+    // sections were played than a single refill is allowed to read (the rest
+    // are skipped). Either way stale samples were heard.
+    if ((sound->soundFlags & 0x0200) == 0 && (v53 >= sound->numBuffers - 1 || sound->dataSize * v53 > sound->readLimit)) {
+        sound->underruns++;
+        gSoundUnderruns++;
+    }
+
     if (sound->dataSize * v53 >= sound->readLimit) {
         v53 = (sound->readLimit + sound->dataSize - 1) / sound->dataSize;
     }
@@ -362,9 +413,7 @@ static void refreshSoundBuffers(Sound* sound)
                     while (bytesRead < sound->dataSize) {
                         if (sound->loops == -1) {
                             sound->io.seek(sound->io.fd, sound->field_54, SEEK_SET);
-                            if (sound->callback != NULL) {
-                                sound->callback(sound->callbackUserData, 0x0400);
-                            }
+                            soundLoopCallback(sound);
                         } else {
                             if (sound->loops <= 0) {
                                 sound->field_58 = -1;
@@ -377,10 +426,7 @@ static void refreshSoundBuffers(Sound* sound)
 
                             sound->loops--;
                             sound->io.seek(sound->io.fd, sound->field_54, SEEK_SET);
-
-                            if (sound->callback != NULL) {
-                                sound->callback(sound->callbackUserData, 0x400);
-                            }
+                            soundLoopCallback(sound);
                         }
 
                         if (sound->field_58 == -1) {
@@ -433,6 +479,8 @@ static void refreshSoundBuffers(Sound* sound)
 // 0x49A1E4
 int soundInit(int a1, int num_buffers, int a3, int data_size, int sample_rate)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!audioEngineInit()) {
         debug_printf("soundInit: Unable to init audio engine\n");
 
@@ -448,6 +496,8 @@ int soundInit(int a1, int num_buffers, int a3, int data_size, int sample_rate)
 
     soundSetMasterVolume(VOLUME_MAX);
 
+    soundStreamStart();
+
     soundErrorno = SOUND_NO_ERROR;
     return 0;
 }
@@ -455,16 +505,16 @@ int soundInit(int a1, int num_buffers, int a3, int data_size, int sample_rate)
 // 0x49A5D8
 void soundClose()
 {
+    soundStreamStop();
+
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     while (soundMgrList != NULL) {
         Sound* next = soundMgrList->next;
         soundDelete(soundMgrList);
         soundMgrList = next;
     }
 
-    if (gFadeSoundsTimerId != -1) {
-        removeTimedEvent(&gFadeSoundsTimerId);
-    }
-
     while (fadeFreeList != NULL) {
         FadeSound* next = fadeFreeList->next;
         freePtr(fadeFreeList);
@@ -473,6 +523,10 @@ void soundClose()
 
     audioEngineExit();
 
+    if (gSoundUnderruns != 0) {
+        debug_printf("soundClose: %d streaming underruns\n", gSoundUnderruns.load());
+    }
+
     soundErrorno = SOUND_NO_ERROR;
     driverInit = false;
 }
@@ -480,6 +534,8 @@ void soundClose()
 // 0x49A688
 Sound* soundAllocate(int type, int soundFlags)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return NULL;
@@ -596,6 +652,8 @@ static int preloadBuffers(Sound* sound)
 // 0x49AA1C
 int soundLoad(Sound* sound, char* filePath)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -618,6 +676,8 @@ int soundLoad(Sound* sound, char* filePath)
 // 0x49AA88
 int soundRewind(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     bool hr;
 
     if (!driverInit) {
@@ -686,6 +746,8 @@ static int addSoundData(Sound* sound, unsigned char* buf, int size)
 // 0x49AC44
 int soundSetData(Sound* sound, unsigned char* buf, int size)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -710,6 +772,8 @@ int soundSetData(Sound* sound, unsigned char* buf, int size)
 // 0x49ACC0
 int soundPlay(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     bool hr;
     unsigned int readPos;
     unsigned int writePos;
@@ -744,6 +808,10 @@ int soundPlay(Sound* sound)
 
     ++numSounds;
 
+    if (soundStreamOwns(sound)) {
+        gSoundStreamWake.notify_one();
+    }
+
     soundErrorno = SOUND_NO_ERROR;
     return soundErrorno;
 }
@@ -751,6 +819,8 @@ int soundPlay(Sound* sound)
 // 0x49ADAC
 int soundStop(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     bool hr;
 
     if (!driverInit) {
@@ -784,6 +854,8 @@ int soundStop(Sound* sound)
 // 0x49AE60
 int soundDelete(Sound* sample)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -814,6 +886,8 @@ int numSoundsPlaying()
 // 0x49AECC
 int soundContinue(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     bool hr;
     unsigned int status;
 
@@ -847,6 +921,14 @@ int soundContinue(Sound* sound)
         return soundErrorno;
     }
 
+    // CE: Deliver loop notifications raised on the streaming thread.
+    while (sound->pendingLoops > 0) {
+        sound->pendingLoops--;
+        if (sound->callback != NULL) {
+            sound->callback(sound->callbackUserData, 0x400);
+        }
+    }
+
     hr = audioEngineSoundBufferGetStatus(sound->soundBuffer, &status);
     if (!hr) {
         debug_printf("Error in soundContinue, %x\n", hr);
@@ -856,7 +938,8 @@ int soundContinue(Sound* sound)
     }
 
     if ((sound->soundFlags & SOUND_FLAG_0x80) == 0 && (status & (AUDIO_ENGINE_SOUND_BUFFER_STATUS_PLAYING | AUDIO_ENGINE_SOUND_BUFFER_STATUS_LOOPING)) != 0) {
-        if ((sound->statusFlags & SOUND_STATUS_IS_PAUSED) == 0 && (sound->type & SOUND_TYPE_STREAMING) != 0) {
+        // CE: Buffers of threaded sounds are refilled by streaming thread.
+        if ((sound->statusFlags & SOUND_STATUS_IS_PAUSED) == 0 && (sound->type & SOUND_TYPE_STREAMING) != 0 && !soundStreamOwns(sound)) {
             refreshSoundBuffers(sound);
         }
     } else if ((sound->statusFlags & SOUND_STATUS_IS_PAUSED) == 0) {
@@ -952,6 +1035,8 @@ bool soundPaused(Sound* sound)
 // 0x49B108
 int soundFlags(Sound* sound, int flags)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return 0;
@@ -1008,6 +1093,8 @@ int soundLength(Sound* sound)
 // 0x49B284
 int soundLoop(Sound* sound, int loops)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -1142,6 +1229,8 @@ int soundSetChannel(Sound* sound, int channels)
 // 0x49B630
 int soundSetReadLimit(Sound* sound, int readLimit)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -1161,6 +1250,8 @@ int soundSetReadLimit(Sound* sound, int readLimit)
 // 0x49B664
 int soundPause(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     bool hr;
     unsigned int readPos;
     unsigned int writePos;
@@ -1205,6 +1296,8 @@ int soundPause(Sound* sound)
 // 0x49B770
 int soundUnpause(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     bool hr;
 
     if (!driverInit) {
@@ -1242,6 +1335,8 @@ int soundUnpause(Sound* sound)
 // 0x49B87C
 int soundSetFileIO(Sound* sound, SoundOpenProc* openProc, SoundCloseProc* closeProc, SoundReadProc* readProc, SoundWriteProc* writeProc, SoundSeekProc* seekProc, SoundTellProc* tellProc, SoundFileLengthProc* fileLengthProc)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -1287,6 +1382,8 @@ int soundSetFileIO(Sound* sound, SoundOpenProc* openProc, SoundCloseProc* closeP
 // 0x49B8F8
 void soundMgrDelete(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     Sound* next;
     Sound* prev;
 
@@ -1362,31 +1459,11 @@ int soundSetMasterVolume(int volume)
     return soundErrorno;
 }
 
-// 0x49BB48
-static Uint32 doTimerEvent(Uint32 interval, void* param)
-{
-    void (*fn)();
-
-    if (param != NULL) {
-        fn = (void (*)())param;
-        fn();
-    }
-
-    return 40;
-}
-
-// 0x49BB94
-static void removeTimedEvent(SDL_TimerID* timerId)
-{
-    if (*timerId != 0) {
-        SDL_RemoveTimer(*timerId);
-        *timerId = 0;
-    }
-}
-
 // 0x49BBB4
 int soundGetPosition(Sound* sound)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -1415,6 +1492,8 @@ int soundGetPosition(Sound* sound)
 // 0x49BC48
 int soundSetPosition(Sound* sound, int pos)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     if (!driverInit) {
         soundErrorno = SOUND_NOT_INITIALIZED;
         return soundErrorno;
@@ -1507,45 +1586,82 @@ static void removeFadeSound(FadeSound* fadeSound)
 static void fadeSounds()
 {
     FadeSound* ptr;
+    FadeSound* next;
 
     ptr = fadeHead;
     while (ptr != NULL) {
+        // CE: Original code never advanced to the next fade. Remember it
+        // before `removeFadeSound` puts `ptr` into free list.
+        next = ptr->next;
+
         if ((ptr->currentVolume > ptr->targetVolume || ptr->currentVolume + ptr->deltaVolume < ptr->targetVolume) && (ptr->currentVolume < ptr->targetVolume || ptr->currentVolume + ptr->deltaVolume > ptr->targetVolume)) {
             ptr->currentVolume += ptr->deltaVolume;
             soundVolume(ptr->sound, ptr->currentVolume);
+        } else if (ptr->targetVolume == 0 && std::this_thread::get_id() == gSoundStreamThreadId) {
+            // CE: Finishing fade out can delete the sound, which runs game
+            // callbacks and closes its file. Silence it now and leave the
+            // rest to `soundUpdate` on the game thread.
+            if (!ptr->finished) {
+                ptr->finished = true;
+                soundVolume(ptr->sound, 0);
+            }
         } else {
-            if (ptr->targetVolume == 0) {
-                if (ptr->field_14) {
-                    soundPause(ptr->sound);
-                    soundVolume(ptr->sound, ptr->initialVolume);
-                } else {
-                    if (ptr->sound->type & 0x04) {
-                        soundDelete(ptr->sound);
-                    } else {
-                        soundStop(ptr->sound);
+            finishFadeSound(ptr);
+        }
+
+        ptr = next;
+    }
+}
+
+static void finishFadeSound(FadeSound* fadeSound)
+{
+    if (fadeSound->targetVolume == 0) {
+        if (fadeSound->field_14) {
+            soundPause(fadeSound->sound);
+            soundVolume(fadeSound->sound, fadeSound->initialVolume);
+        } else {
+            if (fadeSound->sound->type & 0x04) {
+                soundDelete(fadeSound->sound);
+            } else {
+                soundStop(fadeSound->sound);
 
-                        ptr->initialVolume = ptr->targetVolume;
-                        ptr->currentVolume = ptr->targetVolume;
-                        ptr->deltaVolume = 0;
+                fadeSound->initialVolume = fadeSound->targetVolume;
+                fadeSound->currentVolume = fadeSound->targetVolume;
+                fadeSound->deltaVolume = 0;
 
-                        soundVolume(ptr->sound, ptr->targetVolume);
-                    }
-                }
+                soundVolume(fadeSound->sound, fadeSound->targetVolume);
             }
-
-            removeFadeSound(ptr);
         }
     }
 
+    removeFadeSound(fadeSound);
+}
+
+// CE: Runs fade steps that are due, in fixed increments so that fade
+// duration does not depend on how often this is called. Returns delay in ms
+// until the next step, or 0 if nothing is fading.
+//
+// Must be called with `gSoundMutex` held.
+static int soundStepFades()
+{
+    unsigned int now = get_time();
+    while (fadeHead != NULL && now - gFadeSoundsLastTick >= SOUND_FADE_INTERVAL) {
+        fadeSounds();
+        gFadeSoundsLastTick += SOUND_FADE_INTERVAL;
+    }
+
     if (fadeHead == NULL) {
-        // NOTE: Uninline.
-        removeTimedEvent(&gFadeSoundsTimerId);
+        return 0;
     }
+
+    return SOUND_FADE_INTERVAL - (int)(now - gFadeSoundsLastTick);
 }
 
 // 0x49BF04
 static int internalSoundFade(Sound* sound, int duration, int targetVolume, int a4)
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     FadeSound* ptr;
 
     if (!deviceInit) {
@@ -1558,6 +1674,10 @@ static int internalSoundFade(Sound* sound, int duration, int targetVolume, int a
         return soundErrorno;
     }
 
+    if (fadeHead == NULL) {
+        gFadeSoundsLastTick = get_time();
+    }
+
     ptr = NULL;
     if ((sound->statusFlags & SOUND_STATUS_IS_FADING) != 0) {
         ptr = fadeHead;
@@ -1599,6 +1719,7 @@ static int internalSoundFade(Sound* sound, int duration, int targetVolume, int a
     ptr->initialVolume = soundGetVolume(sound);
     ptr->currentVolume = ptr->initialVolume;
     ptr->field_14 = a4;
+    ptr->finished = false;
     // TODO: Check.
     ptr->deltaVolume = 8 * (125 * (targetVolume - ptr->initialVolume)) / (40 * duration);
 
@@ -1621,15 +1742,10 @@ static int internalSoundFade(Sound* sound, int duration, int targetVolume, int a
         soundPlay(sound);
     }
 
-    if (gFadeSoundsTimerId != 0) {
-        soundErrorno = SOUND_NO_ERROR;
-        return soundErrorno;
-    }
-
-    gFadeSoundsTimerId = SDL_AddTimer(40, doTimerEvent, (void*)fadeSounds);
-    if (gFadeSoundsTimerId == 0) {
-        soundErrorno = SOUND_UNKNOWN_ERROR;
-        return soundErrorno;
+    // CE: Streaming thread might be asleep with nothing to stream, it steps
+    // fades from now on.
+    if (gSoundStreamThread != nullptr) {
+        gSoundStreamWake.notify_one();
     }
 
     soundErrorno = SOUND_NO_ERROR;
@@ -1645,6 +1761,8 @@ int soundFade(Sound* sound, int duration, int targetVolume)
 // 0x49C0D0
 void soundFlushAllSounds()
 {
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
     while (soundMgrList != NULL) {
         soundDelete(soundMgrList);
     }
@@ -1653,6 +1771,22 @@ void soundFlushAllSounds()
 // 0x49C15C
 void soundUpdate()
 {
+    ProfilerZone zone("soundUpdate");
+
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
+    soundStepFades();
+
+    // CE: Finish fade outs the streaming thread left for the game thread.
+    FadeSound* fadeSound = fadeHead;
+    while (fadeSound != NULL) {
+        FadeSound* next = fadeSound->next;
+        if (fadeSound->finished) {
+            finishFadeSound(fadeSound);
+        }
+        fadeSound = next;
+    }
+
     Sound* curr = soundMgrList;
     while (curr != NULL) {
         // Sound can be deallocated in `soundContinue`.
@@ -1697,4 +1831,141 @@ int soundSetDefaultFileIO(SoundOpenProc* openProc, SoundCloseProc* closeProc, So
     return soundErrorno;
 }
 
+// CE: Marks IO procs of the sound as safe to call from the streaming thread
+// (they must not touch `db`, which is not thread-safe). Streaming buffers of
+// such sounds are refilled in the background, so playback survives main
+// thread stalls.
+int soundSetThreadedIO(Sound* sound, bool threaded)
+{
+    std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+
+    if (sound == NULL) {
+        soundErrorno = SOUND_NO_SOUND;
+        return soundErrorno;
+    }
+
+    sound->threadedIO = threaded;
+
+    if (soundStreamOwns(sound)) {
+        gSoundStreamWake.notify_one();
+    }
+
+    soundErrorno = SOUND_NO_ERROR;
+    return soundErrorno;
+}
+
+// CE: Returns number of streaming underruns since the sound system was
+// initialized.
+int soundGetUnderruns()
+{
+    return gSoundUnderruns;
+}
+
+// Reports that streaming sound wrapped around to its loop start. Callbacks
+// run on the game thread, notifications raised by the streaming thread are
+// delivered later by `soundContinue`.
+static void soundLoopCallback(Sound* sound)
+{
+    if (std::this_thread::get_id() == gSoundStreamThreadId) {
+        sound->pendingLoops++;
+        return;
+    }
+
+    if (sound->callback != NULL) {
+        sound->callback(sound->callbackUserData, 0x400);
+    }
+}
+
+static bool soundStreamOwns(Sound* sound)
+{
+    return gSoundStreamThread != nullptr
+        && sound->threadedIO
+        && (sound->type & SOUND_TYPE_STREAMING) != 0;
+}
+
+static void soundStreamStart()
+{
+    // Headless mode mixes sound on the fixed clock, refills have to stay in
+    // step with it.
+    if (audioEngineIsHeadless()) {
+        return;
+    }
+
+    gSoundStreamQuit = false;
+    gSoundStreamThread = new std::thread(soundStreamThread);
+    gSoundStreamThreadId = gSoundStreamThread->get_id();
+}
+
+static void soundStreamStop()
+{
+    if (gSoundStreamThread == nullptr) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(gSoundMutex);
+        gSoundStreamQuit = true;
+    }
+
+    gSoundStreamWake.notify_one();
+    gSoundStreamThread->join();
+
+    delete gSoundStreamThread;
+    gSoundStreamThread = nullptr;
+    gSoundStreamThreadId = std::thread::id();
+}
+
+// Refills streaming buffers of threaded sounds and steps fades. Sleeps for
+// half a buffer section between refills (or until the next fade step), or
+// until a sound starts playing or fading when there is nothing to do.
+static void soundStreamThread()
+{
+    std::unique_lock<std::recursive_mutex> lock(gSoundMutex);
+
+    while (!gSoundStreamQuit) {
+        int interval = soundStepFades();
+
+        for (Sound* curr = soundMgrList; curr != NULL; curr = curr->next) {
+            if (!soundStreamOwns(curr) || curr->soundBuffer == -1) {
+                continue;
+            }
+
+            if ((curr->statusFlags & (SOUND_STATUS_IS_PLAYING | SOUND_STATUS_IS_PAUSED)) != SOUND_STATUS_IS_PLAYING) {
+                continue;
+            }
+
+            if ((curr->soundFlags & SOUND_FLAG_0x80) != 0) {
+                continue;
+            }
+
+            unsigned int status;
+            if (!audioEngineSoundBufferGetStatus(curr->soundBuffer, &status)) {
+                continue;
+            }
+
+            if ((status & (AUDIO_ENGINE_SOUND_BUFFER_STATUS_PLAYING | AUDIO_ENGINE_SOUND_BUFFER_STATUS_LOOPING)) == 0) {
+                continue;
+            }
+
+            {
+                ProfilerZone zone("soundStream");
+                refreshSoundBuffers(curr);
+            }
+
+            int bytesPerSecond = curr->bitsPerSample / 8 * curr->channels * curr->rate;
+            int sectionInterval = bytesPerSecond != 0 ? (int)((long long)curr->dataSize * 1000 / bytesPerSecond / 2) : SOUND_STREAM_MAX_INTERVAL;
+            sectionInterval = std::clamp(sectionInterval, SOUND_STREAM_MIN_INTERVAL, SOUND_STREAM_MAX_INTERVAL);
+            if (interval == 0 || sectionInterval < interval) {
+                interval = sectionInterval;
+            }
+        }
+
+        if (interval != 0) {
+            gSoundStreamWake.wait_for(lock, std::chrono::milliseconds(interval));
+        } else {
+            gSoundStreamWake.wait(lock);
+        }
+    }
+}
+
 } // namespace fallout
@@ -121,6 +121,18 @@ typedef struct Sound {
     SoundDeleteCallback* deleteCallback;
     struct Sound* next;
     struct Sound* prev;
+
+    // CE: Streaming buffers of this sound are refilled by the streaming
+    // thread, see `soundSetThreadedIO`.
+    bool threadedIO;
+
+    // CE: Number of loop notifications raised by the streaming thread and not
+    // yet delivered to `callback`.
+    int pendingLoops;
+
+    // CE: Number of times playback caught up with unfilled part of streaming
+    // buffers.
+    int underruns;
 } Sound;
 
 void soundRegisterAlloc(SoundMallocFunc* mallocProc, SoundReallocFunc* reallocProc, SoundFreeFunc* freeProc);
@@ -160,6 +172,8 @@ int soundSetPosition(Sound* sound, int a2);
 int soundFade(Sound* sound, int duration, int targetVolume);
 void soundFlushAllSounds();
 void soundUpdate();
+int soundSetThreadedIO(Sound* sound, bool threaded);
+int soundGetUnderruns();
 int soundSetDefaultFileIO(SoundOpenProc* openProc, SoundCloseProc* closeProc, SoundReadProc* readProc, SoundWriteProc* writeProc, SoundSeekProc* seekProc, SoundTellProc* tellProc, SoundFileLengthProc* fileLengthProc);
 
 } // namespace fallout
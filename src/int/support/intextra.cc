@@ -1655,6 +1655,7 @@ static void objs_area_turn_on_off(int a1, int a2, int a3, int a4, int enabled)
             }
             object = obj_find_next_at();
         }
+        obj_blocking_invalidate(a1);
         tile_refresh_rect(&rect, a1);
     }
 }
@@ -1714,6 +1715,8 @@ static void op_set_obj_visibility(Program* program)
                 obj->flags |= OBJECT_NO_BLOCK;
             }
 
+            obj_blocking_invalidate(obj->elevation);
+
             tile_refresh_rect(&rect, obj->elevation);
         }
     } else {
@@ -1724,6 +1727,8 @@ static void op_set_obj_visibility(Program* program)
 
             obj->flags &= ~OBJECT_HIDDEN;
 
+            obj_blocking_invalidate(obj->elevation);
+
             Rect rect;
             obj_bound(obj, &rect);
             tile_refresh_rect(&rect, obj->elevation);
@@ -13,10 +13,18 @@
 #include <stdlib.h>
 #else
 #include <dirent.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #endif
 
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#elif defined(__APPLE__)
+#include <sys/clonefile.h>
+#endif
+
 #ifdef _WIN32
 #include <timeapi.h>
 #else
@@ -273,6 +281,88 @@ int compat_rename(const char* oldFileName, const char* newFileName)
     return rename(nativeOldFileName, nativeNewFileName);
 }
 
+// Copies file contents. Where filesystem supports copy-on-write clones they
+// are used, so no data is actually copied.
+int compat_copy_file(const char* sourcePath, const char* destPath)
+{
+    char nativeSourcePath[COMPAT_MAX_PATH];
+    strcpy(nativeSourcePath, sourcePath);
+    compat_windows_path_to_native(nativeSourcePath);
+    compat_resolve_path(nativeSourcePath);
+
+    char nativeDestPath[COMPAT_MAX_PATH];
+    strcpy(nativeDestPath, destPath);
+    compat_windows_path_to_native(nativeDestPath);
+    compat_resolve_path(nativeDestPath);
+
+#ifdef _WIN32
+    return CopyFileA(nativeSourcePath, nativeDestPath, FALSE) ? 0 : -1;
+#else
+#if defined(__APPLE__)
+    unlink(nativeDestPath);
+    if (clonefile(nativeSourcePath, nativeDestPath, 0) == 0) {
+        return 0;
+    }
+#endif
+
+    int sourceFd = open(nativeSourcePath, O_RDONLY);
+    if (sourceFd == -1) {
+        return -1;
+    }
+
+    int destFd = open(nativeDestPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (destFd == -1) {
+        close(sourceFd);
+        return -1;
+    }
+
+    int rc = 0;
+
+#if defined(__linux__) && defined(FICLONE)
+    if (ioctl(destFd, FICLONE, sourceFd) == 0) {
+        close(sourceFd);
+        close(destFd);
+        return 0;
+    }
+#endif
+
+    char buf[0x10000];
+    while (true) {
+        ssize_t bytesRead = read(sourceFd, buf, sizeof(buf));
+        if (bytesRead == 0) {
+            break;
+        }
+
+        if (bytesRead == -1) {
+            rc = -1;
+            break;
+        }
+
+        ssize_t offset = 0;
+        while (offset < bytesRead) {
+            ssize_t bytesWritten = write(destFd, buf + offset, bytesRead - offset);
+            if (bytesWritten <= 0) {
+                break;
+            }
+            offset += bytesWritten;
+        }
+
+        if (offset != bytesRead) {
+            rc = -1;
+            break;
+        }
+    }
+
+    close(sourceFd);
+
+    if (close(destFd) != 0) {
+        rc = -1;
+    }
+
+    return rc;
+#endif
+}
+
 void compat_windows_path_to_native(char* path)
 {
 #ifndef _WIN32
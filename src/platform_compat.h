@@ -37,6 +37,7 @@ unsigned int compat_timeGetTime();
 FILE* compat_fopen(const char* path, const char* mode);
 int compat_remove(const char* path);
 int compat_rename(const char* oldFileName, const char* newFileName);
+int compat_copy_file(const char* sourcePath, const char* destPath);
 void compat_windows_path_to_native(char* path);
 void compat_resolve_path(char* path);
 char* compat_strdup(const char* string);
@@ -1,6 +1,7 @@
 #include "plib/assoc/assoc.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -13,10 +14,22 @@ namespace fallout {
 // with a check for this value.
 #define DICTIONARY_MARKER 0xFEBAFEBA
 
+// Arrays with fewer entries are searched with bisection only, unless they were
+// read with `assoc_load`.
+#define ASSOC_INDEX_THRESHOLD 16
+
+#define FNV_OFFSET_BASIS 0x811C9DC5U
+#define FNV_PRIME 0x01000193U
+
 static void* default_malloc(size_t t);
 static void* default_realloc(void* p, size_t t);
 static void default_free(void* p);
 static int assoc_find(assoc_array* a, const char* name, int* position);
+static int assoc_bisect(assoc_array* a, const char* name, int* position);
+static unsigned int assoc_hash(const char* name);
+static int assoc_index_build(assoc_array* a);
+static int assoc_index_insert(assoc_array* a, int position);
+static void assoc_index_free(assoc_array* a);
 static int assoc_read_long(FILE* fp, long* theLong);
 static int assoc_read_assoc_array(FILE* fp, assoc_array* a);
 static int assoc_write_long(FILE* fp, long theLong);
@@ -55,6 +68,9 @@ int assoc_init(assoc_array* a, int n, size_t datasize, assoc_func_list* assoc_fu
     a->max = n;
     a->datasize = datasize;
     a->size = 0;
+    a->index = NULL;
+    a->index_size = 0;
+    a->index_valid = false;
 
     if (assoc_funcs != NULL) {
         memcpy(&(a->load_save_funcs), assoc_funcs, sizeof(*assoc_funcs));
@@ -127,6 +143,8 @@ int assoc_free(assoc_array* a)
         internal_free(a->list);
     }
 
+    assoc_index_free(a);
+
     memset(a, 0, sizeof(*a));
 
     return 0;
@@ -137,6 +155,11 @@ int assoc_free(assoc_array* a)
 // Returns 0 if key is found. Otherwise returns -1, in this case [indexPtr]
 // specifies an insertion point for given key.
 //
+// CE: Original code narrowed the range by one entry at a time (`l + 1` and
+// `r - 1` instead of `mid + 1` and `mid - 1`), which made it a linear scan.
+// Exact matches are looked up in the hash index when there is one, bisection
+// is only used when the array is small or to find an insertion point.
+//
 // 0x4D9CC4
 static int assoc_find(assoc_array* a, const char* name, int* position)
 {
@@ -149,6 +172,37 @@ static int assoc_find(assoc_array* a, const char* name, int* position)
         return -1;
     }
 
+    if (!a->index_valid && (a->index != NULL || a->size >= ASSOC_INDEX_THRESHOLD)) {
+        assoc_index_build(a);
+    }
+
+    if (a->index_valid) {
+        unsigned int hash = assoc_hash(name);
+        int mask = a->index_size - 1;
+        int slot = hash & mask;
+        while (a->index[slot] != 0) {
+            assoc_pair* entry = &(a->list[a->index[slot] - 1]);
+            if (entry->hash == hash && compat_stricmp(name, entry->name) == 0) {
+                *position = a->index[slot] - 1;
+                return 0;
+            }
+            slot = (slot + 1) & mask;
+        }
+    }
+
+    return assoc_bisect(a, name, position);
+}
+
+// Same as `assoc_find`, but only uses bisection and never touches the hash
+// index. Used by `assoc_insert`, so that building an array does not rebuild
+// the index on every insertion.
+static int assoc_bisect(assoc_array* a, const char* name, int* position)
+{
+    if (a->size == 0) {
+        *position = 0;
+        return -1;
+    }
+
     int r = a->size - 1;
     int l = 0;
     int mid = 0;
@@ -162,9 +216,9 @@ static int assoc_find(assoc_array* a, const char* name, int* position)
         }
 
         if (cmp > 0) {
-            l = l + 1;
+            l = mid + 1;
         } else {
-            r = r - 1;
+            r = mid - 1;
         }
     }
 
@@ -182,6 +236,95 @@ static int assoc_find(assoc_array* a, const char* name, int* position)
     return -1;
 }
 
+// Returns FNV-1a hash of case-folded key, keys that are equal according to
+// `compat_stricmp` have equal hashes.
+static unsigned int assoc_hash(const char* name)
+{
+    unsigned int hash = FNV_OFFSET_BASIS;
+    for (const unsigned char* ch = (const unsigned char*)name; *ch != '\0'; ch++) {
+        hash ^= (unsigned int)toupper(*ch);
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// Rebuilds hash index from [list]. Keeps table at most half full.
+//
+// Returns 0 on success, or -1 if index cannot be allocated, in this case
+// lookups fall back to bisection.
+static int assoc_index_build(assoc_array* a)
+{
+    int indexSize = 16;
+    while (indexSize < a->size * 2) {
+        indexSize *= 2;
+    }
+
+    if (a->index == NULL || a->index_size != indexSize) {
+        int* index = (int*)internal_realloc(a->index, sizeof(*index) * indexSize);
+        if (index == NULL) {
+            assoc_index_free(a);
+            return -1;
+        }
+
+        a->index = index;
+        a->index_size = indexSize;
+    }
+
+    memset(a->index, 0, sizeof(*a->index) * a->index_size);
+
+    int mask = a->index_size - 1;
+    for (int entryIndex = 0; entryIndex < a->size; entryIndex++) {
+        int slot = a->list[entryIndex].hash & mask;
+        while (a->index[slot] != 0) {
+            slot = (slot + 1) & mask;
+        }
+        a->index[slot] = entryIndex + 1;
+    }
+
+    a->index_valid = true;
+
+    return 0;
+}
+
+// Adds entry just inserted at [position] to valid hash index. Entries after
+// it have moved one place down in [list], their slots are renumbered.
+//
+// Returns 0 on success, or -1 if index had to grow and cannot be
+// reallocated (see `assoc_index_build`).
+static int assoc_index_insert(assoc_array* a, int position)
+{
+    if (a->size * 2 > a->index_size) {
+        return assoc_index_build(a);
+    }
+
+    int* index = a->index;
+    int indexSize = a->index_size;
+
+    for (int slot = 0; slot < indexSize; slot++) {
+        index[slot] += index[slot] > position ? 1 : 0;
+    }
+
+    int mask = indexSize - 1;
+    int slot = a->list[position].hash & mask;
+    while (index[slot] != 0) {
+        slot = (slot + 1) & mask;
+    }
+    index[slot] = position + 1;
+
+    return 0;
+}
+
+static void assoc_index_free(assoc_array* a)
+{
+    if (a->index != NULL) {
+        internal_free(a->index);
+    }
+
+    a->index = NULL;
+    a->index_size = 0;
+    a->index_valid = false;
+}
+
 // Returns the index of the entry for the specified key, or -1 if it's not
 // present in the dictionary.
 //
@@ -213,8 +356,9 @@ int assoc_insert(assoc_array* a, const char* name, const void* data)
         return -1;
     }
 
+    // CE: Bisect directly, `assoc_find` would rebuild stale index.
     int newElementIndex;
-    if (assoc_find(a, name, &newElementIndex) == 0) {
+    if (assoc_bisect(a, name, &newElementIndex) == 0) {
         // Element for this key is already exists.
         return -1;
     }
@@ -259,9 +403,14 @@ int assoc_insert(assoc_array* a, const char* name, const void* data)
     assoc_pair* entry = &(a->list[newElementIndex]);
     entry->name = keyCopy;
     entry->data = valueCopy;
+    entry->hash = assoc_hash(keyCopy);
 
     a->size++;
 
+    if (a->index_valid) {
+        assoc_index_insert(a, newElementIndex);
+    }
+
     return 0;
 }
 
@@ -291,6 +440,7 @@ int assoc_delete(assoc_array* a, const char* name)
     }
 
     a->size--;
+    a->index_valid = false;
 
     // Starting from the index of the entry we've just removed, loop thru the
     // remaining of the array and move entries up one by one.
@@ -414,6 +564,8 @@ int assoc_load(FILE* fp, assoc_array* a, int flags)
         internal_free(a->list);
     }
 
+    a->index_valid = false;
+
     if (assoc_read_assoc_array(fp, a) != 0) {
         return -1;
     }
@@ -455,6 +607,8 @@ int assoc_load(FILE* fp, assoc_array* a, int flags)
             return -1;
         }
 
+        entry->hash = assoc_hash(entry->name);
+
         if (a->datasize != 0) {
             entry->data = internal_malloc(a->datasize);
             if (entry->data == NULL) {
@@ -473,6 +627,10 @@ int assoc_load(FILE* fp, assoc_array* a, int flags)
         }
     }
 
+    // CE: DAT directories are only ever searched after loading, index them
+    // upfront regardless of size.
+    assoc_index_build(a);
+
     return 0;
 }
 
@@ -27,6 +27,9 @@ typedef struct assoc_func_list {
 typedef struct assoc_pair {
     char* name;
     void* data;
+
+    // CE: Hash of case-folded [name], see `assoc_hash`.
+    unsigned int hash;
 } assoc_pair;
 
 // A collection of key/value pairs.
@@ -52,6 +55,18 @@ typedef struct assoc_array {
 
     // The array of key-value pairs.
     assoc_pair* list;
+
+    // CE: Open addressing hash table over [list]. Every slot holds entry
+    // index plus one, zero marks an empty slot. Built by `assoc_load` and
+    // lazily on lookup for large arrays. Kept up to date by `assoc_insert`,
+    // rebuilt on the next lookup after `assoc_delete`.
+    int* index;
+
+    // CE: The number of slots in [index] (power of two).
+    int index_size;
+
+    // CE: Whether [index] matches current [list].
+    bool index_valid;
 } assoc_array;
 
 int assoc_init(assoc_array* a, int n, size_t datasize, assoc_func_list* assoc_funcs);
@@ -1,14 +1,23 @@
 #include "plib/db/db.h"
 
+#include <ctype.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #if defined(_WIN32)
+#include <io.h>
 #include <windows.h>
 #else
 #include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 #include <fpattern/fpattern.h>
@@ -21,7 +30,19 @@ namespace fallout {
 
 #define DB_DATABASE_LIST_CAPACITY 10
 #define DB_DATABASE_FILE_LIST_CAPACITY 32
-#define DB_HASH_TABLE_SIZE 4095
+
+// CE: Initial number of path resolver slots, must be a power of two.
+#define DB_RESOLVER_INITIAL_CAPACITY 4096
+
+// CE: Size of blocks path resolver keeps its keys in.
+#define DB_RESOLVER_NAMES_BLOCK_SIZE 65536
+
+// CE: File is in patches directory (found by the scan or written by the
+// game).
+#define DB_RESOLVER_PATCH 0x01
+
+// CE: Directory in patches directory the game has written to.
+#define DB_RESOLVER_WRITTEN_DIR 0x02
 
 #if defined(_WIN32)
 #define PATH_SEP '\\'
@@ -29,6 +50,22 @@ namespace fallout {
 #define PATH_SEP '/'
 #endif
 
+// CE: Marks an in-memory (type 16) stream whose buffer is owned by someone
+// else - the memory-mapped datafile (stored entries), a prefetch entry, or
+// the caller of `db_fopen_mem`. Such buffers must not be freed when the
+// stream is closed.
+#define DB_FILE_FLAG_BORROWED 0x100
+
+#define DB_PREFETCH_TABLE_SIZE 256
+#define DB_PREFETCH_MAX_WORKERS 4
+
+typedef enum DbPrefetchState {
+    DB_PREFETCH_STATE_QUEUED,
+    DB_PREFETCH_STATE_LOADING,
+    DB_PREFETCH_STATE_READY,
+    DB_PREFETCH_STATE_FAILED,
+} DbPrefetchState;
+
 typedef struct DB_FILE {
     DB_DATABASE* database;
     unsigned int flags;
@@ -42,8 +79,38 @@ typedef struct DB_FILE {
     int field_18;
     unsigned char* field_1C;
     unsigned char* field_20;
+
+    // CE: Prefetch entry `field_1C` is borrowed from.
+    struct DB_PREFETCH_ENTRY* prefetch;
+
+    // CE: Datafile offsets of chunk headers of chunked (type 64) entry,
+    // first `chunk_offsets_length` of them are known. They are recorded as
+    // chunks are read, `db_fseek` uses them to decode only the chunk it lands
+    // in. `NULL` if the index could not be allocated.
+    int* chunk_offsets;
+    int chunk_offsets_length;
+
+    // CE: Index of the chunk `field_18` points to.
+    int chunk_index;
 } DB_FILE;
 
+// CE: Path resolver entry, see `db_resolve`.
+typedef struct DB_RESOLVER_ENTRY {
+    // Path relative to datafile and patches roots in upper case with
+    // backslash separators, or `NULL` if the slot is empty.
+    char* name;
+    unsigned int hash;
+    int flags;
+    // Entry of the file in datafile, or `NULL` if datafile does not have it.
+    dir_entry* de;
+} DB_RESOLVER_ENTRY;
+
+typedef struct DB_RESOLVER_NAMES {
+    struct DB_RESOLVER_NAMES* next;
+    size_t used;
+    char data[DB_RESOLVER_NAMES_BLOCK_SIZE];
+} DB_RESOLVER_NAMES;
+
 typedef struct DB_DATABASE {
     char* datafile;
     FILE* stream;
@@ -54,9 +121,56 @@ typedef struct DB_DATABASE {
     assoc_array* entries;
     int files_length;
     DB_FILE files[DB_DATABASE_FILE_LIST_CAPACITY];
-    unsigned char* hash_table;
+
+    // CE: Path resolver (replaces patches hash table). Open addressing table
+    // of every known path - datafile entries, files in patches directory and
+    // paths that were looked up but found nowhere. `NULL` when not
+    // available, lookups go to the filesystem and `db_find_dir_entry` then.
+    DB_RESOLVER_ENTRY* resolver;
+    int resolver_capacity;
+    int resolver_length;
+    DB_RESOLVER_NAMES* resolver_names;
+    // Number of entries with `DB_RESOLVER_WRITTEN_DIR`.
+    int resolver_written_dirs;
+    // Patches directory was scanned, files without `DB_RESOLVER_PATCH` are
+    // not there (unless their directory was written to).
+    bool resolver_patches_scanned;
+
+    // CE: Read-only view of the whole datafile (see `db_enable_mmap`), or
+    // `NULL` when entries are read through `stream`.
+    unsigned char* mapping;
+    size_t mapping_size;
+#if defined(_WIN32)
+    HANDLE mapping_handle;
+#endif
 } DB_DATABASE;
 
+// CE: File read ahead of time by prefetch workers, see `db_prefetch`.
+//
+// Everything up to `state` is set up on the main thread before the entry is
+// queued. `state`, `data` and `size` are published by the worker under
+// `prefetch_mutex`. Memory is managed with the C runtime since workers cannot
+// use registered `db_malloc`.
+typedef struct DB_PREFETCH_ENTRY {
+    DB_DATABASE* database;
+    char* filename;
+    // Native path in the patches directory, or `NULL` if patches should not
+    // be checked.
+    char* patch_path;
+    bool has_dir_entry;
+    dir_entry de;
+    int state;
+    unsigned char* data;
+    int size;
+    // Number of open streams borrowing `data`.
+    int refs;
+    // Entry was removed from the table while in use, it is freed when the
+    // last stream is closed.
+    bool orphaned;
+    struct DB_PREFETCH_ENTRY* next;
+    struct DB_PREFETCH_ENTRY* next_job;
+} DB_PREFETCH_ENTRY;
+
 typedef struct DB_FIND_DATA {
 #if defined(_WIN32)
     HANDLE hFind;
@@ -78,16 +192,34 @@ static int db_create_database(DB_DATABASE** database_ptr);
 static int db_destroy_database(DB_DATABASE** database_ptr);
 static int db_init_database(DB_DATABASE* database, const char* datafile, const char* datafile_path);
 static void db_exit_database(DB_DATABASE* database);
+static void db_map_database(DB_DATABASE* database);
+static void db_unmap_database(DB_DATABASE* database);
+static bool db_mapping_contains(DB_DATABASE* database, int offset, int length);
+static int db_read_mapped_to_buf(DB_DATABASE* database, dir_entry* de, unsigned char* buf, bool notify);
+static unsigned int db_prefetch_hash(const char* filename);
+static DB_PREFETCH_ENTRY* db_prefetch_find(DB_DATABASE* database, const char* filename);
+static DB_PREFETCH_ENTRY* db_prefetch_acquire(DB_DATABASE* database, const char* filename);
+static void db_prefetch_release(DB_PREFETCH_ENTRY* entry);
+static void db_prefetch_forget(DB_DATABASE* database, const char* filename);
+static void db_prefetch_free_entry(DB_PREFETCH_ENTRY* entry);
+static int db_prefetch_load(DB_PREFETCH_ENTRY* entry);
+static int db_prefetch_read_entry(DB_DATABASE* database, dir_entry* de, unsigned char* buf);
+static void db_prefetch_worker();
+static void db_prefetch_exit();
 static int db_init_patches(DB_DATABASE* database, const char* path);
 static void db_exit_patches(DB_DATABASE* database);
-static int db_init_hash_table(DB_DATABASE* database);
-static int db_reset_hash_table(DB_DATABASE* database);
-static int db_fill_hash_table(DB_DATABASE* database, const char* path);
-static int db_add_hash_entry_to_database(DB_DATABASE* database, const char* path, int sep);
-static int db_set_hash_value(DB_DATABASE* database, unsigned int key, unsigned char enabled);
-static int db_get_hash_value(DB_DATABASE* database, const char* path, int sep, int* value_ptr);
-static int db_hash_string_to_key(const char* path, int sep, unsigned int* key_ptr);
-static void db_exit_hash_table(DB_DATABASE* database);
+static int db_init_resolver(DB_DATABASE* database);
+static int db_reset_resolver_patches(DB_DATABASE* database);
+static int db_scan_resolver_patches(DB_DATABASE* database, const char* path, const char* key_prefix);
+static int db_resolver_add_patch(DB_DATABASE* database, const char* filename);
+static DB_RESOLVER_ENTRY* db_resolve(DB_DATABASE* database, const char* filename);
+static bool db_resolver_patch_may_exist(DB_DATABASE* database, DB_RESOLVER_ENTRY* entry);
+static bool db_resolver_normalize(const char* path, char* dest, size_t size);
+static unsigned int db_resolver_hash(const char* key);
+static DB_RESOLVER_ENTRY* db_resolver_find(DB_DATABASE* database, const char* key, bool insert);
+static int db_resolver_grow(DB_DATABASE* database);
+static char* db_resolver_intern(DB_DATABASE* database, const char* key);
+static void db_exit_resolver(DB_DATABASE* database);
 static DB_FILE* db_add_fp_rec(FILE* stream, unsigned char* a2, int a3, int flags);
 static int db_delete_fp_rec(DB_FILE* stream);
 static int db_find_empty_position(int* position_ptr);
@@ -102,7 +234,12 @@ static void* db_default_malloc(size_t size);
 static char* db_default_strdup(const char* string);
 static void db_default_free(void* ptr);
 static void db_preload_buffer(DB_FILE* stream);
+static int db_seek_chunk(DB_FILE* stream, long offset);
 static int fread_short(FILE* stream, unsigned short* s);
+static int db_fread_bytes(DB_FILE* stream, unsigned char* buf, int length);
+static int db_fwrite_bytes(DB_FILE* stream, const unsigned char* buf, int length);
+static void db_decode_shorts(unsigned short* arr, int count);
+static void db_decode_ints(int* arr, int count);
 
 static inline bool fileFindIsDirectory(DB_FIND_DATA* find_data);
 static inline char* fileFindGetName(DB_FIND_DATA* find_data);
@@ -128,6 +265,38 @@ static db_free_func* db_free = db_default_free;
 // 0x539D48
 static bool hash_is_on = false;
 
+// Serve datafile entries from a memory mapping instead of `FILE*` reads.
+static bool mmap_is_on = false;
+
+// Guards prefetch table, job queue and entry states.
+static std::mutex prefetch_mutex;
+
+// Signalled when a job is queued or workers should stop.
+static std::condition_variable prefetch_work_cond;
+
+// Signalled when a job is finished.
+static std::condition_variable prefetch_done_cond;
+
+static std::thread* prefetch_workers[DB_PREFETCH_MAX_WORKERS];
+
+static int prefetch_workers_length = 0;
+
+static bool prefetch_stop = false;
+
+// Prefetch entries hashed by file name.
+static DB_PREFETCH_ENTRY* prefetch_table[DB_PREFETCH_TABLE_SIZE];
+
+// Number of entries in `prefetch_table`. Only changed on the main thread, so
+// the main thread can check it without locking.
+static int prefetch_entries_length = 0;
+
+static DB_PREFETCH_ENTRY* prefetch_queue_head = NULL;
+
+static DB_PREFETCH_ENTRY* prefetch_queue_tail = NULL;
+
+// Number of entries being loaded right now.
+static int prefetch_in_flight = 0;
+
 // NOTE: Original type is `unsigned long`.
 //
 // 0x539D4C
@@ -167,10 +336,9 @@ DB_DATABASE* db_init(const char* datafile, const char* datafile_path, const char
         current_database = database;
     }
 
-    if (hash_is_on) {
-        if (db_init_hash_table(database) != 0) {
-            database->hash_table = NULL;
-        }
+    // CE: Resolver is an optimization, lookups work without it.
+    if (db_init_resolver(database) != 0) {
+        db_exit_resolver(database);
     }
 
     return database;
@@ -232,13 +400,16 @@ int db_close(DB_DATABASE* db_handle)
 
     for (index = 0; index < DB_DATABASE_LIST_CAPACITY; index++) {
         if (database_list[index] == (DB_DATABASE*)db_handle) {
+            // CE: Workers might be reading from this database.
+            db_prefetch_clear();
+
             if (database_list[index] == current_database) {
                 current_database = NULL;
             }
 
             db_exit_database(database_list[index]);
             db_exit_patches(database_list[index]);
-            db_exit_hash_table(database_list[index]);
+            db_exit_resolver(database_list[index]);
             db_destroy_database(&(database_list[index]));
 
             return 0;
@@ -258,6 +429,8 @@ void db_exit()
             db_close(database_list[index]);
         }
     }
+
+    db_prefetch_exit();
 }
 
 // 0x4AF068
@@ -266,8 +439,8 @@ int db_dir_entry(const char* name, dir_entry* de)
     char path[COMPAT_MAX_PATH];
     bool v2;
     bool v3;
-    int value;
     FILE* stream;
+    DB_RESOLVER_ENTRY* resolved;
 
     if (current_database == NULL) {
         return -1;
@@ -282,9 +455,12 @@ int db_dir_entry(const char* name, dir_entry* de)
     }
 
     v2 = true;
+    resolved = NULL;
     if (name[0] == '@') {
         strcpy(path, name + 1);
         v2 = false;
+    } else {
+        resolved = db_resolve(current_database, name);
     }
 
     if (current_database->patches_path != NULL) {
@@ -297,7 +473,7 @@ int db_dir_entry(const char* name, dir_entry* de)
 
         compat_windows_path_to_native(path);
 
-        if (db_get_hash_value(current_database, path, PATH_SEP, &value) != 0 || value == 1) {
+        if (db_resolver_patch_may_exist(current_database, resolved)) {
             v3 = true;
         }
 
@@ -319,14 +495,22 @@ int db_dir_entry(const char* name, dir_entry* de)
         return -1;
     }
 
-    if (v2) {
-        snprintf(path, sizeof(path), "%s%s", current_database->datafile_path, name);
-    }
+    if (resolved != NULL) {
+        if (resolved->de == NULL) {
+            return -1;
+        }
 
-    compat_strupr(path);
+        *de = *resolved->de;
+    } else {
+        if (v2) {
+            snprintf(path, sizeof(path), "%s%s", current_database->datafile_path, name);
+        }
 
-    if (db_find_dir_entry(path, de) != 0) {
-        return -1;
+        compat_strupr(path);
+
+        if (db_find_dir_entry(path, de) != 0) {
+            return -1;
+        }
     }
 
     if (de->flags == 0) {
@@ -345,7 +529,6 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
     char path[COMPAT_MAX_PATH];
     bool v3;
     FILE* stream;
-    int hash_value;
     int size;
     size_t bytes_read;
     int remaining_size;
@@ -353,6 +536,8 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
     dir_entry de;
     unsigned char* end;
     unsigned short v4;
+    DB_PREFETCH_ENTRY* prefetch;
+    DB_RESOLVER_ENTRY* resolved;
 
     if (current_database == NULL) {
         return -1;
@@ -366,10 +551,20 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
         return -1;
     }
 
+    prefetch = db_prefetch_acquire(current_database, filename);
+    if (prefetch != NULL) {
+        memcpy(buf, prefetch->data, prefetch->size);
+        db_prefetch_release(prefetch);
+        return 0;
+    }
+
     v1 = true;
+    resolved = NULL;
     if (filename[0] == '@') {
         strcpy(path, filename + 1);
         v1 = false;
+    } else {
+        resolved = db_resolve(current_database, filename);
     }
 
     if (current_database->patches_path != NULL) {
@@ -382,7 +577,7 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
 
         compat_windows_path_to_native(path);
 
-        if (db_get_hash_value(current_database, path, PATH_SEP, &hash_value) != 0 || hash_value == 1) {
+        if (db_resolver_patch_may_exist(current_database, resolved)) {
             v3 = true;
         }
 
@@ -425,14 +620,30 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
         return -1;
     }
 
-    if (v1) {
-        snprintf(path, sizeof(path), "%s%s", current_database->datafile_path, filename);
+    if (resolved != NULL) {
+        if (resolved->de == NULL) {
+            return -1;
+        }
+
+        de = *resolved->de;
+    } else {
+        if (v1) {
+            snprintf(path, sizeof(path), "%s%s", current_database->datafile_path, filename);
+        }
+
+        compat_strupr(path);
+
+        if (db_find_dir_entry(path, &de) == -1) {
+            return -1;
+        }
     }
 
-    compat_strupr(path);
+    if (de.flags == 0) {
+        de.flags = 16;
+    }
 
-    if (db_find_dir_entry(path, &de) == -1) {
-        return -1;
+    if (db_read_mapped_to_buf(current_database, &de, buf, true) == 0) {
+        return 0;
     }
 
     if (current_database->stream == NULL) {
@@ -443,13 +654,9 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
         return -1;
     }
 
-    if (de.flags == 0) {
-        de.flags = 16;
-    }
-
     switch (de.flags & 0xF0) {
     case 16:
-        lzss_decode_to_buf(current_database->stream, buf, de.packed_length);
+        lzss_decode_stream_block(current_database->stream, de.packed_length, buf, de.unpacked_length);
         break;
     case 32:
         if (read_callback != NULL) {
@@ -492,7 +699,7 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
                             read_callback();
                         }
                     } else {
-                        read_count += lzss_decode_to_buf(current_database->stream, buf, v4);
+                        read_count += lzss_decode_stream_block(current_database->stream, v4, buf, end - buf);
                         while (read_count >= read_threshold) {
                             read_count -= read_threshold;
                             read_callback();
@@ -508,7 +715,7 @@ int db_read_to_buf(const char* filename, unsigned char* buf)
                         fread(buf, 1, v4, current_database->stream);
                         buf += v4;
                     } else {
-                        buf += lzss_decode_to_buf(current_database->stream, buf, v4);
+                        buf += lzss_decode_stream_block(current_database->stream, v4, buf, end - buf);
                     }
                 }
             }
@@ -525,13 +732,15 @@ DB_FILE* db_fopen(const char* filename, const char* mode)
     char path[COMPAT_MAX_PATH];
     FILE* stream;
     bool v2;
-    int hash_value;
     int mode_value;
     bool mode_is_text;
     int flags;
     int k;
     dir_entry de;
     unsigned char* buf;
+    DB_PREFETCH_ENTRY* prefetch;
+    DB_FILE* db_stream;
+    DB_RESOLVER_ENTRY* resolved;
 
     if (current_database == NULL) {
         return NULL;
@@ -577,10 +786,32 @@ DB_FILE* db_fopen(const char* filename, const char* mode)
         flags = 2;
     }
 
+    // CE: Serve binary reads of prefetched files from memory. Text mode is
+    // left alone since in-memory streams translate line endings, while
+    // stdio streams (patches) do not on every platform.
+    if (mode_value == 0) {
+        db_prefetch_forget(current_database, filename);
+    } else if (!mode_is_text) {
+        prefetch = db_prefetch_acquire(current_database, filename);
+        if (prefetch != NULL) {
+            db_stream = db_add_fp_rec(NULL, prefetch->data, prefetch->size, flags | 0x10 | 0x8 | DB_FILE_FLAG_BORROWED);
+            if (db_stream == NULL) {
+                db_prefetch_release(prefetch);
+                return NULL;
+            }
+
+            db_stream->prefetch = prefetch;
+            return db_stream;
+        }
+    }
+
     v1 = true;
+    resolved = NULL;
     if (filename[0] == '@') {
         strcpy(path, filename + 1);
         v1 = false;
+    } else if (mode_value != 0) {
+        resolved = db_resolve(current_database, filename);
     }
 
     if (current_database->patches_path != NULL) {
@@ -593,10 +824,12 @@ DB_FILE* db_fopen(const char* filename, const char* mode)
         compat_windows_path_to_native(path);
 
         if (mode_value == 0) {
-            db_add_hash_entry_to_database(current_database, path, PATH_SEP);
+            if (v1) {
+                db_resolver_add_patch(current_database, filename);
+            }
             v2 = true;
         } else {
-            if (db_get_hash_value(current_database, path, PATH_SEP, &hash_value) != 0 || hash_value == 1) {
+            if (db_resolver_patch_may_exist(current_database, resolved)) {
                 v2 = true;
             }
         }
@@ -618,14 +851,49 @@ DB_FILE* db_fopen(const char* filename, const char* mode)
         return NULL;
     }
 
-    if (v1) {
-        snprintf(path, sizeof(path), "%s%s", current_database->datafile_path, filename);
+    if (resolved != NULL) {
+        if (resolved->de == NULL) {
+            return NULL;
+        }
+
+        de = *resolved->de;
+    } else {
+        if (v1) {
+            snprintf(path, sizeof(path), "%s%s", current_database->datafile_path, filename);
+        }
+
+        compat_strupr(path);
+
+        if (db_find_dir_entry(path, &de) == -1) {
+            return NULL;
+        }
     }
 
-    compat_strupr(path);
+    if (de.flags == 0) {
+        de.flags = 16;
+    }
 
-    if (db_find_dir_entry(path, &de) == -1) {
-        return NULL;
+    // CE: With the datafile mapped, stored entries are exposed in place and
+    // compressed ones are decoded without going through `stream`. Chunked
+    // entries (type 64) keep using the regular path, `db_preload_buffer`
+    // takes its chunks from the mapping.
+    switch (de.flags & 0xF0) {
+    case 16:
+        if (db_mapping_contains(current_database, de.offset, de.packed_length)) {
+            buf = (unsigned char*)internal_malloc(de.unpacked_length);
+            if (buf == NULL) {
+                return NULL;
+            }
+
+            lzss_decode_block(current_database->mapping + de.offset, de.packed_length, buf, de.unpacked_length);
+            return db_add_fp_rec(NULL, buf, de.unpacked_length, flags | 0x10 | 0x8);
+        }
+        break;
+    case 32:
+        if (db_mapping_contains(current_database, de.offset, de.unpacked_length)) {
+            return db_add_fp_rec(NULL, current_database->mapping + de.offset, de.unpacked_length, flags | 0x10 | 0x8 | DB_FILE_FLAG_BORROWED);
+        }
+        break;
     }
 
     if (current_database->stream == NULL) {
@@ -636,15 +904,11 @@ DB_FILE* db_fopen(const char* filename, const char* mode)
         return NULL;
     }
 
-    if (de.flags == 0) {
-        de.flags = 16;
-    }
-
     switch (de.flags & 0xF0) {
     case 16:
         buf = (unsigned char*)internal_malloc(de.unpacked_length);
         if (buf != NULL) {
-            lzss_decode_to_buf(current_database->stream, buf, de.packed_length);
+            lzss_decode_stream_block(current_database->stream, de.packed_length, buf, de.unpacked_length);
             return db_add_fp_rec(NULL, buf, de.unpacked_length, flags | 0x10 | 0x8);
         }
         break;
@@ -661,6 +925,22 @@ DB_FILE* db_fopen(const char* filename, const char* mode)
     return NULL;
 }
 
+// CE: Opens read-only binary stream over `size` bytes at `data`. The memory
+// is not copied and must outlive the stream - caller releases it after
+// `db_fclose`.
+DB_FILE* db_fopen_mem(unsigned char* data, int size)
+{
+    if (current_database == NULL) {
+        return NULL;
+    }
+
+    if (data == NULL || size < 0) {
+        return NULL;
+    }
+
+    return db_add_fp_rec(NULL, data, size, 1 | 0x10 | 0x8 | DB_FILE_FLAG_BORROWED);
+}
+
 // 0x4B2664
 int db_fclose(DB_FILE* stream)
 {
@@ -1086,8 +1366,14 @@ int db_fseek(DB_FILE* stream, long offset, int origin)
                 v1 = stream->field_20 + offset - current_offset;
                 if (v1 >= stream->field_1C && v1 < stream->field_1C + 0x4000) {
                     stream->field_20 = v1;
-                    stream->field_10 = current_offset - offset;
+                    // CE: Original code stored `current_offset - offset`
+                    // which is not the number of remaining bytes.
+                    stream->field_10 = stream->field_C - offset;
                     rc = 0;
+                } else if (stream->chunk_offsets != NULL) {
+                    // CE: Jump straight to the chunk instead of decoding
+                    // every chunk in between.
+                    rc = db_seek_chunk(stream, offset);
                 } else {
                     if (offset < current_offset) {
                         db_rewind(stream);
@@ -1112,6 +1398,9 @@ int db_fseek(DB_FILE* stream, long offset, int origin)
                     }
 
                     stream->field_10 = stream->field_C - offset;
+
+                    // CE: Original code reported failure here.
+                    rc = 0;
                 }
             }
         }
@@ -1160,6 +1449,7 @@ void db_rewind(DB_FILE* stream)
                 stream->field_10 = stream->field_C;
                 stream->field_20 = stream->field_1C + 16384;
                 stream->field_18 = stream->field_14;
+                stream->chunk_index = 0;
                 db_preload_buffer(stream);
                 break;
             }
@@ -1213,41 +1503,15 @@ int db_freadByte(DB_FILE* stream, unsigned char* c)
 // 0x4B07C0
 int db_freadShort(DB_FILE* stream, unsigned short* s)
 {
-    unsigned char high;
-    unsigned char low;
-
-    // NOTE: Uninline.
-    if (db_freadByte(stream, &high) == -1) {
-        return -1;
-    }
-
-    // NOTE: Uninline.
-    if (db_freadByte(stream, &low) == -1) {
-        return -1;
-    }
-
-    *s = (high << 8) | low;
-
-    return 0;
+    // CE: Read both bytes at once.
+    return db_freadShortCount(stream, s, 1);
 }
 
 // 0x4B0820
 int db_freadInt(DB_FILE* stream, int* i)
 {
-    unsigned short high;
-    unsigned short low;
-
-    if (db_freadShort(stream, &high) == -1) {
-        return -1;
-    }
-
-    if (db_freadShort(stream, &low) == -1) {
-        return -1;
-    }
-
-    *i = (high << 16) | low;
-
-    return 0;
+    // CE: Read all four bytes at once.
+    return db_freadIntCount(stream, i, 1);
 }
 
 // 0x4B0820
@@ -1292,31 +1556,15 @@ int db_fwriteByte(DB_FILE* stream, unsigned char c)
 // 0x4B08A0
 int db_fwriteShort(DB_FILE* stream, unsigned short s)
 {
-    // NOTE: Uninline.
-    if (db_fwriteByte(stream, s >> 8) == -1) {
-        return -1;
-    }
-
-    // NOTE: Uninline.
-    if (db_fwriteByte(stream, s & 0xFF) == -1) {
-        return -1;
-    }
-
-    return 0;
+    // CE: Write both bytes at once.
+    return db_fwriteShortCount(stream, &s, 1);
 }
 
 // 0x4B08EC
 int db_fwriteInt(DB_FILE* stream, int i)
 {
-    if (db_fwriteShort(stream, i >> 16) == -1) {
-        return -1;
-    }
-
-    if (db_fwriteShort(stream, i & 0xFFFF) == -1) {
-        return -1;
-    }
-
-    return 0;
+    // CE: Write all four bytes at once.
+    return db_fwriteIntCount(stream, &i, 1);
 }
 
 // 0x4C6244
@@ -1336,54 +1584,33 @@ int db_fwriteFloat(DB_FILE* stream, float q)
 // 0x4B09D4
 int db_freadByteCount(DB_FILE* stream, unsigned char* c, int count)
 {
-    int index;
-    unsigned char value;
-
-    for (index = 0; index < count; index++) {
-        // NOTE: Uninline.
-        if (db_freadByte(stream, &value) == -1) {
-            return -1;
-        }
-
-        c[index] = value;
-    }
-
-    return 0;
+    // CE: Read whole array at once.
+    return db_fread_bytes(stream, c, count);
 }
 
 // 0x4B0A14
 int db_freadShortCount(DB_FILE* stream, unsigned short* s, int count)
 {
-    int index;
-    unsigned short value;
-
-    for (index = 0; index < count; index++) {
-        // NOTE: Uninline.
-        if (db_freadShort(stream, &value) == -1) {
-            return -1;
-        }
-
-        s[index] = value;
+    // CE: Read whole array at once and convert it in place.
+    if (db_fread_bytes(stream, (unsigned char*)s, sizeof(*s) * count) == -1) {
+        return -1;
     }
 
+    db_decode_shorts(s, count);
+
     return 0;
 }
 
 // 0x4B0AB0
 int db_freadIntCount(DB_FILE* stream, int* i, int count)
 {
-    int index;
-    int value;
-
-    for (index = 0; index < count; index++) {
-        // NOTE: Uninline.
-        if (db_freadInt(stream, &value) == -1) {
-            return -1;
-        }
-
-        i[index] = value;
+    // CE: Read whole array at once and convert it in place.
+    if (db_fread_bytes(stream, (unsigned char*)i, sizeof(*i) * count) == -1) {
+        return -1;
     }
 
+    db_decode_ints(i, count);
+
     return 0;
 }
 
@@ -1426,28 +1653,30 @@ int db_freadFloatCount(DB_FILE* stream, float* q, int count)
 // 0x4B0B80
 int db_fwriteByteCount(DB_FILE* stream, unsigned char* c, int count)
 {
-    int index;
-
-    for (index = 0; index < count; index++) {
-        // NOTE: Uninline.
-        if (db_fwriteByte(stream, c[index]) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    // CE: Write whole array at once.
+    return db_fwrite_bytes(stream, c, count);
 }
 
 // 0x4B0BC8
 int db_fwriteShortCount(DB_FILE* stream, unsigned short* s, int count)
 {
-    int index;
+    // CE: Encode into big-endian in batches instead of writing every byte
+    // separately.
+    unsigned char buf[512];
+
+    while (count > 0) {
+        int batch = std::min(count, (int)(sizeof(buf) / 2));
+        for (int index = 0; index < batch; index++) {
+            buf[index * 2] = (s[index] >> 8) & 0xFF;
+            buf[index * 2 + 1] = s[index] & 0xFF;
+        }
 
-    for (index = 0; index < count; index++) {
-        // NOTE: Uninline.
-        if (db_fwriteShort(stream, s[index]) == -1) {
+        if (db_fwrite_bytes(stream, buf, batch * 2) == -1) {
             return -1;
         }
+
+        s += batch;
+        count -= batch;
     }
 
     return 0;
@@ -1456,13 +1685,26 @@ int db_fwriteShortCount(DB_FILE* stream, unsigned short* s, int count)
 // 0x4B0C3C
 int db_fwriteIntCount(DB_FILE* stream, int* i, int count)
 {
-    int index;
+    // CE: Encode into big-endian in batches instead of writing every byte
+    // separately.
+    unsigned char buf[1024];
+
+    while (count > 0) {
+        int batch = std::min(count, (int)(sizeof(buf) / 4));
+        for (int index = 0; index < batch; index++) {
+            unsigned int value = (unsigned int)i[index];
+            buf[index * 4] = (value >> 24) & 0xFF;
+            buf[index * 4 + 1] = (value >> 16) & 0xFF;
+            buf[index * 4 + 2] = (value >> 8) & 0xFF;
+            buf[index * 4 + 3] = value & 0xFF;
+        }
 
-    for (index = 0; index < count; index++) {
-        // NOTE: Uninline.
-        if (db_fwriteInt(stream, i[index]) == -1) {
+        if (db_fwrite_bytes(stream, buf, batch * 4) == -1) {
             return -1;
         }
+
+        i += batch;
+        count -= batch;
     }
 
     return 0;
@@ -2027,6 +2269,10 @@ static int db_init_database(DB_DATABASE* database, const char* datafile, const c
         database->datafile_path[v2 + 1] = '\0';
     }
 
+    if (mmap_is_on) {
+        db_map_database(database);
+    }
+
     return 0;
 }
 
@@ -2039,6 +2285,8 @@ static void db_exit_database(DB_DATABASE* database)
         return;
     }
 
+    db_unmap_database(database);
+
     if (database->stream != NULL) {
         fclose(database->stream);
         database->stream = NULL;
@@ -2065,134 +2313,854 @@ static void db_exit_database(DB_DATABASE* database)
     }
 }
 
-// 0x4B1E70
-static int db_init_patches(DB_DATABASE* database, const char* path)
+// Maps the whole datafile read-only. Failure is not an error, the database
+// just keeps reading through `stream`.
+static void db_map_database(DB_DATABASE* database)
 {
-    size_t path_len;
+#if defined(_WIN32)
+    HANDLE file;
+    LARGE_INTEGER size;
+    HANDLE handle;
+    void* view;
 
-    if (database == NULL) {
-        return -1;
+    file = (HANDLE)_get_osfhandle(_fileno(database->stream));
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
     }
 
-    if (path == NULL) {
-        database->patches_path = NULL;
-        return 0;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        return;
     }
 
-    path_len = strlen(path);
-    if (path_len == 0) {
-        database->patches_path = empty_patches_path;
-        return 0;
+    handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (handle == NULL) {
+        return;
     }
 
-    database->patches_path = (char*)internal_malloc(path_len + 2);
-    if (database->patches_path == NULL) {
-        return -1;
+    view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL) {
+        CloseHandle(handle);
+        return;
     }
 
-    database->should_free_patches_path = true;
-    strcpy(database->patches_path, path);
+    database->mapping = (unsigned char*)view;
+    database->mapping_size = (size_t)size.QuadPart;
+    database->mapping_handle = handle;
+#else
+    struct stat st;
+    void* view;
 
-    if (database->patches_path[path_len - 1] != '\\') {
-        database->patches_path[path_len] = PATH_SEP;
-        database->patches_path[path_len + 1] = '\0';
+    if (fstat(fileno(database->stream), &st) != 0 || st.st_size == 0) {
+        return;
     }
 
-    return 0;
+    view = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(database->stream), 0);
+    if (view == MAP_FAILED) {
+        return;
+    }
+
+    database->mapping = (unsigned char*)view;
+    database->mapping_size = (size_t)st.st_size;
+#endif
 }
 
-// 0x4B1F10
-static void db_exit_patches(DB_DATABASE* database)
+static void db_unmap_database(DB_DATABASE* database)
 {
-    if (database == NULL) {
+    if (database->mapping == NULL) {
         return;
     }
 
-    if (database->patches_path != NULL) {
-        if (database->should_free_patches_path == true) {
-            internal_free(database->patches_path);
-        }
-    }
+#if defined(_WIN32)
+    UnmapViewOfFile(database->mapping);
+    CloseHandle(database->mapping_handle);
+    database->mapping_handle = NULL;
+#else
+    munmap(database->mapping, database->mapping_size);
+#endif
 
-    database->patches_path = empty_patches_path;
-    database->should_free_patches_path = false;
+    database->mapping = NULL;
+    database->mapping_size = 0;
 }
 
-// 0x4B1F3C
-static int db_init_hash_table(DB_DATABASE* database)
+// Returns `true` if `length` bytes at `offset` can be read from the mapping.
+static bool db_mapping_contains(DB_DATABASE* database, int offset, int length)
 {
-    if (!hash_is_on) {
+    if (database->mapping == NULL) {
+        return false;
+    }
+
+    if (offset < 0 || length < 0) {
+        return false;
+    }
+
+    return (size_t)offset <= database->mapping_size
+        && (size_t)length <= database->mapping_size - (size_t)offset;
+}
+
+// Mapped counterpart of the datafile part of `db_read_to_buf`. Returns -1 if
+// the entry cannot be served from the mapping, the caller then falls back to
+// reading `stream`. Read callback is only run when `notify` is set (it must
+// not be called from prefetch workers).
+static int db_read_mapped_to_buf(DB_DATABASE* database, dir_entry* de, unsigned char* buf, bool notify)
+{
+    unsigned char* src;
+    unsigned char* end;
+    int remaining_size;
+    int chunk_size;
+    int bytes_read;
+    unsigned short v1;
+
+    switch (de->flags & 0xF0) {
+    case 16:
+        if (!db_mapping_contains(database, de->offset, de->packed_length)) {
+            return -1;
+        }
+
+        lzss_decode_block(database->mapping + de->offset, de->packed_length, buf, de->unpacked_length);
+        return 0;
+    case 32:
+        if (!db_mapping_contains(database, de->offset, de->unpacked_length)) {
+            return -1;
+        }
+
+        src = database->mapping + de->offset;
+        if (notify && read_callback != NULL) {
+            remaining_size = de->unpacked_length;
+            chunk_size = read_threshold - read_count;
+
+            while (remaining_size >= chunk_size) {
+                memcpy(buf, src, chunk_size);
+                buf += chunk_size;
+                src += chunk_size;
+                remaining_size -= chunk_size;
+
+                read_count = 0;
+                read_callback();
+
+                chunk_size = read_threshold;
+            }
+
+            if (remaining_size != 0) {
+                memcpy(buf, src, remaining_size);
+                read_count += remaining_size;
+            }
+        } else {
+            memcpy(buf, src, de->unpacked_length);
+        }
+        return 0;
+    case 64:
+        if (!db_mapping_contains(database, de->offset, 0)) {
+            return -1;
+        }
+
+        src = database->mapping + de->offset;
+        end = buf + de->unpacked_length;
+        while (buf < end) {
+            if (!db_mapping_contains(database, src - database->mapping, 2)) {
+                return -1;
+            }
+
+            v1 = (src[0] << 8) | src[1];
+            src += 2;
+
+            if (!db_mapping_contains(database, src - database->mapping, v1 & ~0x8000)) {
+                return -1;
+            }
+
+            if ((v1 & 0x8000) != 0) {
+                v1 &= ~0x8000;
+                memcpy(buf, src, v1);
+                bytes_read = v1;
+            } else {
+                bytes_read = lzss_decode_block(src, v1, buf, end - buf);
+            }
+
+            src += v1;
+            buf += bytes_read;
+
+            if (notify && read_callback != NULL) {
+                read_count += bytes_read;
+                while (read_count >= read_threshold) {
+                    read_count -= read_threshold;
+                    read_callback();
+                }
+            }
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+// Queues `filename` from current database to be read and decompressed by a
+// background worker. Subsequent binary `db_fopen` and `db_read_to_buf` of the
+// same name are served from memory, waiting for the worker only if the file
+// is not ready yet. Prefetched data is kept until `db_prefetch_clear`.
+int db_prefetch(const char* filename)
+{
+    char path[COMPAT_MAX_PATH];
+    bool v1;
+    char* patch_path;
+    dir_entry de;
+    bool has_dir_entry;
+    DB_PREFETCH_ENTRY* entry;
+    unsigned int key;
+    int count;
+    DB_RESOLVER_ENTRY* resolved;
+
+    if (current_database == NULL || filename == NULL) {
         return -1;
     }
 
-    if (database == NULL) {
+    if (db_prefetch_find(current_database, filename) != NULL) {
+        return 0;
+    }
+
+    v1 = true;
+    resolved = NULL;
+    if (filename[0] == '@') {
+        strcpy(path, filename + 1);
+        v1 = false;
+    } else {
+        resolved = db_resolve(current_database, filename);
+    }
+
+    patch_path = NULL;
+    if (current_database->patches_path != NULL) {
+        if (v1) {
+            snprintf(path, sizeof(path), "%s%s", current_database->patches_path, filename);
+        }
+
+        compat_windows_path_to_native(path);
+
+        if (db_resolver_patch_may_exist(current_database, resolved)) {
+            patch_path = strdup(path);
+            if (patch_path == NULL) {
+                return -1;
+            }
+        }
+    }
+
+    has_dir_entry = false;
+    if (resolved != NULL) {
+        if (resolved->de != NULL) {
+            de = *resolved->de;
+            if (de.flags == 0) {
+                de.flags = 16;
+            }
+            has_dir_entry = true;
+        }
+    } else if (current_database->datafile != NULL) {
+        if (v1) {
+            snprintf(path, sizeof(path), "%s%s", current_database->datafile_path, filename);
+        }
+
+        compat_strupr(path);
+
+        if (db_find_dir_entry(path, &de) == 0) {
+            if (de.flags == 0) {
+                de.flags = 16;
+            }
+            has_dir_entry = true;
+        }
+    }
+
+    if (patch_path == NULL && !has_dir_entry) {
+        return -1;
+    }
+
+    entry = (DB_PREFETCH_ENTRY*)calloc(1, sizeof(*entry));
+    if (entry == NULL) {
+        free(patch_path);
         return -1;
     }
 
-    database->hash_table = (unsigned char*)internal_malloc(DB_HASH_TABLE_SIZE);
-    if (database->hash_table == NULL) {
+    entry->filename = strdup(filename);
+    if (entry->filename == NULL) {
+        free(patch_path);
+        free(entry);
         return -1;
     }
 
-    return db_reset_hash_table(database);
+    entry->database = current_database;
+    entry->patch_path = patch_path;
+    entry->has_dir_entry = has_dir_entry;
+    if (has_dir_entry) {
+        entry->de = de;
+    }
+    entry->state = DB_PREFETCH_STATE_QUEUED;
+
+    key = db_prefetch_hash(filename);
+
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+    if (prefetch_workers_length == 0) {
+        prefetch_stop = false;
+
+        count = (int)std::thread::hardware_concurrency() - 1;
+        if (count < 1) {
+            count = 1;
+        } else if (count > DB_PREFETCH_MAX_WORKERS) {
+            count = DB_PREFETCH_MAX_WORKERS;
+        }
+
+        while (prefetch_workers_length < count) {
+            prefetch_workers[prefetch_workers_length++] = new std::thread(db_prefetch_worker);
+        }
+    }
+
+    entry->next = prefetch_table[key];
+    prefetch_table[key] = entry;
+    prefetch_entries_length++;
+
+    if (prefetch_queue_tail != NULL) {
+        prefetch_queue_tail->next_job = entry;
+    } else {
+        prefetch_queue_head = entry;
+    }
+    prefetch_queue_tail = entry;
+
+    prefetch_work_cond.notify_one();
+
+    return 0;
 }
 
-// 0x4B1F90
-void db_enable_hash_table()
+// Drops all prefetched data. Jobs that have not been started are cancelled,
+// running ones are waited for.
+void db_prefetch_clear()
 {
-    hash_is_on = true;
+    int index;
+    DB_PREFETCH_ENTRY* entry;
+    DB_PREFETCH_ENTRY* next;
+
+    if (prefetch_entries_length == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(prefetch_mutex);
+
+    while (prefetch_queue_head != NULL) {
+        entry = prefetch_queue_head;
+        prefetch_queue_head = entry->next_job;
+        entry->next_job = NULL;
+
+        if (entry->state == DB_PREFETCH_STATE_QUEUED) {
+            entry->state = DB_PREFETCH_STATE_FAILED;
+        }
+    }
+    prefetch_queue_tail = NULL;
+
+    prefetch_done_cond.wait(lock, []() { return prefetch_in_flight == 0; });
+
+    for (index = 0; index < DB_PREFETCH_TABLE_SIZE; index++) {
+        entry = prefetch_table[index];
+        while (entry != NULL) {
+            next = entry->next;
+            entry->next = NULL;
+
+            if (entry->refs != 0) {
+                entry->orphaned = true;
+            } else {
+                db_prefetch_free_entry(entry);
+            }
+
+            entry = next;
+        }
+        prefetch_table[index] = NULL;
+    }
+
+    prefetch_entries_length = 0;
 }
 
-// 0x4B1F9C
-static int db_reset_hash_table(DB_DATABASE* database)
+static unsigned int db_prefetch_hash(const char* filename)
 {
-    if (!hash_is_on) {
+    unsigned int hash = 0;
+
+    while (*filename != '\0') {
+        hash = hash * 31 + (unsigned char)tolower((unsigned char)*filename);
+        filename++;
+    }
+
+    return hash % DB_PREFETCH_TABLE_SIZE;
+}
+
+// NOTE: Caller must hold `prefetch_mutex` unless it is the main thread only
+// reading the table.
+static DB_PREFETCH_ENTRY* db_prefetch_find(DB_DATABASE* database, const char* filename)
+{
+    DB_PREFETCH_ENTRY* entry;
+
+    if (prefetch_entries_length == 0) {
+        return NULL;
+    }
+
+    entry = prefetch_table[db_prefetch_hash(filename)];
+    while (entry != NULL) {
+        if (entry->database == database && compat_stricmp(entry->filename, filename) == 0) {
+            return entry;
+        }
+        entry = entry->next;
+    }
+
+    return NULL;
+}
+
+// Returns prefetched contents of `filename`, waiting for them if needed, or
+// `NULL` if the file was not prefetched or could not be read. The entry must
+// be released with `db_prefetch_release`.
+static DB_PREFETCH_ENTRY* db_prefetch_acquire(DB_DATABASE* database, const char* filename)
+{
+    DB_PREFETCH_ENTRY* entry;
+    int rc;
+
+    if (prefetch_entries_length == 0) {
+        return NULL;
+    }
+
+    std::unique_lock<std::mutex> lock(prefetch_mutex);
+
+    entry = db_prefetch_find(database, filename);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    // Workers have not reached this one yet - load it right away rather than
+    // wait for the rest of the queue. Workers skip jobs that are no longer
+    // queued.
+    if (entry->state == DB_PREFETCH_STATE_QUEUED) {
+        entry->state = DB_PREFETCH_STATE_LOADING;
+        prefetch_in_flight++;
+
+        lock.unlock();
+        rc = db_prefetch_load(entry);
+        lock.lock();
+
+        entry->state = rc == 0 ? DB_PREFETCH_STATE_READY : DB_PREFETCH_STATE_FAILED;
+        prefetch_in_flight--;
+        prefetch_done_cond.notify_all();
+    } else {
+        prefetch_done_cond.wait(lock, [entry]() {
+            return entry->state == DB_PREFETCH_STATE_READY || entry->state == DB_PREFETCH_STATE_FAILED;
+        });
+    }
+
+    if (entry->state != DB_PREFETCH_STATE_READY) {
+        return NULL;
+    }
+
+    entry->refs++;
+
+    return entry;
+}
+
+static void db_prefetch_release(DB_PREFETCH_ENTRY* entry)
+{
+    std::lock_guard<std::mutex> lock(prefetch_mutex);
+
+    entry->refs--;
+    if (entry->refs == 0 && entry->orphaned) {
+        db_prefetch_free_entry(entry);
+    }
+}
+
+// Removes prefetched copy of `filename` which is about to be overwritten.
+static void db_prefetch_forget(DB_DATABASE* database, const char* filename)
+{
+    DB_PREFETCH_ENTRY* entry;
+    DB_PREFETCH_ENTRY** link;
+
+    if (prefetch_entries_length == 0) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(prefetch_mutex);
+
+    entry = db_prefetch_find(database, filename);
+    if (entry == NULL) {
+        return;
+    }
+
+    prefetch_done_cond.wait(lock, [entry]() {
+        return entry->state != DB_PREFETCH_STATE_LOADING;
+    });
+
+    // Let the worker drop it if it is still in the queue.
+    if (entry->state == DB_PREFETCH_STATE_QUEUED) {
+        entry->state = DB_PREFETCH_STATE_FAILED;
+        return;
+    }
+
+    link = &(prefetch_table[db_prefetch_hash(filename)]);
+    while (*link != entry) {
+        link = &((*link)->next);
+    }
+    *link = entry->next;
+    entry->next = NULL;
+    prefetch_entries_length--;
+
+    if (entry->refs != 0) {
+        entry->orphaned = true;
+    } else {
+        db_prefetch_free_entry(entry);
+    }
+}
+
+static void db_prefetch_free_entry(DB_PREFETCH_ENTRY* entry)
+{
+    free(entry->data);
+    free(entry->patch_path);
+    free(entry->filename);
+    free(entry);
+}
+
+// Reads entry contents, runs without `prefetch_mutex`.
+static int db_prefetch_load(DB_PREFETCH_ENTRY* entry)
+{
+    FILE* stream;
+    long size;
+    unsigned char* data;
+
+    if (entry->patch_path != NULL) {
+        stream = compat_fopen(entry->patch_path, "rb");
+        if (stream != NULL) {
+            size = getFileSize(stream);
+            data = (unsigned char*)malloc(size > 0 ? size : 1);
+            if (data == NULL || fread(data, 1, size, stream) != (size_t)size) {
+                free(data);
+                fclose(stream);
+                return -1;
+            }
+
+            fclose(stream);
+
+            entry->data = data;
+            entry->size = (int)size;
+            return 0;
+        }
+    }
+
+    if (!entry->has_dir_entry) {
+        return -1;
+    }
+
+    data = (unsigned char*)malloc(entry->de.unpacked_length > 0 ? entry->de.unpacked_length : 1);
+    if (data == NULL) {
+        return -1;
+    }
+
+    if (db_prefetch_read_entry(entry->database, &(entry->de), data) != 0) {
+        free(data);
+        return -1;
+    }
+
+    entry->data = data;
+    entry->size = entry->de.unpacked_length;
+    return 0;
+}
+
+// Same as datafile part of `db_read_to_buf`, but never touches shared
+// `stream` of the database (it uses the mapping or a private handle) and
+// never runs read callback.
+static int db_prefetch_read_entry(DB_DATABASE* database, dir_entry* de, unsigned char* buf)
+{
+    FILE* stream;
+    unsigned char* end;
+    unsigned short v1;
+    int rc;
+
+    if (db_read_mapped_to_buf(database, de, buf, false) == 0) {
+        return 0;
+    }
+
+    stream = compat_fopen(database->datafile, "rb");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    if (fseek(stream, de->offset, SEEK_SET) != 0) {
+        fclose(stream);
         return -1;
     }
 
+    rc = 0;
+    switch (de->flags & 0xF0) {
+    case 16:
+        lzss_decode_stream_block(stream, de->packed_length, buf, de->unpacked_length);
+        break;
+    case 32:
+        if (fread(buf, 1, de->unpacked_length, stream) != (size_t)de->unpacked_length) {
+            rc = -1;
+        }
+        break;
+    case 64:
+        end = buf + de->unpacked_length;
+        while (buf < end) {
+            if (fread_short(stream, &v1) != 0) {
+                rc = -1;
+                break;
+            }
+
+            if ((v1 & 0x8000) != 0) {
+                v1 &= ~0x8000;
+                if (fread(buf, 1, v1, stream) != v1) {
+                    rc = -1;
+                    break;
+                }
+                buf += v1;
+            } else {
+                buf += lzss_decode_stream_block(stream, v1, buf, end - buf);
+            }
+        }
+        break;
+    default:
+        rc = -1;
+        break;
+    }
+
+    fclose(stream);
+
+    return rc;
+}
+
+static void db_prefetch_worker()
+{
+    DB_PREFETCH_ENTRY* entry;
+    int rc;
+
+    std::unique_lock<std::mutex> lock(prefetch_mutex);
+
+    while (true) {
+        prefetch_work_cond.wait(lock, []() { return prefetch_stop || prefetch_queue_head != NULL; });
+
+        if (prefetch_stop) {
+            break;
+        }
+
+        entry = prefetch_queue_head;
+        prefetch_queue_head = entry->next_job;
+        if (prefetch_queue_head == NULL) {
+            prefetch_queue_tail = NULL;
+        }
+        entry->next_job = NULL;
+
+        // Taken over by the main thread or cancelled.
+        if (entry->state != DB_PREFETCH_STATE_QUEUED) {
+            continue;
+        }
+
+        entry->state = DB_PREFETCH_STATE_LOADING;
+        prefetch_in_flight++;
+
+        lock.unlock();
+        rc = db_prefetch_load(entry);
+        lock.lock();
+
+        entry->state = rc == 0 ? DB_PREFETCH_STATE_READY : DB_PREFETCH_STATE_FAILED;
+        prefetch_in_flight--;
+        prefetch_done_cond.notify_all();
+    }
+}
+
+static void db_prefetch_exit()
+{
+    int index;
+
+    db_prefetch_clear();
+
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex);
+        prefetch_stop = true;
+    }
+    prefetch_work_cond.notify_all();
+
+    for (index = 0; index < prefetch_workers_length; index++) {
+        prefetch_workers[index]->join();
+        delete prefetch_workers[index];
+        prefetch_workers[index] = NULL;
+    }
+
+    prefetch_workers_length = 0;
+}
+
+// 0x4B1E70
+static int db_init_patches(DB_DATABASE* database, const char* path)
+{
+    size_t path_len;
+
     if (database == NULL) {
         return -1;
     }
 
+    if (path == NULL) {
+        database->patches_path = NULL;
+        return 0;
+    }
+
+    path_len = strlen(path);
+    if (path_len == 0) {
+        database->patches_path = empty_patches_path;
+        return 0;
+    }
+
+    database->patches_path = (char*)internal_malloc(path_len + 2);
     if (database->patches_path == NULL) {
         return -1;
     }
 
-    if (database->hash_table == NULL) {
-        database->hash_table = (unsigned char*)internal_malloc(DB_HASH_TABLE_SIZE);
-        if (database->hash_table == NULL) {
+    database->should_free_patches_path = true;
+    strcpy(database->patches_path, path);
+
+    if (database->patches_path[path_len - 1] != '\\') {
+        database->patches_path[path_len] = PATH_SEP;
+        database->patches_path[path_len + 1] = '\0';
+    }
+
+    return 0;
+}
+
+// 0x4B1F10
+static void db_exit_patches(DB_DATABASE* database)
+{
+    if (database == NULL) {
+        return;
+    }
+
+    if (database->patches_path != NULL) {
+        if (database->should_free_patches_path == true) {
+            internal_free(database->patches_path);
+        }
+    }
+
+    database->patches_path = empty_patches_path;
+    database->should_free_patches_path = false;
+}
+
+// CE: Builds path resolver of the database - every datafile entry plus
+// every file in patches directory (when hashing is enabled), keyed by
+// normalized path. Replaces original patches hash table.
+static int db_init_resolver(DB_DATABASE* database)
+{
+    char key[COMPAT_MAX_PATH];
+    const char* prefix;
+    char* dir_name;
+    int dir_index;
+    int entry_index;
+    assoc_array* dir;
+    DB_RESOLVER_ENTRY* entry;
+
+    if (database == NULL) {
+        return -1;
+    }
+
+    // Keys are relative to both roots, datafile keys could only be shared
+    // with patches when datafile is not nested.
+    if (database->datafile != NULL) {
+        prefix = database->datafile_path;
+        if (prefix[0] == '.' && prefix[1] == '\\') {
+            prefix += 2;
+        }
+
+        if (*prefix != '\0') {
             return -1;
         }
     }
 
-    memset(database->hash_table, 0, DB_HASH_TABLE_SIZE);
+    database->resolver = (DB_RESOLVER_ENTRY*)internal_malloc(sizeof(*database->resolver) * DB_RESOLVER_INITIAL_CAPACITY);
+    if (database->resolver == NULL) {
+        return -1;
+    }
+
+    memset(database->resolver, 0, sizeof(*database->resolver) * DB_RESOLVER_INITIAL_CAPACITY);
+    database->resolver_capacity = DB_RESOLVER_INITIAL_CAPACITY;
+    database->resolver_length = 0;
+    database->resolver_names = NULL;
+    database->resolver_written_dirs = 0;
+    database->resolver_patches_scanned = false;
+
+    if (database->datafile != NULL) {
+        for (dir_index = 0; dir_index < database->root.size; dir_index++) {
+            dir = &(database->entries[dir_index]);
+            dir_name = database->root.list[dir_index].name;
+
+            for (entry_index = 0; entry_index < dir->size; entry_index++) {
+                // Same as `db_find_dir_entry` - paths without directory are
+                // looked up in the first one, everything else by directory
+                // name.
+                if (dir_index == 0) {
+                    if (!db_resolver_normalize(dir->list[entry_index].name, key, sizeof(key))) {
+                        continue;
+                    }
+
+                    entry = db_resolver_find(database, key, true);
+                    if (entry == NULL) {
+                        return -1;
+                    }
+
+                    entry->de = (dir_entry*)dir->list[entry_index].data;
+                }
+
+                if (strcmp(dir_name, ".") != 0) {
+                    snprintf(key, sizeof(key), "%s\\%s", dir_name, dir->list[entry_index].name);
+                    if (!db_resolver_normalize(key, key, sizeof(key))) {
+                        continue;
+                    }
 
-    return db_fill_hash_table(database, database->patches_path);
+                    entry = db_resolver_find(database, key, true);
+                    if (entry == NULL) {
+                        return -1;
+                    }
+
+                    entry->de = (dir_entry*)dir->list[entry_index].data;
+                }
+            }
+        }
+    }
+
+    return db_reset_resolver_patches(database);
 }
 
-// NOTE: Originally not static, but that would require exposing `DB_DATABASE`
-// which is most likely considered implementation detail.
-//
-// 0x4B2028
-static int db_fill_hash_table(DB_DATABASE* database, const char* path)
+// CE: Forgets what is known about patches directory and scans it again.
+static int db_reset_resolver_patches(DB_DATABASE* database)
 {
-    char pattern[COMPAT_MAX_PATH];
-    DB_FIND_DATA find_data;
-    bool is_directory;
-    char* filename;
+    int index;
 
-    if (!hash_is_on) {
+    if (database->resolver == NULL) {
         return -1;
     }
 
-    if (database == NULL) {
-        return -1;
+    for (index = 0; index < database->resolver_capacity; index++) {
+        database->resolver[index].flags &= ~(DB_RESOLVER_PATCH | DB_RESOLVER_WRITTEN_DIR);
     }
 
-    if (database->hash_table == NULL) {
+    database->resolver_written_dirs = 0;
+    database->resolver_patches_scanned = false;
+
+    if (!hash_is_on || database->patches_path == NULL) {
+        return 0;
+    }
+
+    if (db_scan_resolver_patches(database, database->patches_path, "") != 0) {
         return -1;
     }
 
+    database->resolver_patches_scanned = true;
+
+    return 0;
+}
+
+// CE: Walks patches directory the same way original `db_fill_hash_table`
+// did. `key_prefix` is normalized path of `path` relative to patches
+// directory (with trailing separator).
+static int db_scan_resolver_patches(DB_DATABASE* database, const char* path, const char* key_prefix)
+{
+    char pattern[COMPAT_MAX_PATH];
+    char key[COMPAT_MAX_PATH];
+    DB_FIND_DATA find_data;
+    bool is_directory;
+    char* filename;
+    DB_RESOLVER_ENTRY* entry;
+    int rc;
+
 #if defined(_WIN32)
     snprintf(pattern, sizeof(pattern), "%s%s", path, "*.*");
 #else
@@ -2200,6 +3168,7 @@ static int db_fill_hash_table(DB_DATABASE* database, const char* path)
 #endif
     compat_windows_path_to_native(pattern);
 
+    rc = 0;
     if (db_findfirst(pattern, &find_data) != -1) {
         do {
             is_directory = fileFindIsDirectory(&find_data);
@@ -2208,19 +3177,46 @@ static int db_fill_hash_table(DB_DATABASE* database, const char* path)
             if (is_directory) {
                 if (strcmp(filename, ".") != 0 && strcmp(filename, "..") != 0) {
                     snprintf(pattern, sizeof(pattern), "%s%s%c", path, filename, PATH_SEP);
-                    db_fill_hash_table(database, pattern);
+                    snprintf(key, sizeof(key), "%s%s\\", key_prefix, filename);
+                    compat_strupr(key);
+                    if (db_scan_resolver_patches(database, pattern, key) != 0) {
+                        rc = -1;
+                    }
                 }
             } else {
-                db_add_hash_entry_to_database(database, filename, PATH_SEP);
+                snprintf(key, sizeof(key), "%s%s", key_prefix, filename);
+                if (db_resolver_normalize(key, key, sizeof(key))) {
+                    entry = db_resolver_find(database, key, true);
+                    if (entry == NULL) {
+                        rc = -1;
+                    } else {
+                        entry->flags |= DB_RESOLVER_PATCH;
+                    }
+                }
             }
-        } while (db_findnext(&find_data) != -1);
+        } while (rc == 0 && db_findnext(&find_data) != -1);
 
         db_findclose(&find_data);
     }
 
-    return 0;
+    return rc;
+}
+
+// 0x4B1F90
+void db_enable_hash_table()
+{
+    hash_is_on = true;
+}
+
+// Datafiles opened after this call are memory-mapped (when the platform
+// allows it) and read without going through stdio.
+void db_enable_mmap()
+{
+    mmap_is_on = true;
 }
 
+// CE: Rescans patches directories of every database.
+//
 // 0x4B2154
 int db_reset_hash_tables()
 {
@@ -2232,16 +3228,25 @@ int db_reset_hash_tables()
 
     for (index = 0; index < DB_DATABASE_LIST_CAPACITY; index++) {
         if (database_list[index] != NULL) {
-            db_reset_hash_table(database_list[index]);
+            db_reset_resolver_patches(database_list[index]);
         }
     }
 
     return 0;
 }
 
+// CE: Tells current database that `path` was created in its patches
+// directory. `path` can be relative to patches directory or include it.
+//
+// NOTE: Both separators are recognized, `sep` is ignored.
+//
 // 0x4B218C
 int db_add_hash_entry(const char* path, int sep)
 {
+    char key[COMPAT_MAX_PATH];
+    char prefix[COMPAT_MAX_PATH];
+    size_t prefix_length;
+
     if (!hash_is_on) {
         return -1;
     }
@@ -2250,7 +3255,7 @@ int db_add_hash_entry(const char* path, int sep)
         return -1;
     }
 
-    if (current_database->hash_table == NULL) {
+    if (current_database->resolver == NULL) {
         return -1;
     }
 
@@ -2258,131 +3263,341 @@ int db_add_hash_entry(const char* path, int sep)
         return -1;
     }
 
-    return db_add_hash_entry_to_database(current_database, path, sep);
+    if (current_database->patches_path != NULL && current_database->patches_path[0] != '\0') {
+        snprintf(prefix, sizeof(prefix), "%s", current_database->patches_path);
+        compat_strupr(prefix);
+
+        prefix_length = strlen(prefix);
+        for (size_t index = 0; index < prefix_length; index++) {
+            if (prefix[index] == '/') {
+                prefix[index] = '\\';
+            }
+        }
+
+        snprintf(key, sizeof(key), "%s", path);
+        compat_strupr(key);
+        for (size_t index = 0; key[index] != '\0'; index++) {
+            if (key[index] == '/') {
+                key[index] = '\\';
+            }
+        }
+
+        if (strncmp(key, prefix, prefix_length) == 0) {
+            path += prefix_length;
+        }
+    }
+
+    return db_resolver_add_patch(current_database, path);
 }
 
-// 0x4B21E0
-static int db_add_hash_entry_to_database(DB_DATABASE* database, const char* path, int sep)
+// CE: Records that `filename` (relative to patches directory) was created
+// by the game. Its directory is remembered too - files appearing there later
+// (renamed by the game) are always looked up on disk.
+static int db_resolver_add_patch(DB_DATABASE* database, const char* filename)
 {
-    unsigned int key;
+    char key[COMPAT_MAX_PATH];
+    char* pch;
+    DB_RESOLVER_ENTRY* entry;
 
-    if (!hash_is_on) {
+    if (database->resolver == NULL) {
         return -1;
     }
 
-    if (database == NULL) {
+    if (!db_resolver_normalize(filename, key, sizeof(key))) {
         return -1;
     }
 
-    if (database->hash_table == NULL) {
+    entry = db_resolver_find(database, key, true);
+    if (entry == NULL) {
         return -1;
     }
 
-    if (db_hash_string_to_key(path, sep, &key) != 0) {
+    entry->flags |= DB_RESOLVER_PATCH;
+
+    pch = strrchr(key, '\\');
+    if (pch != NULL) {
+        *pch = '\0';
+    } else {
+        key[0] = '\0';
+    }
+
+    entry = db_resolver_find(database, key, true);
+    if (entry == NULL) {
         return -1;
     }
 
-    return db_set_hash_value(database, key, 1);
+    if ((entry->flags & DB_RESOLVER_WRITTEN_DIR) == 0) {
+        entry->flags |= DB_RESOLVER_WRITTEN_DIR;
+        database->resolver_written_dirs++;
+    }
+
+    return 0;
 }
 
-// 0x4B2258
-static int db_set_hash_value(DB_DATABASE* database, unsigned int key, unsigned char enabled)
+// CE: Returns resolver entry of `filename` (relative to datafile and patches
+// roots). Unknown paths are added as misses, so every path is hashed once
+// and compared once on later lookups. Returns `NULL` when the path cannot be
+// resolved this way (it's not normalized, or resolver is not available) -
+// caller should look it up on disk and in the datafile directly.
+static DB_RESOLVER_ENTRY* db_resolve(DB_DATABASE* database, const char* filename)
 {
-    if (!hash_is_on) {
-        return -1;
+    char key[COMPAT_MAX_PATH];
+
+    if (database->resolver == NULL) {
+        return NULL;
     }
 
-    if (database->hash_table == NULL) {
-        return -1;
+    if (!db_resolver_normalize(filename, key, sizeof(key))) {
+        return NULL;
     }
 
-    if (key >= 0x7FFF) {
-        return -1;
+    return db_resolver_find(database, key, true);
+}
+
+// CE: Returns `true` if file of resolved `entry` might be in patches
+// directory and should be opened to check.
+static bool db_resolver_patch_may_exist(DB_DATABASE* database, DB_RESOLVER_ENTRY* entry)
+{
+    char key[COMPAT_MAX_PATH];
+    char* pch;
+    DB_RESOLVER_ENTRY* dir;
+
+    if (entry == NULL || !database->resolver_patches_scanned) {
+        return true;
     }
 
-    if (enabled == true) {
-        database->hash_table[key / 8] |= 1 << (key % 8);
-    } else {
-        database->hash_table[key / 8] = 0;
+    if ((entry->flags & DB_RESOLVER_PATCH) != 0) {
+        return true;
     }
 
-    return 0;
+    if (database->resolver_written_dirs != 0) {
+        strcpy(key, entry->name);
+
+        pch = strrchr(key, '\\');
+        if (pch != NULL) {
+            *pch = '\0';
+        } else {
+            key[0] = '\0';
+        }
+
+        dir = db_resolver_find(database, key, false);
+        if (dir != NULL && (dir->flags & DB_RESOLVER_WRITTEN_DIR) != 0) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-// 0x4B2304
-static int db_get_hash_value(DB_DATABASE* database, const char* path, int sep, int* value_ptr)
+// CE: Copies `path` to `dest` in the form used as resolver key - upper case,
+// backslash separators, no leading `.\`. Returns `false` if `path` is too
+// long or has empty, `.` or `..` components (such paths are left to the
+// filesystem). `path` and `dest` can be the same buffer.
+static bool db_resolver_normalize(const char* path, char* dest, size_t size)
 {
-    unsigned int key;
+    size_t length;
+    size_t component;
+    char ch;
 
-    if (!hash_is_on) {
-        return -1;
+    if (path[0] == '.' && (path[1] == '\\' || path[1] == '/')) {
+        path += 2;
     }
 
-    if (database->hash_table == NULL) {
-        return -1;
+    // `db_find_dir_entry` drops leading dot even without separator.
+    if (path[0] == '.') {
+        return false;
     }
 
-    if (path == NULL) {
-        return -1;
-    }
+    length = 0;
+    component = 0;
+    while (*path != '\0') {
+        ch = *path++;
+        if (ch == '/') {
+            ch = '\\';
+        }
 
-    if (db_hash_string_to_key(path, sep, &key) != 0) {
-        return -1;
+        if (ch == '\\') {
+            if (length == component) {
+                return false;
+            }
+
+            if (dest[component] == '.' && (length - component == 1 || (length - component == 2 && dest[component + 1] == '.'))) {
+                return false;
+            }
+
+            component = length + 1;
+        }
+
+        if (length + 1 >= size) {
+            return false;
+        }
+
+        dest[length++] = (char)toupper((unsigned char)ch);
     }
 
-    if (key >= 0x7FFF) {
-        return -1;
+    dest[length] = '\0';
+
+    // Trailing separator.
+    if (length != 0 && length == component) {
+        return false;
     }
 
-    *value_ptr = (database->hash_table[key / 8] >> (key % 8)) & 1;
+    return true;
+}
 
-    return 0;
+// CE: FNV-1a.
+static unsigned int db_resolver_hash(const char* key)
+{
+    unsigned int hash = 2166136261U;
+
+    while (*key != '\0') {
+        hash ^= (unsigned char)*key++;
+        hash *= 16777619U;
+    }
+
+    return hash;
 }
 
-// 0x4B2394
-static int db_hash_string_to_key(const char* path, int sep, unsigned int* key_ptr)
+// CE: Finds entry of normalized `key`. When `insert` is set missing entries
+// are added (without flags and datafile entry), otherwise `NULL` is
+// returned. `NULL` is also returned when memory cannot be allocated.
+static DB_RESOLVER_ENTRY* db_resolver_find(DB_DATABASE* database, const char* key, bool insert)
 {
-    char* copy;
-    char* pch;
-    char* filename;
-    size_t index;
-    unsigned int key;
+    unsigned int hash;
+    unsigned int mask;
+    unsigned int slot;
+    DB_RESOLVER_ENTRY* entry;
 
-    key = 1;
+    hash = db_resolver_hash(key);
 
-    if (path == NULL) {
-        return -1;
-    }
+    for (;;) {
+        mask = (unsigned int)database->resolver_capacity - 1;
+        slot = hash & mask;
+
+        for (;;) {
+            entry = &(database->resolver[slot]);
+            if (entry->name == NULL) {
+                break;
+            }
 
-    copy = (char*)internal_strdup(path);
-    compat_strupr(copy);
+            if (entry->hash == hash && strcmp(entry->name, key) == 0) {
+                return entry;
+            }
 
-    pch = strrchr(copy, sep);
-    if (pch != NULL) {
-        filename = pch + 1;
-    } else {
-        filename = copy;
+            slot = (slot + 1) & mask;
+        }
+
+        if (!insert) {
+            return NULL;
+        }
+
+        // Keep load factor below 3/4.
+        if ((database->resolver_length + 1) * 4 <= database->resolver_capacity * 3) {
+            break;
+        }
+
+        if (db_resolver_grow(database) != 0) {
+            return NULL;
+        }
+    }
+
+    entry->name = db_resolver_intern(database, key);
+    if (entry->name == NULL) {
+        return NULL;
     }
 
-    for (index = 0; index < strlen(filename); index++) {
-        key *= *filename++;
-        key &= 0x7FFFFFFF;
+    entry->hash = hash;
+    entry->flags = 0;
+    entry->de = NULL;
+    database->resolver_length++;
+
+    return entry;
+}
+
+// CE: Doubles resolver capacity. Entries keep their names, only slots change.
+static int db_resolver_grow(DB_DATABASE* database)
+{
+    DB_RESOLVER_ENTRY* entries;
+    int capacity;
+    unsigned int mask;
+    unsigned int slot;
+    int index;
+
+    capacity = database->resolver_capacity * 2;
+    entries = (DB_RESOLVER_ENTRY*)internal_malloc(sizeof(*entries) * capacity);
+    if (entries == NULL) {
+        return -1;
     }
 
-    *key_ptr = key & 0x7FFF;
+    memset(entries, 0, sizeof(*entries) * capacity);
+
+    mask = (unsigned int)capacity - 1;
+    for (index = 0; index < database->resolver_capacity; index++) {
+        if (database->resolver[index].name != NULL) {
+            slot = database->resolver[index].hash & mask;
+            while (entries[slot].name != NULL) {
+                slot = (slot + 1) & mask;
+            }
+            entries[slot] = database->resolver[index];
+        }
+    }
 
-    internal_free(copy);
+    internal_free(database->resolver);
+    database->resolver = entries;
+    database->resolver_capacity = capacity;
 
     return 0;
 }
 
-// 0x4B2420
-static void db_exit_hash_table(DB_DATABASE* database)
+// CE: Copies `key` to resolver name blocks. Names are never freed one by
+// one, blocks are released with the resolver.
+static char* db_resolver_intern(DB_DATABASE* database, const char* key)
+{
+    DB_RESOLVER_NAMES* names;
+    size_t size;
+    char* name;
+
+    size = strlen(key) + 1;
+
+    names = database->resolver_names;
+    if (names == NULL || names->used + size > sizeof(names->data)) {
+        names = (DB_RESOLVER_NAMES*)internal_malloc(sizeof(*names));
+        if (names == NULL) {
+            return NULL;
+        }
+
+        names->next = database->resolver_names;
+        names->used = 0;
+        database->resolver_names = names;
+    }
+
+    name = names->data + names->used;
+    memcpy(name, key, size);
+    names->used += size;
+
+    return name;
+}
+
+// CE: Frees path resolver of the database.
+static void db_exit_resolver(DB_DATABASE* database)
 {
-    if (database->hash_table != NULL) {
-        internal_free(database->hash_table);
+    DB_RESOLVER_NAMES* next;
+
+    if (database->resolver != NULL) {
+        internal_free(database->resolver);
+        database->resolver = NULL;
+    }
+
+    while (database->resolver_names != NULL) {
+        next = database->resolver_names->next;
+        internal_free(database->resolver_names);
+        database->resolver_names = next;
     }
-    database->hash_table = NULL;
+
+    database->resolver_capacity = 0;
+    database->resolver_length = 0;
+    database->resolver_written_dirs = 0;
+    database->resolver_patches_scanned = false;
 }
 
 // 0x4B2444
@@ -2420,6 +3635,15 @@ static DB_FILE* db_add_fp_rec(FILE* stream, unsigned char* a2, int a3, int flags
                     current_database->files[pos].field_18 = ftell(stream);
                     current_database->files[pos].field_1C = a2;
                     current_database->files[pos].field_20 = a2 + 0x4000;
+
+                    // CE: Chunk index is optional, seeks decode every chunk
+                    // in between without it.
+                    current_database->files[pos].chunk_offsets = (int*)internal_malloc(sizeof(int) * ((a3 + 0x3FFF) / 0x4000 + 1));
+                    if (current_database->files[pos].chunk_offsets != NULL) {
+                        current_database->files[pos].chunk_offsets[0] = current_database->files[pos].field_14;
+                        current_database->files[pos].chunk_offsets_length = 1;
+                    }
+
                     ptr = &(current_database->files[pos]);
                     break;
                 }
@@ -2448,9 +3672,13 @@ static int db_delete_fp_rec(DB_FILE* stream)
     } else {
         switch (stream->flags & 0xF0) {
         case 16:
-            if (stream->field_1C != NULL) {
+            if (stream->field_1C != NULL && (stream->flags & DB_FILE_FLAG_BORROWED) == 0) {
                 internal_free(stream->field_1C);
             }
+
+            if (stream->prefetch != NULL) {
+                db_prefetch_release(stream->prefetch);
+            }
             break;
         case 32:
             break;
@@ -2458,6 +3686,10 @@ static int db_delete_fp_rec(DB_FILE* stream)
             if (stream->field_1C != NULL) {
                 internal_free(stream->field_1C);
             }
+
+            if (stream->chunk_offsets != NULL) {
+                internal_free(stream->chunk_offsets);
+            }
             break;
         }
     }
@@ -2695,21 +3927,47 @@ static void db_default_free(void* ptr)
 static void db_preload_buffer(DB_FILE* stream)
 {
     unsigned short v1;
+    unsigned char* chunk;
 
     if ((stream->flags & 0x8) != 0 && (stream->flags & 0xF0) == 64) {
         if (stream->field_10 != 0) {
             if (stream->field_20 >= stream->field_1C + 0x4000) {
+                // CE: Remember where each chunk starts for `db_fseek`.
+                if (stream->chunk_offsets != NULL && stream->chunk_index == stream->chunk_offsets_length) {
+                    stream->chunk_offsets[stream->chunk_offsets_length++] = stream->field_18;
+                }
+
+                // CE: Take the next chunk from the mapping when available.
+                if (db_mapping_contains(stream->database, stream->field_18, 2)) {
+                    chunk = stream->database->mapping + stream->field_18;
+                    v1 = (chunk[0] << 8) | chunk[1];
+                    if (db_mapping_contains(stream->database, stream->field_18 + 2, v1 & ~0x8000)) {
+                        if ((v1 & 0x8000) != 0) {
+                            v1 &= ~0x8000;
+                            memcpy(stream->field_1C, chunk + 2, v1);
+                        } else {
+                            lzss_decode_block(chunk + 2, v1, stream->field_1C, 0x4000);
+                        }
+
+                        stream->field_20 = stream->field_1C;
+                        stream->field_18 += 2 + v1;
+                        stream->chunk_index++;
+                        return;
+                    }
+                }
+
                 if (fseek(stream->database->stream, stream->field_18, SEEK_SET) == 0) {
                     if (fread_short(stream->database->stream, &v1) == 0) {
                         if ((v1 & 0x8000) != 0) {
                             v1 &= ~0x8000;
                             fread(stream->field_1C, 1, v1, stream->database->stream);
                         } else {
-                            lzss_decode_to_buf(stream->database->stream, stream->field_1C, v1);
+                            lzss_decode_stream_block(stream->database->stream, v1, stream->field_1C, 0x4000);
                         }
 
                         stream->field_20 = stream->field_1C;
                         stream->field_18 = ftell(stream->database->stream);
+                        stream->chunk_index++;
                     }
                 }
             }
@@ -2717,6 +3975,63 @@ static void db_preload_buffer(DB_FILE* stream)
     }
 }
 
+// CE: Positions chunked `stream` at `offset` decoding only the chunk it is
+// in. Offsets of chunks that were not reached yet are found by walking chunk
+// headers, which is cheap compared to decoding them.
+static int db_seek_chunk(DB_FILE* stream, long offset)
+{
+    int chunk;
+    int chunk_count;
+    int chunk_offset;
+    unsigned char* header;
+    unsigned short v1;
+
+    chunk = offset / 0x4000;
+    chunk_count = (stream->field_C + 0x3FFF) / 0x4000;
+
+    // Offset is the end of the entry which ends on chunk boundary, there is
+    // nothing to decode.
+    if (chunk >= chunk_count) {
+        stream->field_20 = stream->field_1C + 0x4000;
+        stream->field_10 = 0;
+        return 0;
+    }
+
+    while (stream->chunk_offsets_length <= chunk) {
+        chunk_offset = stream->chunk_offsets[stream->chunk_offsets_length - 1];
+
+        if (db_mapping_contains(stream->database, chunk_offset, 2)) {
+            header = stream->database->mapping + chunk_offset;
+            v1 = (header[0] << 8) | header[1];
+        } else {
+            if (fseek(stream->database->stream, chunk_offset, SEEK_SET) != 0) {
+                return -1;
+            }
+
+            if (fread_short(stream->database->stream, &v1) != 0) {
+                return -1;
+            }
+        }
+
+        stream->chunk_offsets[stream->chunk_offsets_length++] = chunk_offset + 2 + (v1 & ~0x8000);
+    }
+
+    stream->field_18 = stream->chunk_offsets[chunk];
+    stream->chunk_index = chunk;
+    stream->field_20 = stream->field_1C + 0x4000;
+    stream->field_10 = stream->field_C - chunk * 0x4000;
+    db_preload_buffer(stream);
+
+    if (stream->field_20 != stream->field_1C) {
+        return -1;
+    }
+
+    stream->field_20 += offset % 0x4000;
+    stream->field_10 = stream->field_C - offset;
+
+    return 0;
+}
+
 // 0x4B2970
 static int fread_short(FILE* stream, unsigned short* s)
 {
@@ -2738,6 +4053,74 @@ static int fread_short(FILE* stream, unsigned short* s)
     return 0;
 }
 
+// Reads exactly `length` bytes in one go. Falls back to byte by byte reading
+// for text streams from datafiles, since only `db_fgetc` translates newlines
+// for them.
+static int db_fread_bytes(DB_FILE* stream, unsigned char* buf, int length)
+{
+    if (stream == NULL) {
+        return -1;
+    }
+
+    if ((stream->flags & 0x4) == 0 && (stream->flags & 0x2) != 0) {
+        for (int index = 0; index < length; index++) {
+            int ch = db_fgetc(stream);
+            if (ch == -1) {
+                return -1;
+            }
+
+            buf[index] = ch & 0xFF;
+        }
+
+        return 0;
+    }
+
+    if (length == 0) {
+        return 0;
+    }
+
+    if (db_fread(buf, 1, length, stream) != (size_t)length) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int db_fwrite_bytes(DB_FILE* stream, const unsigned char* buf, int length)
+{
+    if (length == 0) {
+        return 0;
+    }
+
+    if (db_fwrite(buf, 1, length, stream) != (size_t)length) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Converts array of big-endian shorts read as raw bytes to host byte order.
+static void db_decode_shorts(unsigned short* arr, int count)
+{
+    unsigned char* bytes = (unsigned char*)arr;
+    for (int index = 0; index < count; index++) {
+        arr[index] = (unsigned short)((bytes[index * 2] << 8) | bytes[index * 2 + 1]);
+    }
+}
+
+// Converts array of big-endian ints read as raw bytes to host byte order.
+static void db_decode_ints(int* arr, int count)
+{
+    unsigned char* bytes = (unsigned char*)arr;
+    for (int index = 0; index < count; index++) {
+        unsigned int value = ((unsigned int)bytes[index * 4] << 24)
+            | ((unsigned int)bytes[index * 4 + 1] << 16)
+            | ((unsigned int)bytes[index * 4 + 2] << 8)
+            | (unsigned int)bytes[index * 4 + 3];
+        arr[index] = (int)value;
+    }
+}
+
 static inline bool fileFindIsDirectory(DB_FIND_DATA* findData)
 {
 #if defined(_WIN32)
@@ -2825,46 +4208,22 @@ int db_freadInt32(DB_FILE* stream, int* valuePtr)
 
 int db_freadUInt8List(DB_FILE* stream, unsigned char* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_freadUInt8(stream, &(arr[index])) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_freadByteCount(stream, arr, count);
 }
 
 int db_freadInt8List(DB_FILE* stream, char* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_freadInt8(stream, &(arr[index])) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_freadByteCount(stream, (unsigned char*)arr, count);
 }
 
 int db_freadInt16List(DB_FILE* stream, short* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_freadInt16(stream, &(arr[index])) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_freadShortCount(stream, (unsigned short*)arr, count);
 }
 
 int db_freadInt32List(DB_FILE* stream, int* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_freadInt32(stream, &(arr[index])) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_freadIntCount(stream, arr, count);
 }
 
 int db_freadBool(DB_FILE* stream, bool* valuePtr)
@@ -2911,46 +4270,22 @@ int db_fwriteInt32(DB_FILE* stream, int value)
 
 int db_fwriteUInt8List(DB_FILE* stream, unsigned char* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_fwriteUInt8(stream, arr[index]) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_fwriteByteCount(stream, arr, count);
 }
 
 int db_fwriteInt8List(DB_FILE* stream, char* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_fwriteInt8(stream, arr[index]) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_fwriteByteCount(stream, (unsigned char*)arr, count);
 }
 
 int db_fwriteInt16List(DB_FILE* stream, short* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_fwriteInt16(stream, arr[index]) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_fwriteShortCount(stream, (unsigned short*)arr, count);
 }
 
 int db_fwriteInt32List(DB_FILE* stream, int* arr, int count)
 {
-    for (int index = 0; index < count; index++) {
-        if (db_fwriteInt32(stream, arr[index]) == -1) {
-            return -1;
-        }
-    }
-
-    return 0;
+    return db_fwriteIntCount(stream, arr, count);
 }
 
 int db_fwriteBool(DB_FILE* stream, bool value)
@@ -31,6 +31,7 @@ void db_exit();
 int db_dir_entry(const char* filePath, dir_entry* de);
 int db_read_to_buf(const char* filePath, unsigned char* ptr);
 DB_FILE* db_fopen(const char* filename, const char* mode);
+DB_FILE* db_fopen_mem(unsigned char* data, int size);
 int db_fclose(DB_FILE* stream);
 size_t db_fread(void* buf, size_t size, size_t count, DB_FILE* stream);
 int db_fgetc(DB_FILE* stream);
@@ -70,6 +71,9 @@ long db_filelength(DB_FILE* stream);
 void db_register_mem(db_malloc_func* malloc_func, db_strdup_func* strdup_func, db_free_func* free_func);
 void db_register_callback(db_read_callback* callback, size_t threshold);
 void db_enable_hash_table();
+void db_enable_mmap();
+int db_prefetch(const char* filename);
+void db_prefetch_clear();
 int db_reset_hash_tables();
 int db_add_hash_entry(const char* path, int sep);
 
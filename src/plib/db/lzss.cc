@@ -7,31 +7,45 @@
 
 #include "plib/db/lzss.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 namespace fallout {
 
+#define LZSS_WINDOW_SIZE 4096
+#define LZSS_HASH_SIZE 4096
+#define LZSS_MIN_MATCH 3
+#define LZSS_MAX_MATCH 18
+#define LZSS_MAX_DISTANCE 4095
+#define LZSS_MAX_CHAIN 64
+
 static inline void lzss_fill_decode_buffer(FILE* stream);
+static inline void lzss_copy_match(unsigned char* dest, unsigned char* out, unsigned char* out_end, int offset, int distance, int length);
+static inline void lzss_save_ring_tail(unsigned char* dest, unsigned char* out);
 static inline void lzss_decode_chunk_to_buf(unsigned int type, unsigned char** dest, unsigned int* length);
 static inline void lzss_decode_chunk_to_file(unsigned int type, FILE* stream, unsigned int* length);
+static inline unsigned int lzss_hash(const unsigned char* data);
 
+// CE: Decoder state is per-thread so that DAT prefetch workers (see
+// `db_prefetch`) can decode alongside the main thread.
+//
 // 0x6B0860
-static unsigned char decode_buffer[1024];
+static thread_local unsigned char decode_buffer[1024];
 
 // 0x6B0C60
-static unsigned char* decode_buffer_position;
+static thread_local unsigned char* decode_buffer_position;
 
 // 0x6B0C64
-static unsigned int decode_bytes_left;
+static thread_local unsigned int decode_bytes_left;
 
 // 0x6B0C68
-static int ring_buffer_index;
+static thread_local int ring_buffer_index;
 
 // 0x6B0C6C
-static unsigned char* decode_buffer_end;
+static thread_local unsigned char* decode_buffer_end;
 
 // 0x6B0C70
-static unsigned char ring_buffer[4116];
+static thread_local unsigned char ring_buffer[4116];
 
 // 0x4CA260
 int lzss_decode_to_buf(FILE* in, unsigned char* dest, unsigned int length)
@@ -126,6 +140,213 @@ int lzss_decode_to_buf(FILE* in, unsigned char* dest, unsigned int length)
     return curr - dest;
 }
 
+// Decodes `length` packed bytes from `in` into `dest`, writing at most `size`
+// bytes. Produces the same output as `lzss_decode_to_buf` (including the
+// untouched tail of the dictionary that is carried over from the previous
+// decode), but works on the whole block at once: back-references are copied
+// from already decoded output instead of going through the ring dictionary,
+// and runs of literals and long matches are moved in 8-byte chunks.
+//
+// Returns the number of bytes written to `dest`.
+int lzss_decode_block(const unsigned char* in, unsigned int length, unsigned char* dest, unsigned int size)
+{
+    const unsigned char* src;
+    const unsigned char* src_end;
+    unsigned char* out;
+    unsigned char* out_end;
+    unsigned int flags;
+    int bit;
+    int offset;
+    int distance;
+    int chunk_length;
+
+    src = in;
+    src_end = in + length;
+    out = dest;
+    out_end = dest + size;
+
+    while (src < src_end) {
+        flags = *src++;
+
+        // Eight literals in a row.
+        if (flags == 0xFF && src_end - src >= 8 && out_end - out >= 8) {
+            memcpy(out, src, 8);
+            out += 8;
+            src += 8;
+            continue;
+        }
+
+        for (bit = 0; bit < 8 && src < src_end; bit++) {
+            if ((flags & (1 << bit)) != 0) {
+                if (out == out_end) {
+                    lzss_save_ring_tail(dest, out);
+                    return out - dest;
+                }
+
+                *out++ = *src++;
+            } else {
+                if (src_end - src < 2) {
+                    lzss_save_ring_tail(dest, out);
+                    return out - dest;
+                }
+
+                offset = src[0] | ((src[1] & 0xF0) << 4);
+                chunk_length = (src[1] & 0x0F) + 3;
+                src += 2;
+
+                // Ring position of the byte being written is
+                // `(4078 + (out - dest)) & 0xFFF`.
+                distance = (4078 + (int)(out - dest) - offset) & 0xFFF;
+                if (distance == 0) {
+                    distance = 4096;
+                }
+
+                if (chunk_length > out_end - out) {
+                    chunk_length = (int)(out_end - out);
+                }
+
+                lzss_copy_match(dest, out, out_end, offset, distance, chunk_length);
+                out += chunk_length;
+            }
+        }
+    }
+
+    lzss_save_ring_tail(dest, out);
+
+    return out - dest;
+}
+
+// Same as `lzss_decode_block`, but reads `length` packed bytes from `in`
+// first. Falls back to `lzss_decode_to_buf` if there is no memory for the
+// packed block.
+int lzss_decode_stream_block(FILE* in, unsigned int length, unsigned char* dest, unsigned int size)
+{
+    unsigned char* block;
+    size_t bytes_read;
+    int rc;
+
+    block = (unsigned char*)malloc(length != 0 ? length : 1);
+    if (block == NULL) {
+        return lzss_decode_to_buf(in, dest, length);
+    }
+
+    bytes_read = fread(block, 1, length, in);
+    rc = lzss_decode_block(block, (unsigned int)bytes_read, dest, size);
+
+    free(block);
+
+    return rc;
+}
+
+// CE: Compresses `length` bytes from `in` into a stream understood by
+// `lzss_decode_block`. Uses greedy matching over hash chains, which is fast
+// enough to be run on every save.
+//
+// Returns number of bytes written to `dest`, or -1 if compressed data does not
+// fit into `capacity` bytes (in which case caller is expected to store data
+// as is).
+int lzss_encode_block(const unsigned char* in, unsigned int length, unsigned char* dest, unsigned int capacity)
+{
+    int* head;
+    int* prev;
+    unsigned int pos;
+    unsigned int out;
+    unsigned int flags_pos;
+    unsigned int flags;
+    unsigned int max_length;
+    unsigned int best_length;
+    unsigned int best_distance;
+    unsigned int match_length;
+    unsigned int end;
+    unsigned int hash;
+    int candidate;
+    int tries;
+    int bit;
+
+    head = (int*)malloc(sizeof(*head) * LZSS_HASH_SIZE);
+    prev = (int*)malloc(sizeof(*prev) * LZSS_WINDOW_SIZE);
+    if (head == NULL || prev == NULL) {
+        free(head);
+        free(prev);
+        return -1;
+    }
+
+    for (candidate = 0; candidate < LZSS_HASH_SIZE; candidate++) {
+        head[candidate] = -1;
+    }
+
+    pos = 0;
+    out = 0;
+    while (pos < length) {
+        // Flags byte plus eight matches at most.
+        if (capacity - out < 17) {
+            out = (unsigned int)-1;
+            break;
+        }
+
+        flags_pos = out++;
+        flags = 0;
+
+        for (bit = 0; bit < 8 && pos < length; bit++) {
+            max_length = length - pos;
+            if (max_length > LZSS_MAX_MATCH) {
+                max_length = LZSS_MAX_MATCH;
+            }
+
+            best_length = 0;
+            best_distance = 0;
+
+            if (max_length >= LZSS_MIN_MATCH) {
+                candidate = head[lzss_hash(in + pos)];
+                tries = LZSS_MAX_CHAIN;
+                while (candidate >= 0 && pos - candidate <= LZSS_MAX_DISTANCE && tries-- > 0) {
+                    match_length = 0;
+                    while (match_length < max_length && in[candidate + match_length] == in[pos + match_length]) {
+                        match_length++;
+                    }
+
+                    if (match_length > best_length) {
+                        best_length = match_length;
+                        best_distance = pos - candidate;
+                        if (best_length == max_length) {
+                            break;
+                        }
+                    }
+
+                    candidate = prev[candidate & (LZSS_WINDOW_SIZE - 1)];
+                }
+            }
+
+            if (best_length >= LZSS_MIN_MATCH) {
+                candidate = (4078 + pos - best_distance) & 0xFFF;
+                dest[out++] = candidate & 0xFF;
+                dest[out++] = ((candidate >> 4) & 0xF0) | (best_length - LZSS_MIN_MATCH);
+            } else {
+                best_length = 1;
+                flags |= 1 << bit;
+                dest[out++] = in[pos];
+            }
+
+            // Every position covered by this item becomes a match candidate.
+            end = pos + best_length;
+            for (; pos < end; pos++) {
+                if (length - pos >= LZSS_MIN_MATCH) {
+                    hash = lzss_hash(in + pos);
+                    prev[pos & (LZSS_WINDOW_SIZE - 1)] = head[hash];
+                    head[hash] = (int)pos;
+                }
+            }
+        }
+
+        dest[flags_pos] = (unsigned char)flags;
+    }
+
+    free(head);
+    free(prev);
+
+    return (int)out;
+}
+
 // 0x4CB570
 void lzss_decode_to_file(FILE* in, FILE* out, unsigned int length)
 {
@@ -241,6 +462,71 @@ static inline void lzss_fill_decode_buffer(FILE* stream)
     }
 }
 
+// Copies back-reference of `length` bytes `distance` bytes behind `out`.
+// Bytes that are before `dest` were never written by this decode - they come
+// from the initial state of the dictionary.
+static inline void lzss_copy_match(unsigned char* dest, unsigned char* out, unsigned char* out_end, int offset, int distance, int length)
+{
+    unsigned char* match;
+    int index;
+
+    if (distance <= out - dest) {
+        match = out - distance;
+
+        // Wide copy is fine when every 8-byte read is behind the matching
+        // write. Match length is at most 18, so 24 bytes of room are enough.
+        if (distance >= 8 && out_end - out >= 24) {
+            memcpy(out, match, 8);
+            memcpy(out + 8, match + 8, 8);
+            if (length > 16) {
+                memcpy(out + 16, match + 16, 8);
+            }
+            return;
+        }
+
+        for (index = 0; index < length; index++) {
+            out[index] = match[index];
+        }
+    } else {
+        for (index = 0; index < length; index++) {
+            if (index < distance - (out - dest)) {
+                // Dictionary is filled with spaces except for the tail that
+                // is left over from the previous decode.
+                if (((offset + index) & 0xFFF) < 4078) {
+                    out[index] = ' ';
+                } else {
+                    out[index] = ring_buffer[(offset + index) & 0xFFF];
+                }
+            } else {
+                out[index] = out[index - distance];
+            }
+        }
+    }
+}
+
+// Stores what `lzss_decode_to_buf` would leave in the part of the dictionary
+// that is not reset on the next decode.
+static inline void lzss_save_ring_tail(unsigned char* dest, unsigned char* out)
+{
+    int total;
+    int last;
+    int index;
+    int pos;
+
+    total = (int)(out - dest);
+    if (total == 0) {
+        return;
+    }
+
+    last = (4078 + total - 1) & 0xFFF;
+    for (index = 4078; index < 4096; index++) {
+        pos = total - 1 - ((last - index) & 0xFFF);
+        if (pos >= 0) {
+            ring_buffer[index] = dest[pos];
+        }
+    }
+}
+
 static inline void lzss_decode_chunk_to_buf(unsigned int type, unsigned char** dest, unsigned int* length)
 {
     unsigned char low;
@@ -305,4 +591,9 @@ static inline void lzss_decode_chunk_to_file(unsigned int type, FILE* stream, un
     }
 }
 
+static inline unsigned int lzss_hash(const unsigned char* data)
+{
+    return ((data[0] << 8) ^ (data[1] << 4) ^ data[2]) & (LZSS_HASH_SIZE - 1);
+}
+
 } // namespace fallout
@@ -6,7 +6,10 @@
 namespace fallout {
 
 int lzss_decode_to_buf(FILE* in, unsigned char* dest, unsigned int length);
+int lzss_decode_block(const unsigned char* in, unsigned int length, unsigned char* dest, unsigned int size);
+int lzss_decode_stream_block(FILE* in, unsigned int length, unsigned char* dest, unsigned int size);
 void lzss_decode_to_file(FILE* in, FILE* out, unsigned int length);
+int lzss_encode_block(const unsigned char* in, unsigned int length, unsigned char* dest, unsigned int capacity);
 
 } // namespace fallout
 
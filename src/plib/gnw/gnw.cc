@@ -1,5 +1,7 @@
 #include "plib/gnw/gnw.h"
 
+#include <string.h>
+
 #include <algorithm>
 
 #include "game/palette.h"
@@ -15,14 +17,22 @@
 #include "plib/gnw/text.h"
 #include "plib/gnw/vcr.h"
 #include "plib/gnw/winmain.h"
+#include "profiler.h"
 
 namespace fallout {
 
 #define MAX_WINDOW_COUNT 50
 
+// CE: Number of separate screen areas `win_compose` keeps. When exceeded,
+// areas are collapsed into their bounding box.
+#define WIN_DAMAGE_CAPACITY 32
+
 static void win_free(int win);
 static void win_clip(Window* window, RectPtr* rectListNodePtr, unsigned char* a3);
 static void refresh_all(Rect* rect, unsigned char* a2);
+static bool win_defer_refresh(unsigned char* a3);
+static void win_damage_add(const Rect* rect);
+static bool win_occluded(int index, const Rect* rect);
 static void* colorOpen(const char* path);
 static int colorRead(void* handle, void* buf, size_t count);
 static int colorClose(void* handle);
@@ -72,6 +82,16 @@ static int bk_color;
 // 0x6AC2C8
 static int doing_refresh_all;
 
+// CE: Screen areas changed since the last `win_compose`, they don't overlap.
+static Rect win_damage[WIN_DAMAGE_CAPACITY];
+static int win_damage_count;
+
+// CE: Set while `win_compose` repaints damaged areas.
+static bool win_composing;
+
+// CE: Outline areas repainted by `win_compose` on screen.
+static bool win_show_repaints;
+
 // 0x6AC2CC
 void* GNW_texture;
 
@@ -838,6 +858,15 @@ void GNW_win_refresh(Window* w, Rect* rect, unsigned char* a3)
         return;
     }
 
+    // CE: Screen is composed once per frame, see `win_compose`.
+    if (win_defer_refresh(a3)) {
+        Rect damage;
+        if (rect_inside_bound(rect, &(w->rect), &damage) == 0) {
+            win_damage_add(&damage);
+        }
+        return;
+    }
+
     if ((w->flags & WINDOW_TRANSPARENT) && buffering && !doing_refresh_all) {
         // TODO: Incomplete.
     } else {
@@ -988,11 +1017,126 @@ void GNW_win_refresh(Window* w, Rect* rect, unsigned char* a3)
 // 0x4C3654
 void win_refresh_all(Rect* rect)
 {
+    ProfilerZone zone("win_refresh_all");
+
     if (GNW_win_init_flag) {
+        // CE: Screen is composed once per frame, see `win_compose`.
+        if (win_defer_refresh(NULL)) {
+            win_damage_add(rect);
+            return;
+        }
+
         refresh_all(rect, NULL);
     }
 }
 
+// CE: Repaints screen areas damaged by window refreshes since the last call.
+// Overlapping refreshes issued during a frame (mouse, animated buttons,
+// isometric view) are merged and painted once. Called before every present,
+// and before anything is drawn to the screen bypassing windows.
+void win_compose()
+{
+    if (!GNW_win_init_flag || win_damage_count == 0) {
+        return;
+    }
+
+    ProfilerZone zone("win_compose");
+
+    Rect damage[WIN_DAMAGE_CAPACITY];
+    int count = win_damage_count;
+    memcpy(damage, win_damage, sizeof(*damage) * count);
+    win_damage_count = 0;
+
+    win_composing = true;
+    for (int index = 0; index < count; index++) {
+        refresh_all(&(damage[index]), NULL);
+    }
+    win_composing = false;
+
+    if (win_show_repaints) {
+        renderShowRepaints(damage, count);
+    }
+}
+
+// CE: Enables outlines of repainted areas.
+void win_set_show_repaints(bool show)
+{
+    win_show_repaints = show;
+}
+
+// CE: Returns true if refresh targets the screen and can wait until
+// `win_compose`. Screen dump temporarily replaces `scr_blit` to get the
+// picture into memory, such refreshes are done right away.
+static bool win_defer_refresh(unsigned char* a3)
+{
+    return a3 == NULL
+        && !doing_refresh_all
+        && !win_composing
+        && scr_blit == GNW95_ShowRect;
+}
+
+// CE: Adds screen area to be repainted by `win_compose`. Overlapping areas
+// are merged, since union can overlap other areas, merging repeats until
+// areas are disjoint.
+static void win_damage_add(const Rect* rect)
+{
+    Rect damage;
+    if (rect_inside_bound(rect, &scr_size, &damage) == -1) {
+        return;
+    }
+
+    int index = 0;
+    while (index < win_damage_count) {
+        Rect* other = &(win_damage[index]);
+        if (damage.ulx <= other->lrx && damage.lrx >= other->ulx
+            && damage.uly <= other->lry && damage.lry >= other->uly) {
+            rect_min_bound(&damage, other, &damage);
+            win_damage[index] = win_damage[--win_damage_count];
+            index = 0;
+        } else {
+            index++;
+        }
+    }
+
+    if (win_damage_count == WIN_DAMAGE_CAPACITY) {
+        for (index = 0; index < win_damage_count; index++) {
+            rect_min_bound(&damage, &(win_damage[index]), &damage);
+        }
+        win_damage_count = 0;
+    }
+
+    win_damage[win_damage_count++] = damage;
+}
+
+// CE: Returns true if part of window at `index` inside `rect` is completely
+// covered by a single window above it.
+static bool win_occluded(int index, const Rect* rect)
+{
+    Rect visible;
+    if (rect_inside_bound(rect, &(window[index]->rect), &visible) == -1) {
+        return true;
+    }
+
+    for (int above = index + 1; above < num_windows; above++) {
+        Window* w = window[above];
+        if ((w->flags & WINDOW_HIDDEN) != 0) {
+            continue;
+        }
+
+        // Transparent windows are blended over the ones below when buffering.
+        if (buffering && (w->flags & WINDOW_TRANSPARENT) != 0) {
+            continue;
+        }
+
+        if (w->rect.ulx <= visible.ulx && w->rect.uly <= visible.uly
+            && w->rect.lrx >= visible.lrx && w->rect.lry >= visible.lry) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 // 0x4C3668
 static void win_clip(Window* w, RectPtr* rectListNodePtr, unsigned char* a3)
 {
@@ -1069,6 +1213,11 @@ static void refresh_all(Rect* rect, unsigned char* a2)
     doing_refresh_all = 1;
 
     for (int index = 0; index < num_windows; index++) {
+        // CE: Skip windows hidden behind others.
+        if (win_occluded(index, rect)) {
+            continue;
+        }
+
         GNW_win_refresh(window[index], rect, a2);
     }
 
@@ -57,6 +57,8 @@ void win_draw(int win);
 void win_draw_rect(int win, const Rect* rect);
 void GNW_win_refresh(Window* window, Rect* rect, unsigned char* a3);
 void win_refresh_all(Rect* rect);
+void win_compose();
+void win_set_show_repaints(bool show);
 void win_drag(int win);
 void win_get_mouse_buf(unsigned char* a1);
 Window* GNW_find(int win);
@@ -17,6 +17,7 @@
 #include "plib/gnw/touch.h"
 #include "plib/gnw/vcr.h"
 #include "plib/gnw/winmain.h"
+#include "profiler.h"
 
 namespace fallout {
 
@@ -122,6 +123,17 @@ static bool bk_disabled;
 // 0x671F08
 static unsigned int bk_process_time;
 
+// CE: Key that starts and stops profiler capture, see
+// `register_profiler_key`.
+static int profiler_key = -1;
+
+// CE: When set, time does not come from the wall clock, see
+// `enableFixedTime`.
+static bool fixed_time_enabled = false;
+
+// CE: Current time of the fixed clock.
+static unsigned int fixed_time = 0;
+
 // 0x4B32C0
 int GNW_input_init(int use_msec_timer)
 {
@@ -251,6 +263,11 @@ void GNW_add_input_buffer(int a1)
         return;
     }
 
+    if (a1 == profiler_key) {
+        profilerToggle();
+        return;
+    }
+
     if (input_put == input_get) {
         return;
     }
@@ -628,15 +645,31 @@ void register_screendump(int new_screendump_key, ScreenDumpFunc* new_screendump_
     screendump_func = new_screendump_func;
 }
 
+// CE: Registers key that toggles profiler capture, -1 disables it.
+void register_profiler_key(int new_profiler_key)
+{
+    profiler_key = new_profiler_key;
+}
+
 // 0x4B3BB8
 unsigned int get_time()
 {
+    if (fixed_time_enabled) {
+        return fixed_time;
+    }
+
     return SDL_GetTicks();
 }
 
 // 0x4B3BC4
 void pause_for_tocks(unsigned int delay)
 {
+    if (fixed_time_enabled) {
+        fixed_time += delay;
+        process_bk();
+        return;
+    }
+
     // NOTE: Uninline.
     unsigned int start = get_time();
     unsigned int end = get_time();
@@ -656,6 +689,11 @@ void pause_for_tocks(unsigned int delay)
 // 0x4B3C00
 void block_for_tocks(unsigned int ms)
 {
+    if (fixed_time_enabled) {
+        fixed_time += ms;
+        return;
+    }
+
     unsigned int start = SDL_GetTicks();
     unsigned int diff;
     do {
@@ -667,6 +705,12 @@ void block_for_tocks(unsigned int ms)
 // 0x4B3C28
 unsigned int elapsed_time(unsigned int start)
 {
+    if (fixed_time_enabled) {
+        // Every poll takes a tick, otherwise busy-waits would never end.
+        fixed_time++;
+        return elapsed_tocks(fixed_time, start);
+    }
+
     unsigned int end = SDL_GetTicks();
 
     // NOTE: Uninline.
@@ -683,6 +727,21 @@ unsigned int elapsed_tocks(unsigned int end, unsigned int start)
     }
 }
 
+// CE: Switches timing functions to a clock that only moves forward with
+// `advanceFixedTime` (and by a tick on every `elapsed_time`), so that
+// replaying the same input always gives the same result regardless of
+// machine speed.
+void enableFixedTime()
+{
+    fixed_time_enabled = true;
+    fixed_time = 0;
+}
+
+void advanceFixedTime(unsigned int ms)
+{
+    fixed_time += ms;
+}
+
 // 0x4B3C58
 unsigned int get_bk_time()
 {
@@ -30,6 +30,7 @@ void register_pause(int new_pause_key, PauseWinFunc* new_pause_win_func);
 void dump_screen();
 int default_screendump(int width, int height, unsigned char* data, unsigned char* palette);
 void register_screendump(int new_screendump_key, ScreenDumpFunc* new_screendump_func);
+void register_profiler_key(int new_profiler_key);
 unsigned int get_time();
 void pause_for_tocks(unsigned int ms);
 void block_for_tocks(unsigned int ms);
@@ -52,6 +53,8 @@ void GNW95_lost_focus();
 
 void beginTextInput();
 void endTextInput();
+void enableFixedTime();
+void advanceFixedTime(unsigned int ms);
 
 } // namespace fallout
 
@@ -4,11 +4,18 @@
 #include "plib/gnw/grbuf.h"
 #include "plib/gnw/mouse.h"
 #include "plib/gnw/winmain.h"
+#include "profiler.h"
 
 namespace fallout {
 
+// Maximum number of separate dirty rects collected between presents. When
+// exceeded, rects are collapsed into their bounding box.
+#define DIRTY_RECTS_CAPACITY 32
+
 static bool createRenderer(int width, int height);
 static void destroyRenderer();
+static void refreshPaletteLut();
+static void renderUploadRect(const SDL_Rect* rect);
 
 // screen rect
 Rect scr_size;
@@ -20,7 +27,21 @@ SDL_Window* gSdlWindow = NULL;
 SDL_Surface* gSdlSurface = NULL;
 SDL_Renderer* gSdlRenderer = NULL;
 SDL_Texture* gSdlTexture = NULL;
-SDL_Surface* gSdlTextureSurface = NULL;
+
+// Pixel format of `gSdlTexture`.
+static SDL_PixelFormat* gSdlTextureFormat = NULL;
+
+// `gSdlSurface` palette mapped to `gSdlTexture` pixel format.
+static Uint32 gPaletteLut[256];
+
+// Areas of `gSdlSurface` changed since the last present.
+static SDL_Rect gDirtyRects[DIRTY_RECTS_CAPACITY];
+static int gDirtyRectsLength = 0;
+
+// Areas repainted by window compositor to outline on the next present, see
+// `renderShowRepaints`.
+static SDL_Rect gRepaintRects[DIRTY_RECTS_CAPACITY];
+static int gRepaintRectsLength = 0;
 
 // TODO: Remove once migration to update-render cycle is completed.
 FpsLimiter sharedFpsLimiter;
@@ -41,7 +62,8 @@ void GNW95_SetPaletteEntries(unsigned char* palette, int start, int count)
         }
 
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, start, count);
-        SDL_BlitSurface(gSdlSurface, NULL, gSdlTextureSurface, NULL);
+        refreshPaletteLut();
+        renderAddDirtyRect(NULL);
     }
 }
 
@@ -59,7 +81,8 @@ void GNW95_SetPalette(unsigned char* palette)
         }
 
         SDL_SetPaletteColors(gSdlSurface->format->palette, colors, 0, 256);
-        SDL_BlitSurface(gSdlSurface, NULL, gSdlTextureSurface, NULL);
+        refreshPaletteLut();
+        renderAddDirtyRect(NULL);
     }
 }
 
@@ -68,32 +91,39 @@ void GNW95_ShowRect(unsigned char* src, unsigned int srcPitch, unsigned int a3,
 {
     buf_to_buf(src + srcPitch * srcY + srcX, srcWidth, srcHeight, srcPitch, (unsigned char*)gSdlSurface->pixels + gSdlSurface->pitch * destY + destX, gSdlSurface->pitch);
 
-    SDL_Rect srcRect;
-    srcRect.x = destX;
-    srcRect.y = destY;
-    srcRect.w = srcWidth;
-    srcRect.h = srcHeight;
-
-    SDL_Rect destRect;
-    destRect.x = destX;
-    destRect.y = destY;
-    SDL_BlitSurface(gSdlSurface, &srcRect, gSdlTextureSurface, &destRect);
+    // Palette expansion is deferred until the next present, so that
+    // overlapping updates made during one frame are converted once.
+    SDL_Rect rect;
+    rect.x = destX;
+    rect.y = destY;
+    rect.w = srcWidth;
+    rect.h = srcHeight;
+    renderAddDirtyRect(&rect);
 }
 
 bool svga_init(VideoOptions* video_options)
 {
-    SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
+    Uint32 windowFlags;
+
+    if (video_options->headless) {
+        // CE: Dummy driver needs no display, software renderer works on top
+        // of it.
+        SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "software");
+        windowFlags = SDL_WINDOW_HIDDEN;
+    } else {
+        SDL_SetHint(SDL_HINT_RENDER_DRIVER, "opengl");
+        windowFlags = SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI;
+
+        if (video_options->fullscreen) {
+            windowFlags |= SDL_WINDOW_FULLSCREEN;
+        }
+    }
 
     if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
         return false;
     }
 
-    Uint32 windowFlags = SDL_WINDOW_OPENGL | SDL_WINDOW_ALLOW_HIGHDPI;
-
-    if (video_options->fullscreen) {
-        windowFlags |= SDL_WINDOW_FULLSCREEN;
-    }
-
     gSdlWindow = SDL_CreateWindow(GNW95_title, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
         video_options->width * video_options->scale,
         video_options->height * video_options->scale,
@@ -135,6 +165,8 @@ bool svga_init(VideoOptions* video_options)
     }
 
     SDL_SetPaletteColors(gSdlSurface->format->palette, colors, 0, 256);
+    refreshPaletteLut();
+    renderAddDirtyRect(NULL);
 
     scr_size.ulx = 0;
     scr_size.uly = 0;
@@ -193,19 +225,23 @@ static bool createRenderer(int width, int height)
         return false;
     }
 
-    gSdlTextureSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, SDL_BITSPERPIXEL(format), format);
-    if (gSdlTextureSurface == NULL) {
+    gSdlTextureFormat = SDL_AllocFormat(format);
+    if (gSdlTextureFormat == NULL) {
         return false;
     }
 
+    // Texture content is lost, it needs to be expanded from scratch.
+    refreshPaletteLut();
+    renderAddDirtyRect(NULL);
+
     return true;
 }
 
 static void destroyRenderer()
 {
-    if (gSdlTextureSurface != NULL) {
-        SDL_FreeSurface(gSdlTextureSurface);
-        gSdlTextureSurface = NULL;
+    if (gSdlTextureFormat != NULL) {
+        SDL_FreeFormat(gSdlTextureFormat);
+        gSdlTextureFormat = NULL;
     }
 
     if (gSdlTexture != NULL) {
@@ -225,11 +261,139 @@ void handleWindowSizeChanged()
     createRenderer(screenGetWidth(), screenGetHeight());
 }
 
+// Rebuilds palette lookup table from `gSdlSurface` palette.
+static void refreshPaletteLut()
+{
+    if (gSdlSurface == NULL || gSdlSurface->format->palette == NULL || gSdlTextureFormat == NULL) {
+        return;
+    }
+
+    SDL_Palette* palette = gSdlSurface->format->palette;
+    for (int index = 0; index < 256 && index < palette->ncolors; index++) {
+        SDL_Color* color = &(palette->colors[index]);
+        gPaletteLut[index] = SDL_MapRGB(gSdlTextureFormat, color->r, color->g, color->b);
+    }
+}
+
+// Marks area of `gSdlSurface` as changed, it will be uploaded to the
+// texture on the next present. Pass `NULL` to mark entire screen.
+void renderAddDirtyRect(const SDL_Rect* rect)
+{
+    if (gSdlSurface == NULL) {
+        return;
+    }
+
+    SDL_Rect screenRect;
+    screenRect.x = 0;
+    screenRect.y = 0;
+    screenRect.w = gSdlSurface->w;
+    screenRect.h = gSdlSurface->h;
+
+    SDL_Rect dirtyRect;
+    if (rect == NULL) {
+        dirtyRect = screenRect;
+    } else if (!SDL_IntersectRect(rect, &screenRect, &dirtyRect)) {
+        return;
+    }
+
+    // Merge with the first overlapping rect, adjacent updates (such as mouse
+    // cursor trails) usually end up in the same rect.
+    for (int index = 0; index < gDirtyRectsLength; index++) {
+        SDL_Rect* other = &(gDirtyRects[index]);
+        if (SDL_HasIntersection(other, &dirtyRect)) {
+            SDL_UnionRect(other, &dirtyRect, other);
+            return;
+        }
+    }
+
+    if (gDirtyRectsLength == DIRTY_RECTS_CAPACITY) {
+        for (int index = 1; index < gDirtyRectsLength; index++) {
+            SDL_UnionRect(&(gDirtyRects[0]), &(gDirtyRects[index]), &(gDirtyRects[0]));
+        }
+        SDL_UnionRect(&(gDirtyRects[0]), &dirtyRect, &(gDirtyRects[0]));
+        gDirtyRectsLength = 1;
+        return;
+    }
+
+    gDirtyRects[gDirtyRectsLength++] = dirtyRect;
+}
+
+// Expands palettized pixels of `gSdlSurface` in given rect directly into
+// locked area of `gSdlTexture`.
+static void renderUploadRect(const SDL_Rect* rect)
+{
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(gSdlTexture, rect, &pixels, &pitch) != 0) {
+        return;
+    }
+
+    const unsigned char* src = (const unsigned char*)gSdlSurface->pixels + gSdlSurface->pitch * rect->y + rect->x;
+    unsigned char* dest = (unsigned char*)pixels;
+
+    // NOTE: Palette lookup is a gather, which neither SSE2 nor NEON can do
+    // faster than plain loads, so the loop is just unrolled to let compiler
+    // interleave loads and stores.
+    for (int y = 0; y < rect->h; y++) {
+        Uint32* destPixels = (Uint32*)dest;
+        int x = 0;
+        for (; x + 4 <= rect->w; x += 4) {
+            Uint32 p0 = gPaletteLut[src[x]];
+            Uint32 p1 = gPaletteLut[src[x + 1]];
+            Uint32 p2 = gPaletteLut[src[x + 2]];
+            Uint32 p3 = gPaletteLut[src[x + 3]];
+            destPixels[x] = p0;
+            destPixels[x + 1] = p1;
+            destPixels[x + 2] = p2;
+            destPixels[x + 3] = p3;
+        }
+
+        for (; x < rect->w; x++) {
+            destPixels[x] = gPaletteLut[src[x]];
+        }
+
+        src += gSdlSurface->pitch;
+        dest += pitch;
+    }
+
+    SDL_UnlockTexture(gSdlTexture);
+}
+
+// Outlines given areas on top of the screen on the next present. Used to
+// debug window compositor, outlines are not part of `gSdlSurface`.
+void renderShowRepaints(const Rect* rects, int count)
+{
+    for (int index = 0; index < count && gRepaintRectsLength < DIRTY_RECTS_CAPACITY; index++) {
+        SDL_Rect* repaintRect = &(gRepaintRects[gRepaintRectsLength++]);
+        repaintRect->x = rects[index].ulx;
+        repaintRect->y = rects[index].uly;
+        repaintRect->w = rectGetWidth(&(rects[index]));
+        repaintRect->h = rectGetHeight(&(rects[index]));
+    }
+}
+
 void renderPresent()
 {
-    SDL_UpdateTexture(gSdlTexture, NULL, gSdlTextureSurface->pixels, gSdlTextureSurface->pitch);
+    ProfilerZone zone("renderPresent");
+
+    // CE: Paint window changes collected during the frame.
+    win_compose();
+
+    for (int index = 0; index < gDirtyRectsLength; index++) {
+        renderUploadRect(&(gDirtyRects[index]));
+    }
+    gDirtyRectsLength = 0;
+
     SDL_RenderClear(gSdlRenderer);
     SDL_RenderCopy(gSdlRenderer, gSdlTexture, NULL, NULL);
+
+    if (gRepaintRectsLength != 0) {
+        SDL_SetRenderDrawColor(gSdlRenderer, 255, 0, 255, 255);
+        SDL_RenderDrawRects(gSdlRenderer, gRepaintRects, gRepaintRectsLength);
+        SDL_SetRenderDrawColor(gSdlRenderer, 0, 0, 0, 255);
+        gRepaintRectsLength = 0;
+    }
+
     SDL_RenderPresent(gSdlRenderer);
 }
 
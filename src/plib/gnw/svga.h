@@ -16,7 +16,6 @@ extern SDL_Window* gSdlWindow;
 extern SDL_Surface* gSdlSurface;
 extern SDL_Renderer* gSdlRenderer;
 extern SDL_Texture* gSdlTexture;
-extern SDL_Surface* gSdlTextureSurface;
 extern FpsLimiter sharedFpsLimiter;
 
 void GNW95_SetPaletteEntries(unsigned char* a1, int a2, int a3);
@@ -28,6 +27,8 @@ void svga_exit();
 int screenGetWidth();
 int screenGetHeight();
 void handleWindowSizeChanged();
+void renderAddDirtyRect(const SDL_Rect* rect);
+void renderShowRepaints(const Rect* rects, int count);
 void renderPresent();
 
 } // namespace fallout
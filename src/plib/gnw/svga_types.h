@@ -19,6 +19,8 @@ typedef struct VideoOptions {
     int height;
     bool fullscreen;
     int scale;
+    // CE: Render into a hidden window of the dummy video driver.
+    bool headless;
 } VideoOptions;
 
 } // namespace fallout
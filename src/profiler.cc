@@ -0,0 +1,231 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <SDL.h>
+
+#include "platform_compat.h"
+#include "plib/gnw/debug.h"
+
+namespace fallout {
+
+// Number of finished zones kept per thread, older ones are overwritten.
+#define PROFILER_RING_SIZE 65536
+
+// Zones nested deeper than this are not recorded.
+#define PROFILER_MAX_DEPTH 64
+
+typedef struct ProfilerEvent {
+    const char* name;
+    Uint64 start;
+    Uint64 end;
+} ProfilerEvent;
+
+typedef struct ProfilerThread {
+    // Guards `events` and `count` against `profilerStart` and `profilerStop`
+    // run from main thread.
+    std::mutex mutex;
+    int id;
+    bool main;
+    std::vector<ProfilerEvent> events;
+    size_t count;
+
+    // Zones that are not finished yet, only touched by the owning thread.
+    const char* names[PROFILER_MAX_DEPTH];
+    Uint64 starts[PROFILER_MAX_DEPTH];
+    int depth;
+} ProfilerThread;
+
+static ProfilerThread* profilerGetThread();
+static bool profilerWriteTrace();
+
+std::atomic<bool> gProfilerCapturing(false);
+
+static char gProfilerOutputPath[COMPAT_MAX_PATH];
+static std::thread::id gProfilerMainThreadId;
+
+// Performance counter value when capture was started, trace timestamps are
+// relative to it.
+static Uint64 gProfilerCaptureStart;
+
+// Buffers of every thread that has ever recorded a zone. They are never freed
+// because threads keep pointers to them in `gProfilerCurrentThread`.
+static std::mutex gProfilerThreadsMutex;
+static std::vector<ProfilerThread*> gProfilerThreads;
+
+static thread_local ProfilerThread* gProfilerCurrentThread = nullptr;
+
+void profilerInit(const char* outputPath)
+{
+    strncpy(gProfilerOutputPath, outputPath, sizeof(gProfilerOutputPath) - 1);
+    gProfilerMainThreadId = std::this_thread::get_id();
+}
+
+void profilerExit()
+{
+    if (gProfilerCapturing.load()) {
+        profilerStop();
+    }
+}
+
+void profilerStart()
+{
+    if (gProfilerCapturing.load()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> threadsLock(gProfilerThreadsMutex);
+    for (ProfilerThread* thread : gProfilerThreads) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        thread->count = 0;
+    }
+
+    gProfilerCaptureStart = SDL_GetPerformanceCounter();
+    gProfilerCapturing.store(true);
+
+    debug_printf("Profiler: capture started\n");
+}
+
+void profilerStop()
+{
+    if (!gProfilerCapturing.load()) {
+        return;
+    }
+
+    gProfilerCapturing.store(false);
+
+    if (profilerWriteTrace()) {
+        debug_printf("Profiler: capture saved to %s\n", gProfilerOutputPath);
+    } else {
+        debug_printf("Profiler: unable to save capture to %s\n", gProfilerOutputPath);
+    }
+}
+
+void profilerToggle()
+{
+    if (gProfilerCapturing.load()) {
+        profilerStop();
+    } else {
+        profilerStart();
+    }
+}
+
+void profilerBeginZone(const char* name)
+{
+    ProfilerThread* thread = profilerGetThread();
+    if (thread->depth < PROFILER_MAX_DEPTH) {
+        thread->names[thread->depth] = name;
+        thread->starts[thread->depth] = SDL_GetPerformanceCounter();
+    }
+    thread->depth++;
+}
+
+void profilerEndZone()
+{
+    ProfilerThread* thread = profilerGetThread();
+    if (thread->depth == 0) {
+        return;
+    }
+
+    thread->depth--;
+    if (thread->depth >= PROFILER_MAX_DEPTH) {
+        return;
+    }
+
+    Uint64 end = SDL_GetPerformanceCounter();
+
+    std::lock_guard<std::mutex> lock(thread->mutex);
+    ProfilerEvent* event = &(thread->events[thread->count % PROFILER_RING_SIZE]);
+    event->name = thread->names[thread->depth];
+    event->start = thread->starts[thread->depth];
+    event->end = end;
+    thread->count++;
+}
+
+// Returns number of zones open on the calling thread.
+int profilerZoneDepth()
+{
+    return gProfilerCurrentThread != nullptr ? gProfilerCurrentThread->depth : 0;
+}
+
+// Drops zones of the calling thread above `depth` without recording them. This
+// is needed when `longjmp` skips `profilerEndZone` calls of the frames it leaves.
+void profilerUnwindZones(int depth)
+{
+    if (gProfilerCurrentThread != nullptr && gProfilerCurrentThread->depth > depth) {
+        gProfilerCurrentThread->depth = depth;
+    }
+}
+
+static ProfilerThread* profilerGetThread()
+{
+    if (gProfilerCurrentThread == nullptr) {
+        ProfilerThread* thread = new ProfilerThread();
+        thread->events.resize(PROFILER_RING_SIZE);
+        thread->count = 0;
+        thread->depth = 0;
+        thread->main = std::this_thread::get_id() == gProfilerMainThreadId;
+
+        std::lock_guard<std::mutex> lock(gProfilerThreadsMutex);
+        thread->id = static_cast<int>(gProfilerThreads.size()) + 1;
+        gProfilerThreads.push_back(thread);
+
+        gProfilerCurrentThread = thread;
+    }
+
+    return gProfilerCurrentThread;
+}
+
+// Writes zones in Chrome trace event format (loads in `chrome://tracing` and
+// Perfetto).
+static bool profilerWriteTrace()
+{
+    FILE* stream = compat_fopen(gProfilerOutputPath, "wt");
+    if (stream == NULL) {
+        return false;
+    }
+
+    double ticksPerUs = static_cast<double>(SDL_GetPerformanceFrequency()) / 1000000.0;
+    bool first = true;
+
+    fprintf(stream, "{\"traceEvents\":[");
+
+    std::lock_guard<std::mutex> threadsLock(gProfilerThreadsMutex);
+    for (ProfilerThread* thread : gProfilerThreads) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+
+        fprintf(stream, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+            first ? "" : ",",
+            thread->id,
+            thread->main ? "main" : "thread",
+            thread->id);
+        first = false;
+
+        // Oldest event is the one that is going to be overwritten next.
+        size_t begin = thread->count > PROFILER_RING_SIZE ? thread->count - PROFILER_RING_SIZE : 0;
+        for (size_t index = begin; index < thread->count; index++) {
+            ProfilerEvent* event = &(thread->events[index % PROFILER_RING_SIZE]);
+            if (event->start < gProfilerCaptureStart) {
+                continue;
+            }
+
+            fprintf(stream, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event->name,
+                thread->id,
+                static_cast<double>(event->start - gProfilerCaptureStart) / ticksPerUs,
+                static_cast<double>(event->end - event->start) / ticksPerUs);
+        }
+    }
+
+    fprintf(stream, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(stream);
+
+    return true;
+}
+
+} // namespace fallout
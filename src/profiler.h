@@ -0,0 +1,54 @@
+#ifndef FALLOUT_PROFILER_H_
+#define FALLOUT_PROFILER_H_
+
+#include <atomic>
+
+namespace fallout {
+
+// Set while capture is running, zones started when it's not set are ignored.
+extern std::atomic<bool> gProfilerCapturing;
+
+void profilerInit(const char* outputPath);
+void profilerExit();
+void profilerStart();
+void profilerStop();
+void profilerToggle();
+void profilerBeginZone(const char* name);
+void profilerEndZone();
+int profilerZoneDepth();
+void profilerUnwindZones(int depth);
+
+// Measures enclosing scope as zone `name`. Zones nest, the trace shows them
+// as a hierarchy per thread. `name` must be a string literal (only pointer
+// is kept).
+//
+// Don't use it in frames that can be left with `longjmp` (script errors), the
+// destructor is not run there. Call `profilerBeginZone` and `profilerEndZone`
+// instead.
+class ProfilerZone {
+public:
+    explicit ProfilerZone(const char* name)
+        : _active(gProfilerCapturing.load(std::memory_order_relaxed))
+    {
+        if (_active) {
+            profilerBeginZone(name);
+        }
+    }
+
+    ~ProfilerZone()
+    {
+        if (_active) {
+            profilerEndZone();
+        }
+    }
+
+    ProfilerZone(const ProfilerZone&) = delete;
+    ProfilerZone& operator=(const ProfilerZone&) = delete;
+
+private:
+    const bool _active;
+};
+
+} // namespace fallout
+
+#endif /* FALLOUT_PROFILER_H_ */
@@ -0,0 +1,180 @@
+// Checks assoc array lookups through the hash index against the sorted list,
+// and reports build and lookup times for a DAT-directory-sized array.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "plib/assoc/assoc.h"
+#include "platform_compat.h"
+
+using namespace fallout;
+
+#define ENTRY_COUNT 5000
+#define LOOKUP_ROUNDS 20
+
+static int failures;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #condition);                                               \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static unsigned int seed = 12345;
+
+static int nextRandom(int max)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % max;
+}
+
+static double elapsedMicroseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Art-style names, e.g. "art\critters\HMJMPSAA.FRM".
+static std::vector<std::string> makeNames()
+{
+    static const char* const directories[] = {
+        "art\\critters\\",
+        "art\\items\\",
+        "art\\tiles\\",
+        "sound\\sfx\\",
+        "scripts\\",
+    };
+
+    std::vector<std::string> names;
+    for (int index = 0; index < ENTRY_COUNT; index++) {
+        char name[64];
+        snprintf(name, sizeof(name), "%s%c%c%05d.FRM",
+            directories[nextRandom(5)],
+            'A' + nextRandom(26),
+            'A' + nextRandom(26),
+            index);
+        names.push_back(name);
+    }
+
+    return names;
+}
+
+static bool isSorted(assoc_array* a)
+{
+    for (int index = 1; index < a->size; index++) {
+        if (compat_stricmp(a->list[index - 1].name, a->list[index].name) >= 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Checks every name in [names] is found at the position it has in the sorted
+// list, in any letter case.
+static void checkLookups(assoc_array* a, const std::vector<std::string>& names, size_t count)
+{
+    for (size_t index = 0; index < count; index++) {
+        std::string lower = names[index];
+        for (char& ch : lower) {
+            ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        }
+
+        int position = assoc_search(a, lower.c_str());
+        CHECK(position != -1);
+        if (position != -1) {
+            CHECK(compat_stricmp(a->list[position].name, names[index].c_str()) == 0);
+            CHECK(*static_cast<int*>(a->list[position].data) == static_cast<int>(index));
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> names = makeNames();
+
+    assoc_array a;
+    CHECK(assoc_init(&a, 10, sizeof(int), NULL) == 0);
+
+    // Config-style build, every insert is preceded by a lookup of the same
+    // key, so the index is live while the array grows.
+    auto start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < names.size(); index++) {
+        int value = static_cast<int>(index);
+        CHECK(assoc_search(&a, names[index].c_str()) == -1);
+        CHECK(assoc_insert(&a, names[index].c_str(), &value) == 0);
+    }
+    double buildTime = elapsedMicroseconds(start);
+
+    CHECK(a.size == ENTRY_COUNT);
+    CHECK(isSorted(&a));
+    CHECK(assoc_insert(&a, names[0].c_str(), NULL) == -1);
+    checkLookups(&a, names, names.size());
+
+    // Deleting marks index stale, it must be rebuilt on next lookup.
+    for (size_t index = 0; index < names.size(); index += 2) {
+        CHECK(assoc_delete(&a, names[index].c_str()) == 0);
+    }
+
+    for (size_t index = 0; index < names.size(); index++) {
+        int position = assoc_search(&a, names[index].c_str());
+        if (index % 2 == 0) {
+            CHECK(position == -1);
+        } else {
+            CHECK(position != -1 && *static_cast<int*>(a.list[position].data) == static_cast<int>(index));
+        }
+    }
+
+    CHECK(isSorted(&a));
+    assoc_free(&a);
+
+    // File-list-style build, inserts only.
+    assoc_array b;
+    CHECK(assoc_init(&b, 10, sizeof(int), NULL) == 0);
+
+    start = std::chrono::steady_clock::now();
+    for (size_t index = 0; index < names.size(); index++) {
+        int value = static_cast<int>(index);
+        CHECK(assoc_insert(&b, names[index].c_str(), &value) == 0);
+    }
+    double insertTime = elapsedMicroseconds(start);
+
+    CHECK(isSorted(&b));
+    checkLookups(&b, names, names.size());
+
+    int found = 0;
+    start = std::chrono::steady_clock::now();
+    for (int round = 0; round < LOOKUP_ROUNDS; round++) {
+        for (size_t index = 0; index < names.size(); index++) {
+            if (assoc_search(&b, names[index].c_str()) != -1) {
+                found++;
+            }
+        }
+    }
+    double lookupTime = elapsedMicroseconds(start);
+
+    CHECK(found == LOOKUP_ROUNDS * ENTRY_COUNT);
+
+    assoc_free(&b);
+
+    printf("assoc_test: %d entries, build with lookups %.0f us, build %.0f us, %.3f us per lookup\n",
+        ENTRY_COUNT,
+        buildTime,
+        insertTime,
+        lookupTime / (LOOKUP_ROUNDS * ENTRY_COUNT));
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("assoc_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,298 @@
+// Replays an art-fid access trace through a small cache, checks hits, misses
+// and resident entries against a model of the eviction policy, and reports
+// time per access.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include "game/cache.h"
+#include "int/sound.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/memory.h"
+
+namespace fallout {
+
+// Stubs for the parts of the game the cache does not need here.
+
+void soundUpdate()
+{
+}
+
+int debug_printf(const char* format, ...)
+{
+    return 0;
+}
+
+void* mem_malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void* mem_realloc(void* ptr, size_t size)
+{
+    return realloc(ptr, size);
+}
+
+void mem_free(void* ptr)
+{
+    free(ptr);
+}
+
+} // namespace fallout
+
+using namespace fallout;
+
+// All entries have the same size (about the size of a critter animation),
+// so freed heap blocks always fit new entries, and block overhead of at most
+// 32 resident entries fits into the slack `heap_init` adds to cache size.
+// This way every eviction is decided by the cache alone.
+#define CACHE_SIZE (1024 * 1024)
+#define FID_SIZE 32000
+#define FID_COUNT 400
+#define HOT_FID_COUNT 24
+#define PINNED_FID_COUNT 4
+#define ACCESS_COUNT 200000
+
+static int failures;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #condition);                                               \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static unsigned int seed = 12345;
+
+static int nextRandom(int max)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % max;
+}
+
+static double elapsedMicroseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Critter, scenery and tile fids (type in bits 24-27, animation in bits
+// 16-23, frm list index in bits 0-11).
+static int makeFid(int index)
+{
+    int type = index % 3 == 0 ? 1 : (index % 3 == 1 ? 2 : 4);
+    int anim = type == 1 ? index % 20 : 0;
+    return (type << 24) | (anim << 16) | (index & 0xFFF);
+}
+
+static int reads;
+
+static int cacheSizeProc(int key, int* sizePtr)
+{
+    *sizePtr = FID_SIZE;
+    return 0;
+}
+
+static int cacheReadProc(int key, int* sizePtr, unsigned char* buffer)
+{
+    reads++;
+    *sizePtr = FID_SIZE;
+    memcpy(buffer, &key, sizeof(key));
+    return 0;
+}
+
+static void cacheFreeProc(void* ptr)
+{
+}
+
+// Model of the eviction policy: when the new entry does not fit, evict
+// unreferenced entries with fewest hits (least recently used first) until
+// the new entry plus 20% of the cache is freed.
+
+typedef struct ModelEntry {
+    int size;
+    unsigned int hits;
+    unsigned int mru;
+    int references;
+} ModelEntry;
+
+static std::map<int, ModelEntry> model;
+static int modelSize;
+static unsigned int modelCounter;
+
+static void modelMakeRoom(int size)
+{
+    if (CACHE_SIZE - modelSize >= size) {
+        return;
+    }
+
+    int threshold = size + (int)((double)modelSize * 0.2);
+
+    std::vector<std::pair<std::pair<unsigned int, unsigned int>, int>> candidates;
+    for (auto& it : model) {
+        if (it.second.references == 0) {
+            candidates.push_back({ { it.second.hits, it.second.mru }, it.first });
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    int accum = 0;
+    std::vector<int> taken;
+    for (auto& candidate : candidates) {
+        taken.push_back(candidate.second);
+        accum += model[candidate.second].size;
+        if (accum >= threshold) {
+            break;
+        }
+    }
+
+    for (int key : taken) {
+        modelSize -= model[key].size;
+        model.erase(key);
+    }
+}
+
+static void modelLock(int key, int* hits, int* misses)
+{
+    auto it = model.find(key);
+    if (it != model.end()) {
+        it->second.hits++;
+        (*hits)++;
+    } else {
+        int size = FID_SIZE;
+        modelMakeRoom(size);
+
+        ModelEntry entry;
+        entry.size = size;
+        entry.hits = 0;
+        entry.references = 0;
+        it = model.insert({ key, entry }).first;
+        modelSize += size;
+        (*misses)++;
+    }
+
+    it->second.references++;
+    modelCounter++;
+    it->second.mru = modelCounter;
+}
+
+static void modelUnlock(int key)
+{
+    model[key].references--;
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<int> fids;
+    for (int index = 0; index < FID_COUNT; index++) {
+        fids.push_back(makeFid(index));
+    }
+
+    // Mostly the hot set (critters on screen), with a tail of everything
+    // else, like scrolling across a map.
+    std::vector<int> trace;
+    for (int access = 0; access < ACCESS_COUNT; access++) {
+        if (nextRandom(10) < 8) {
+            trace.push_back(fids[nextRandom(HOT_FID_COUNT)]);
+        } else {
+            trace.push_back(fids[nextRandom(FID_COUNT)]);
+        }
+    }
+
+    Cache cache;
+    CHECK(cache_init(&cache, cacheSizeProc, cacheReadProc, cacheFreeProc, CACHE_SIZE));
+
+    int expectedHits = 0;
+    int expectedMisses = 0;
+
+    // Pinned entries stay referenced for the whole replay, like art of the
+    // interface windows, they must never be evicted.
+    CacheEntry* pinned[PINNED_FID_COUNT];
+    for (int index = 0; index < PINNED_FID_COUNT; index++) {
+        int key = fids[FID_COUNT - 1 - index];
+        void* data;
+        CHECK(cache_lock(&cache, key, &data, &(pinned[index])));
+        modelLock(key, &expectedHits, &expectedMisses);
+    }
+
+    int dataErrors = 0;
+    int lockErrors = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int key : trace) {
+        void* data;
+        CacheEntry* entry;
+        if (!cache_lock(&cache, key, &data, &entry)) {
+            lockErrors++;
+            continue;
+        }
+
+        if (memcmp(data, &key, sizeof(key)) != 0) {
+            dataErrors++;
+        }
+
+        cache_unlock(&cache, entry);
+    }
+    double replayTime = elapsedMicroseconds(start);
+
+    for (int key : trace) {
+        modelLock(key, &expectedHits, &expectedMisses);
+        modelUnlock(key);
+    }
+
+    CHECK(lockErrors == 0);
+    CHECK(dataErrors == 0);
+
+    int misses = reads;
+    int hits = ACCESS_COUNT + PINNED_FID_COUNT - misses;
+    CHECK(misses == expectedMisses);
+    CHECK(hits == expectedHits);
+
+    int size;
+    CHECK(cache_size(&cache, &size) == 1);
+    CHECK(size == modelSize);
+    CHECK(size <= CACHE_SIZE);
+
+    int resident = 0;
+    for (int key : fids) {
+        bool present = cache_query(&cache, key) == 1;
+        bool expected = model.find(key) != model.end();
+        if (present != expected) {
+            fprintf(stderr, "fid %08x: resident %d, expected %d\n", key, present, expected);
+            failures++;
+        }
+
+        if (present) {
+            resident++;
+        }
+    }
+
+    for (int index = 0; index < PINNED_FID_COUNT; index++) {
+        CHECK(cache_query(&cache, fids[FID_COUNT - 1 - index]) == 1);
+        CHECK(cache_unlock(&cache, pinned[index]));
+    }
+
+    CHECK(cache_exit(&cache));
+
+    printf("cache_test: %d accesses, %d hits, %d misses, %d resident, %.3f us per access\n",
+        ACCESS_COUNT,
+        hits,
+        misses,
+        resident,
+        replayTime / ACCESS_COUNT);
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("cache_test: ok\n");
+    return 0;
+}
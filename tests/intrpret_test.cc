@@ -0,0 +1,301 @@
+// Checks that the decoded instruction cache in `interpret` produces the same
+// results as the plain `op_const` handler path, on cold and warm caches.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+
+#include "int/intlib.h"
+#include "int/intrpret.h"
+#include "plib/color/color.h"
+#include "plib/db/db.h"
+#include "plib/gnw/debug.h"
+#include "plib/gnw/input.h"
+#include "plib/gnw/mouse.h"
+
+namespace fallout {
+
+// Stubs for the parts of the game the interpreter core does not need here.
+
+unsigned char cmap[768];
+
+static std::vector<unsigned char> gImage;
+static size_t gImagePos;
+
+void initIntlib()
+{
+}
+
+void intlibClose()
+{
+}
+
+void updateIntLib()
+{
+}
+
+void interpretRegisterProgramDeleteCallback(IntLibProgramDeleteCallback* callback)
+{
+}
+
+void removeProgramReferences(Program* program)
+{
+}
+
+void mouse_show()
+{
+}
+
+void fadeSystemPalette(unsigned char* oldPalette, unsigned char* newPalette, int steps)
+{
+}
+
+int debug_printf(const char* format, ...)
+{
+    return 0;
+}
+
+unsigned int get_time()
+{
+    return 0;
+}
+
+DB_FILE* db_fopen(const char* filename, const char* mode)
+{
+    gImagePos = 0;
+    return reinterpret_cast<DB_FILE*>(&gImage);
+}
+
+size_t db_fread(void* buf, size_t size, size_t count, DB_FILE* stream)
+{
+    size_t length = size * count;
+    if (length > gImage.size() - gImagePos) {
+        length = gImage.size() - gImagePos;
+    }
+
+    memcpy(buf, gImage.data() + gImagePos, length);
+    gImagePos += length;
+
+    return size != 0 ? length / size : 0;
+}
+
+long db_filelength(DB_FILE* stream)
+{
+    return static_cast<long>(gImage.size());
+}
+
+int db_fclose(DB_FILE* stream)
+{
+    return 0;
+}
+
+} // namespace fallout
+
+using namespace fallout;
+
+#define LOOP_COUNT 1000
+
+static int failures;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #condition);                                               \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static void emitWord(int value)
+{
+    gImage.push_back((value >> 8) & 0xFF);
+    gImage.push_back(value & 0xFF);
+}
+
+static void emitLong(int value)
+{
+    emitWord((value >> 16) & 0xFFFF);
+    emitWord(value & 0xFFFF);
+}
+
+static void emitPush(int type, int value)
+{
+    emitWord(type);
+    emitLong(value);
+}
+
+static void patchLong(size_t pos, int value)
+{
+    gImage[pos] = (value >> 24) & 0xFF;
+    gImage[pos + 1] = (value >> 16) & 0xFF;
+    gImage[pos + 2] = (value >> 8) & 0xFF;
+    gImage[pos + 3] = value & 0xFF;
+}
+
+static int floatBits(float value)
+{
+    int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// Builds script equivalent to:
+//
+//   acc = 0;
+//   for (i = LOOP_COUNT; i != 0; i--) {
+//       acc = ((acc * 31) ^ i) & 0xFFFF;
+//   }
+//
+// Every push in it carries value type tag, the same way compiled scripts do.
+static void buildImage()
+{
+    gImage.clear();
+
+    // Code at offset 0 jumps over header and tables.
+    emitPush(VALUE_TYPE_INT, 0);
+    emitWord(OPCODE_JUMP);
+    gImage.resize(42);
+
+    // Procedures, identifiers and static strings (all empty).
+    emitLong(0);
+    emitLong(0);
+    emitLong(0);
+
+    patchLong(2, static_cast<int>(gImage.size()));
+
+    emitWord(OPCODE_SET_GLOBAL);
+    emitPush(VALUE_TYPE_INT, 0);
+    emitPush(VALUE_TYPE_INT, LOOP_COUNT);
+
+    int loop = static_cast<int>(gImage.size());
+    size_t endPos = gImage.size() + 2;
+    emitPush(VALUE_TYPE_INT, 0);
+    emitPush(VALUE_TYPE_INT, 1);
+    emitWord(OPCODE_FETCH_GLOBAL);
+    emitWord(OPCODE_IF);
+
+    emitPush(VALUE_TYPE_INT, 0);
+    emitWord(OPCODE_FETCH_GLOBAL);
+    emitPush(VALUE_TYPE_INT, 31);
+    emitWord(OPCODE_MUL);
+    emitPush(VALUE_TYPE_INT, 1);
+    emitWord(OPCODE_FETCH_GLOBAL);
+    emitWord(OPCODE_BITWISE_XOR);
+    emitPush(VALUE_TYPE_INT, 0xFFFF);
+    emitWord(OPCODE_BITWISE_AND);
+    emitPush(VALUE_TYPE_INT, 0);
+    emitWord(OPCODE_STORE_GLOBAL);
+
+    emitPush(VALUE_TYPE_FLOAT, floatBits(0.5f));
+    emitWord(OPCODE_POP);
+
+    emitPush(VALUE_TYPE_INT, 1);
+    emitWord(OPCODE_FETCH_GLOBAL);
+    emitPush(VALUE_TYPE_INT, 1);
+    emitWord(OPCODE_SUB);
+    emitPush(VALUE_TYPE_INT, 1);
+    emitWord(OPCODE_STORE_GLOBAL);
+
+    emitPush(VALUE_TYPE_INT, loop);
+    emitWord(OPCODE_JUMP);
+
+    patchLong(endPos, static_cast<int>(gImage.size()));
+    emitPush(VALUE_TYPE_FLOAT, floatBits(1.5f));
+    emitWord(OPCODE_EXIT_PROGRAM);
+}
+
+// Same as `op_const`, but not recognized by `interpret` fast path.
+static void referenceConst(Program* program)
+{
+    unsigned char* data = program->data + program->instructionPointer;
+    program->instructionPointer += 4;
+
+    ProgramValue result;
+    result.opcode = (program->flags >> 16) & 0xFFFF;
+    result.integerValue = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+    programStackPushValue(program, result);
+}
+
+static void runToExit(Program* program, ProgramStack& stack)
+{
+    program->instructionPointer = 0;
+    program->basePointer = -1;
+    program->framePointer = -1;
+    program->flags = 0;
+    program->stackValues->clear();
+    program->returnStackValues->clear();
+
+    interpret(program, -1);
+
+    stack = *program->stackValues;
+}
+
+static bool sameStack(const ProgramStack& a, const ProgramStack& b)
+{
+    if (a.size() != b.size()) {
+        return false;
+    }
+
+    for (size_t index = 0; index < a.size(); index++) {
+        if (a[index].opcode != b[index].opcode || a[index].integerValue != b[index].integerValue) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    int expected = 0;
+    for (int i = LOOP_COUNT; i != 0; i--) {
+        expected = ((expected * 31) ^ i) & 0xFFFF;
+    }
+
+    buildImage();
+    initInterpreter();
+
+    Program* program = allocateProgram("test.int");
+    CHECK(program != NULL);
+    if (program == NULL) {
+        return 1;
+    }
+
+    ProgramStack cold;
+    ProgramStack warm;
+    ProgramStack reference;
+
+    runToExit(program, cold);
+    runToExit(program, warm);
+
+    interpretAddFunc(OPCODE_PUSH, referenceConst);
+    runToExit(program, reference);
+
+    CHECK((program->flags & PROGRAM_FLAG_EXITED) != 0);
+    CHECK((program->flags & PROGRAM_FLAG_0x04) == 0);
+
+    CHECK(reference.size() == 3);
+    if (reference.size() == 3) {
+        CHECK(reference[0].opcode == VALUE_TYPE_INT);
+        CHECK(reference[0].integerValue == expected);
+        CHECK(reference[1].opcode == VALUE_TYPE_INT);
+        CHECK(reference[1].integerValue == 0);
+        CHECK(reference[2].opcode == VALUE_TYPE_FLOAT);
+        CHECK(reference[2].floatValue == 1.5f);
+    }
+
+    CHECK(sameStack(cold, reference));
+    CHECK(sameStack(warm, reference));
+
+    interpretFreeProgram(program);
+    interpretClose();
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("intrpret_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,400 @@
+// Checks that `lzss_decode_block` produces exactly the same output as the
+// stdio decoder `lzss_decode_to_buf` on generated streams.
+//
+// When given path to a DAT file (e.g. `lzss_test master.dat`), also decodes
+// every compressed entry of it with both decoders and reports MB/s.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "plib/assoc/assoc.h"
+#include "plib/db/db.h"
+#include "plib/db/lzss.h"
+
+using namespace fallout;
+
+#define STREAM_COUNT 4000
+
+// Chunked DAT entries are split into chunks of this size.
+#define DAT_CHUNK_SIZE 0x4000
+
+static int failures;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #condition);                                               \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static unsigned int seed = 12345;
+
+static int nextRandom(int max)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % max;
+}
+
+static double elapsedSeconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Builds well-formed stream of random literals and back-references. Offsets
+// are random too, so references land on dictionary slots this stream has not
+// written yet, and overlapping copies are common.
+static std::vector<unsigned char> makeRandomStream()
+{
+    std::vector<unsigned char> stream;
+    int groups = nextRandom(nextRandom(10) == 0 ? 600 : 40);
+    for (int group = 0; group < groups; group++) {
+        int flags = nextRandom(4) == 0 ? 0xFF : nextRandom(256);
+        stream.push_back(flags);
+
+        int items = group == groups - 1 ? 1 + nextRandom(8) : 8;
+        for (int bit = 0; bit < items; bit++) {
+            if ((flags & (1 << bit)) != 0) {
+                stream.push_back(nextRandom(256));
+            } else {
+                int offset = nextRandom(4096);
+                int length = nextRandom(16);
+                stream.push_back(offset & 0xFF);
+                stream.push_back(((offset >> 4) & 0xF0) | length);
+            }
+        }
+    }
+
+    return stream;
+}
+
+// Builds data resembling game files (text, runs of bytes, noise), for
+// `lzss_encode_block`.
+static std::vector<unsigned char> makeData()
+{
+    static const char* const words[] = { "critter", "item", "door", "map", "script", "\r\n", " ", "=" };
+
+    std::vector<unsigned char> data;
+    int length = nextRandom(nextRandom(10) == 0 ? 65536 : 2048);
+    while ((int)data.size() < length) {
+        int kind = nextRandom(3);
+        if (kind == 0) {
+            const char* word = words[nextRandom(8)];
+            data.insert(data.end(), word, word + strlen(word));
+        } else if (kind == 1) {
+            data.insert(data.end(), 1 + nextRandom(40), nextRandom(256));
+        } else {
+            data.push_back(nextRandom(256));
+        }
+    }
+
+    return data;
+}
+
+// Stream long enough to reset the part of dictionary decoders carry over
+// between calls, so that runs started with it begin in the same state.
+static std::vector<unsigned char> makePrimer()
+{
+    std::vector<unsigned char> primer;
+    for (int group = 0; group < 4; group++) {
+        primer.push_back(0xFF);
+        primer.insert(primer.end(), 8, 'a' + group);
+    }
+    return primer;
+}
+
+static unsigned long long hashBytes(const unsigned char* data, unsigned int length)
+{
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+    for (unsigned int index = 0; index < length; index++) {
+        hash ^= data[index];
+        hash *= 0x100000001B3ULL;
+    }
+    return hash;
+}
+
+static int decodeWithStdio(const std::vector<unsigned char>& stream, unsigned char* dest)
+{
+    FILE* in = tmpfile();
+    if (in == NULL) {
+        return -1;
+    }
+
+    fwrite(stream.data(), 1, stream.size(), in);
+    rewind(in);
+
+    int rc = lzss_decode_to_buf(in, dest, (unsigned int)stream.size());
+
+    fclose(in);
+
+    return rc;
+}
+
+static void checkGeneratedStreams()
+{
+    std::vector<std::vector<unsigned char>> streams;
+    std::vector<std::vector<unsigned char>> inputs;
+
+    streams.push_back(makePrimer());
+    inputs.push_back(std::vector<unsigned char>());
+
+    for (int index = 0; index < STREAM_COUNT; index++) {
+        if (index % 2 == 0) {
+            streams.push_back(makeRandomStream());
+            inputs.push_back(std::vector<unsigned char>());
+        } else {
+            std::vector<unsigned char> data = makeData();
+            std::vector<unsigned char> packed(data.size() + data.size() / 8 + 16);
+            int packedLength = lzss_encode_block(data.data(), (unsigned int)data.size(), packed.data(), (unsigned int)packed.size());
+            CHECK(packedLength >= 0);
+            packed.resize(packedLength >= 0 ? packedLength : 0);
+            streams.push_back(packed);
+            inputs.push_back(data);
+        }
+    }
+
+    // Both runs decode the streams in sequence, since the dictionary tail
+    // left by one decode is visible to the next one.
+    std::vector<std::vector<unsigned char>> expected(streams.size());
+    for (size_t index = 0; index < streams.size(); index++) {
+        std::vector<unsigned char> output(streams[index].size() * 18 + 1);
+        int length = decodeWithStdio(streams[index], output.data());
+        CHECK(length >= 0);
+        output.resize(length >= 0 ? length : 0);
+        expected[index] = output;
+    }
+
+    int mismatches = 0;
+    for (size_t index = 0; index < streams.size(); index++) {
+        std::vector<unsigned char> output(expected[index].size() + 1, 0xCD);
+        int length = lzss_decode_block(streams[index].data(), (unsigned int)streams[index].size(), output.data(), (unsigned int)expected[index].size());
+
+        if (length != (int)expected[index].size()
+            || memcmp(output.data(), expected[index].data(), expected[index].size()) != 0
+            || output[expected[index].size()] != 0xCD) {
+            if (mismatches < 10) {
+                fprintf(stderr, "stream %d: %d bytes decoded, expected %d\n",
+                    (int)index,
+                    length,
+                    (int)expected[index].size());
+            }
+            mismatches++;
+        }
+
+        if (!inputs[index].empty()) {
+            CHECK(expected[index] == inputs[index]);
+        }
+    }
+
+    CHECK(mismatches == 0);
+
+    // Output is capped at given size.
+    std::vector<unsigned char> output(16, 0xCD);
+    CHECK(lzss_decode_block(streams[0].data(), (unsigned int)streams[0].size(), output.data(), 8) == 8);
+    CHECK(output[8] == 0xCD);
+}
+
+static int readDirEntry(FILE* stream, void* buffer, size_t size, int flags)
+{
+    if (size != sizeof(dir_entry)) {
+        return -1;
+    }
+
+    int values[4];
+    for (int index = 0; index < 4; index++) {
+        unsigned char bytes[4];
+        if (fread(bytes, 1, 4, stream) != 4) {
+            return -1;
+        }
+        values[index] = (bytes[0] << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+    }
+
+    dir_entry* de = (dir_entry*)buffer;
+    de->flags = values[0];
+    de->offset = values[1];
+    de->unpacked_length = values[2];
+    de->packed_length = values[3];
+
+    return 0;
+}
+
+// Collects packed blocks of all LZSS-compressed entries of DAT file (whole
+// entries and chunks of chunked entries) along with their unpacked sizes.
+static bool loadDatBlocks(const char* path, FILE* stream, std::vector<long>& offsets, std::vector<unsigned int>& lengths, std::vector<unsigned int>& sizes)
+{
+    assoc_array root;
+    if (assoc_init(&root, 0, sizeof(assoc_array), NULL) != 0 || assoc_load(stream, &root, 0) != 0) {
+        fprintf(stderr, "%s: unable to read directory list\n", path);
+        return false;
+    }
+
+    assoc_func_list funcs;
+    funcs.loadFunc = readDirEntry;
+    funcs.saveFunc = NULL;
+    funcs.loadFuncDB = NULL;
+    funcs.saveFuncDB = NULL;
+
+    std::vector<dir_entry> entries;
+    for (int dir = 0; dir < root.size; dir++) {
+        assoc_array files;
+        if (assoc_init(&files, 0, sizeof(dir_entry), &funcs) != 0 || assoc_load(stream, &files, 0) != 0) {
+            fprintf(stderr, "%s: unable to read directory %s\n", path, root.list[dir].name);
+            assoc_free(&root);
+            return false;
+        }
+
+        for (int index = 0; index < files.size; index++) {
+            entries.push_back(*(dir_entry*)files.list[index].data);
+        }
+
+        assoc_free(&files);
+    }
+
+    assoc_free(&root);
+
+    for (const dir_entry& de : entries) {
+        if ((de.flags & 0xF0) == 16) {
+            offsets.push_back(de.offset);
+            lengths.push_back(de.packed_length);
+            sizes.push_back(de.unpacked_length);
+        } else if ((de.flags & 0xF0) == 64) {
+            // Every chunk starts with big-endian packed length, high bit
+            // marks stored chunk.
+            long offset = de.offset;
+            for (int left = de.unpacked_length; left > 0; left -= DAT_CHUNK_SIZE) {
+                unsigned char header[2];
+                if (fseek(stream, offset, SEEK_SET) != 0 || fread(header, 1, 2, stream) != 2) {
+                    break;
+                }
+
+                unsigned int length = ((header[0] << 8) | header[1]) & 0x7FFF;
+                if ((header[0] & 0x80) == 0) {
+                    offsets.push_back(offset + 2);
+                    lengths.push_back(length);
+                    sizes.push_back(left < DAT_CHUNK_SIZE ? left : DAT_CHUNK_SIZE);
+                }
+
+                offset += 2 + length;
+            }
+        }
+    }
+
+    return true;
+}
+
+static int benchmarkDat(const char* path)
+{
+    FILE* stream = fopen(path, "rb");
+    if (stream == NULL) {
+        fprintf(stderr, "%s: unable to open\n", path);
+        return 1;
+    }
+
+    std::vector<long> offsets;
+    std::vector<unsigned int> lengths;
+    std::vector<unsigned int> sizes;
+    if (!loadDatBlocks(path, stream, offsets, lengths, sizes)) {
+        fclose(stream);
+        return 1;
+    }
+
+    // Packed blocks are read upfront, both decoders are timed on memory.
+    std::vector<std::vector<unsigned char>> blocks(offsets.size());
+    unsigned int maxSize = 0;
+    double totalSize = 0.0;
+    for (size_t index = 0; index < offsets.size(); index++) {
+        blocks[index].resize(lengths[index]);
+        if (fseek(stream, offsets[index], SEEK_SET) != 0
+            || fread(blocks[index].data(), 1, lengths[index], stream) != lengths[index]) {
+            fprintf(stderr, "%s: unable to read block at %ld\n", path, offsets[index]);
+            fclose(stream);
+            return 1;
+        }
+
+        if (sizes[index] > maxSize) {
+            maxSize = sizes[index];
+        }
+        totalSize += sizes[index];
+    }
+
+    fclose(stream);
+
+    // Ring decoder writes whole matches past requested size.
+    std::vector<unsigned char> output(maxSize + 18);
+    std::vector<unsigned long long> hashes(blocks.size());
+    std::vector<unsigned char> primer = makePrimer();
+
+    // Decoders carry dictionary tail over from one block to the next, so
+    // each decoder gets a pass of its own, and outputs are compared by hash.
+    decodeWithStdio(primer, output.data());
+
+    double stdioTime = 0.0;
+    for (size_t index = 0; index < blocks.size(); index++) {
+        FILE* in = tmpfile();
+        if (in == NULL) {
+            return 1;
+        }
+
+        fwrite(blocks[index].data(), 1, blocks[index].size(), in);
+        rewind(in);
+
+        auto start = std::chrono::steady_clock::now();
+        lzss_decode_to_buf(in, output.data(), (unsigned int)blocks[index].size());
+        stdioTime += elapsedSeconds(start);
+
+        fclose(in);
+
+        hashes[index] = hashBytes(output.data(), sizes[index]);
+    }
+
+    lzss_decode_block(primer.data(), (unsigned int)primer.size(), output.data(), (unsigned int)output.size());
+
+    double blockTime = 0.0;
+    int mismatches = 0;
+    for (size_t index = 0; index < blocks.size(); index++) {
+        auto start = std::chrono::steady_clock::now();
+        int length = lzss_decode_block(blocks[index].data(), (unsigned int)blocks[index].size(), output.data(), sizes[index]);
+        blockTime += elapsedSeconds(start);
+
+        if (length != (int)sizes[index] || hashBytes(output.data(), sizes[index]) != hashes[index]) {
+            mismatches++;
+        }
+    }
+
+    double megabytes = totalSize / (1024.0 * 1024.0);
+    printf("lzss_test: %s, %d blocks, %.1f MB unpacked\n", path, (int)blocks.size(), megabytes);
+    printf("lzss_test: lzss_decode_to_buf %.1f MB/s, lzss_decode_block %.1f MB/s\n",
+        stdioTime > 0.0 ? megabytes / stdioTime : 0.0,
+        blockTime > 0.0 ? megabytes / blockTime : 0.0);
+
+    if (mismatches != 0) {
+        fprintf(stderr, "%s: %d block(s) differ\n", path, mismatches);
+        failures++;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    checkGeneratedStreams();
+
+    if (argc > 1) {
+        if (benchmarkDat(argv[1]) != 0) {
+            return 1;
+        }
+    }
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("lzss_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,525 @@
+// Benchmarks reading of map files with per-field reads, as the game did
+// before, against bulk reads `obj_read_obj` and `map_read_MapData` use now.
+//
+// Needs path to a DAT file with maps and protos, e.g.
+// `map_load_test master.dat`, and is skipped without it. Every map in the
+// DAT is read with both readers, values read must match, and time of each
+// read is reported per map.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <map>
+
+#include "game/map_defs.h"
+#include "game/object_types.h"
+#include "game/proto_types.h"
+#include "game/scripts.h"
+#include "platform_compat.h"
+#include "plib/db/db.h"
+
+using namespace fallout;
+
+// See `scripts.cc`.
+#define SCRIPT_LIST_EXTENT_SIZE 16
+
+// Each map is read this many times with each reader, best time counts.
+#define ROUNDS 5
+
+static int failures;
+
+static double elapsedMicroseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Reads every field the way the game did before: each int is two shorts,
+// each short is two bytes, each byte is one `db_fgetc` call.
+struct FieldReader {
+    static int readByte(DB_FILE* stream, unsigned char* value)
+    {
+        int ch = db_fgetc(stream);
+        if (ch == -1) {
+            return -1;
+        }
+
+        *value = ch & 0xFF;
+
+        return 0;
+    }
+
+    static int readShort(DB_FILE* stream, unsigned short* value)
+    {
+        unsigned char high;
+        unsigned char low;
+
+        if (readByte(stream, &high) == -1) return -1;
+        if (readByte(stream, &low) == -1) return -1;
+
+        *value = (high << 8) | low;
+
+        return 0;
+    }
+
+    static int readInt(DB_FILE* stream, int* value)
+    {
+        unsigned short high;
+        unsigned short low;
+
+        if (readShort(stream, &high) == -1) return -1;
+        if (readShort(stream, &low) == -1) return -1;
+
+        *value = (high << 16) | low;
+
+        return 0;
+    }
+
+    static int readInts(DB_FILE* stream, int* arr, int count)
+    {
+        for (int index = 0; index < count; index++) {
+            if (readInt(stream, &(arr[index])) == -1) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    static int readBytes(DB_FILE* stream, unsigned char* arr, int count)
+    {
+        for (int index = 0; index < count; index++) {
+            if (readByte(stream, &(arr[index])) == -1) {
+                return -1;
+            }
+        }
+
+        return 0;
+    }
+};
+
+// Reads runs of fields at once, as `db_freadIntCount` and friends do now.
+struct BulkReader {
+    static int readInt(DB_FILE* stream, int* value)
+    {
+        return db_freadInt(stream, value);
+    }
+
+    static int readInts(DB_FILE* stream, int* arr, int count)
+    {
+        return db_freadIntCount(stream, arr, count);
+    }
+
+    static int readBytes(DB_FILE* stream, unsigned char* arr, int count)
+    {
+        return db_freadByteCount(stream, arr, count);
+    }
+};
+
+// Item and scenery subtypes by pid, they decide the layout of object data.
+static std::map<int, int> protoTypes;
+
+// Looks up subtype of item or scenery proto the same way `proto_load_pid`
+// finds its file. Types are cached, so only the first read of a map pays
+// for proto files.
+static int protoType(int pid, int* typePtr)
+{
+    auto it = protoTypes.find(pid);
+    if (it != protoTypes.end()) {
+        *typePtr = it->second;
+        return 0;
+    }
+
+    const char* dir = PID_TYPE(pid) == OBJ_TYPE_ITEM ? "items" : "scenery";
+
+    char path[COMPAT_MAX_PATH];
+    snprintf(path, sizeof(path), "proto\\%s\\%s.lst", dir, dir);
+
+    DB_FILE* stream = db_fopen(path, "rt");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    int line = 1;
+    char string[256];
+    bool found = false;
+    while (db_fgets(string, sizeof(string), stream)) {
+        if (line == (pid & 0xFFFFFF)) {
+            found = true;
+            break;
+        }
+
+        line++;
+    }
+
+    db_fclose(stream);
+
+    if (!found) {
+        return -1;
+    }
+
+    string[strcspn(string, " \r\n")] = '\0';
+    snprintf(path, sizeof(path), "proto\\%s\\%s", dir, string);
+
+    stream = db_fopen(path, "rb");
+    if (stream == NULL) {
+        return -1;
+    }
+
+    // pid, message id, fid, light distance, light intensity, flags, extended
+    // flags, sid, type.
+    int fields[9];
+    int rc = db_freadIntCount(stream, fields, 9);
+    db_fclose(stream);
+
+    if (rc == -1) {
+        return -1;
+    }
+
+    protoTypes[pid] = fields[8];
+    *typePtr = fields[8];
+
+    return 0;
+}
+
+// Walks a map file in the order `map_load_file` reads it, fixed runs of
+// fields the way current code reads them (as one array, see
+// `map_read_MapData`, `obj_read_obj` and `proto_read_protoUpdateData`).
+// Everything read is folded into a hash, so both readers can be compared.
+template <typename Reader>
+class MapWalker {
+public:
+    unsigned int hash = 2166136261u;
+    int objects = 0;
+
+    int walk(DB_FILE* stream)
+    {
+        int version;
+        if (readInt(stream, &version) == -1) return -1;
+        if (version != 19) return -1;
+
+        unsigned char name[16];
+        if (Reader::readBytes(stream, name, 16) == -1) return -1;
+        for (int index = 0; index < 16; index++) {
+            add(name[index]);
+        }
+
+        // Entering tile, elevation, rotation, local vars count, script
+        // index, flags, darkness, global vars count, field_34, last visit
+        // time.
+        int header[10];
+        if (readInts(stream, header, 10) == -1) return -1;
+
+        int field_3C[44];
+        if (readInts(stream, field_3C, 44) == -1) return -1;
+
+        int localVariablesCount = header[3] > 0 ? header[3] : 0;
+        int flags = header[5];
+        int globalVariablesCount = header[7] > 0 ? header[7] : 0;
+
+        int* vars = (int*)malloc(sizeof(*vars) * (globalVariablesCount + localVariablesCount + 1));
+        int rc = readInts(stream, vars, globalVariablesCount);
+        if (rc == 0) {
+            rc = readInts(stream, vars + globalVariablesCount, localVariablesCount);
+        }
+        free(vars);
+
+        if (rc == -1) return -1;
+
+        static const int elevationFlags[ELEVATION_COUNT] = { 2, 4, 8 };
+        static int squares[SQUARE_GRID_SIZE];
+        for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+            if ((flags & elevationFlags[elevation]) == 0) {
+                if (readInts(stream, squares, SQUARE_GRID_SIZE) == -1) return -1;
+            }
+        }
+
+        if (walkScripts(stream) == -1) return -1;
+
+        int objectCount;
+        if (readInt(stream, &objectCount) == -1) return -1;
+
+        for (int elevation = 0; elevation < ELEVATION_COUNT; elevation++) {
+            int objectCountAtElevation;
+            if (readInt(stream, &objectCountAtElevation) == -1) return -1;
+
+            for (int index = 0; index < objectCountAtElevation; index++) {
+                if (walkObject(stream) == -1) return -1;
+            }
+        }
+
+        return 0;
+    }
+
+private:
+    void add(unsigned int value)
+    {
+        hash = (hash ^ value) * 16777619u;
+    }
+
+    int readInt(DB_FILE* stream, int* value)
+    {
+        if (Reader::readInt(stream, value) == -1) return -1;
+        add(*value);
+        return 0;
+    }
+
+    int readInts(DB_FILE* stream, int* arr, int count)
+    {
+        if (Reader::readInts(stream, arr, count) == -1) return -1;
+        for (int index = 0; index < count; index++) {
+            add(arr[index]);
+        }
+        return 0;
+    }
+
+    // See `scr_load`, scripts are stored in extents of 16 whether used or
+    // not, every field is read separately.
+    int walkScripts(DB_FILE* stream)
+    {
+        for (int type = 0; type < SCRIPT_TYPE_COUNT; type++) {
+            int scriptsCount;
+            if (readInt(stream, &scriptsCount) == -1) return -1;
+
+            if (scriptsCount == 0) {
+                continue;
+            }
+
+            int extents = (scriptsCount + SCRIPT_LIST_EXTENT_SIZE - 1) / SCRIPT_LIST_EXTENT_SIZE;
+            for (int extent = 0; extent < extents; extent++) {
+                for (int index = 0; index < SCRIPT_LIST_EXTENT_SIZE; index++) {
+                    int value;
+                    int sid;
+                    if (readInt(stream, &sid) == -1) return -1;
+
+                    int fields = 15;
+                    switch (SID_TYPE(sid)) {
+                    case SCRIPT_TYPE_SPATIAL:
+                        fields += 2;
+                        break;
+                    case SCRIPT_TYPE_TIMED:
+                        fields += 1;
+                        break;
+                    }
+
+                    for (int field = 0; field < fields; field++) {
+                        if (readInt(stream, &value) == -1) return -1;
+                    }
+                }
+
+                // Length and next extent.
+                int value;
+                if (readInt(stream, &value) == -1) return -1;
+                if (readInt(stream, &value) == -1) return -1;
+            }
+        }
+
+        return 0;
+    }
+
+    // See `obj_load_obj`.
+    int walkObject(DB_FILE* stream)
+    {
+        objects++;
+
+        int fields[18];
+        if (readInts(stream, fields, 18) == -1) return -1;
+
+        int pid = fields[11];
+
+        // Inventory length, capacity and items pointer.
+        int inventory[3];
+        if (readInts(stream, inventory, 3) == -1) return -1;
+
+        int extra = 0;
+        int type;
+        switch (PID_TYPE(pid)) {
+        case OBJ_TYPE_CRITTER:
+            // field_0, combat data, hp, radiation, poison.
+            extra = 1 + 7 + 3;
+            break;
+        case OBJ_TYPE_ITEM:
+            extra = 1;
+            if (protoType(pid, &type) == -1) return -1;
+
+            switch (type) {
+            case ITEM_TYPE_WEAPON:
+                extra += 2;
+                break;
+            case ITEM_TYPE_AMMO:
+            case ITEM_TYPE_MISC:
+            case ITEM_TYPE_KEY:
+                extra += 1;
+                break;
+            }
+            break;
+        case OBJ_TYPE_SCENERY:
+            extra = 1;
+            if (protoType(pid, &type) == -1) return -1;
+
+            switch (type) {
+            case SCENERY_TYPE_DOOR:
+            case SCENERY_TYPE_LADDER_UP:
+            case SCENERY_TYPE_LADDER_DOWN:
+                extra += 1;
+                break;
+            case SCENERY_TYPE_STAIRS:
+            case SCENERY_TYPE_ELEVATOR:
+                extra += 2;
+                break;
+            }
+            break;
+        case OBJ_TYPE_MISC:
+            extra = 1;
+            if (pid >= 0x5000010 && pid <= 0x5000017) {
+                extra += 4;
+            }
+            break;
+        default:
+            extra = 1;
+            break;
+        }
+
+        for (int index = 0; index < extra; index++) {
+            int value;
+            if (readInt(stream, &value) == -1) return -1;
+        }
+
+        for (int index = 0; index < inventory[0]; index++) {
+            int quantity;
+            if (readInt(stream, &quantity) == -1) return -1;
+            if (walkObject(stream) == -1) return -1;
+        }
+
+        return 0;
+    }
+};
+
+// Reads map `ROUNDS` times, returns best time in microseconds or -1 on error.
+template <typename Reader>
+static double timeMap(const char* path, unsigned int* hashPtr, int* objectsPtr)
+{
+    double best = -1;
+    for (int round = 0; round < ROUNDS; round++) {
+        MapWalker<Reader> walker;
+
+        auto start = std::chrono::steady_clock::now();
+        DB_FILE* stream = db_fopen(path, "rb");
+        if (stream == NULL) {
+            return -1;
+        }
+
+        int rc = walker.walk(stream);
+        db_fclose(stream);
+        double time = elapsedMicroseconds(start);
+
+        if (rc == -1) {
+            return -1;
+        }
+
+        if (best < 0 || time < best) {
+            best = time;
+        }
+
+        *hashPtr = walker.hash;
+        *objectsPtr = walker.objects;
+    }
+
+    return best;
+}
+
+static int benchmarkDat(const char* path)
+{
+    DB_DATABASE* database = db_init(path, NULL, NULL, 0);
+    if (database == INVALID_DATABASE_HANDLE) {
+        fprintf(stderr, "%s: unable to open\n", path);
+        return -1;
+    }
+
+    char** fileList;
+    int fileListLength = db_get_file_list("maps\\*.map", &fileList, NULL, 0);
+    if (fileListLength == 0) {
+        fprintf(stderr, "%s: no maps\n", path);
+        db_exit();
+        return -1;
+    }
+
+    double fieldTotal = 0;
+    double bulkTotal = 0;
+    int maps = 0;
+
+    printf("map_load_test: %-14s %8s %12s %12s\n", "map", "objects", "per-field us", "bulk us");
+
+    for (int index = 0; index < fileListLength; index++) {
+        char mapPath[COMPAT_MAX_PATH];
+        snprintf(mapPath, sizeof(mapPath), "maps\\%s", fileList[index]);
+
+        // Untimed read caches protos the map refers to.
+        unsigned int hash;
+        int objects;
+        if (timeMap<BulkReader>(mapPath, &hash, &objects) < 0) {
+            fprintf(stderr, "%s: unable to read\n", mapPath);
+            failures++;
+            continue;
+        }
+
+        unsigned int fieldHash;
+        int fieldObjects;
+        double fieldTime = timeMap<FieldReader>(mapPath, &fieldHash, &fieldObjects);
+
+        unsigned int bulkHash;
+        int bulkObjects;
+        double bulkTime = timeMap<BulkReader>(mapPath, &bulkHash, &bulkObjects);
+
+        if (fieldTime < 0 || bulkTime < 0) {
+            fprintf(stderr, "%s: unable to read\n", mapPath);
+            failures++;
+            continue;
+        }
+
+        if (fieldHash != bulkHash || fieldObjects != bulkObjects) {
+            fprintf(stderr, "%s: readers disagree\n", mapPath);
+            failures++;
+        }
+
+        printf("map_load_test: %-14s %8d %12.0f %12.0f\n", fileList[index], bulkObjects, fieldTime, bulkTime);
+
+        fieldTotal += fieldTime;
+        bulkTotal += bulkTime;
+        maps++;
+    }
+
+    db_free_file_list(&fileList, NULL);
+    db_exit();
+
+    if (maps != 0) {
+        printf("map_load_test: %d maps, per-field %.0f us, bulk %.0f us per map (%.2fx)\n",
+            maps,
+            fieldTotal / maps,
+            bulkTotal / maps,
+            bulkTotal > 0 ? fieldTotal / bulkTotal : 0.0);
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        printf("map_load_test: no DAT file given, skipped\n");
+        return 0;
+    }
+
+    if (benchmarkDat(argv[1]) != 0) {
+        failures++;
+    }
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("map_load_test: ok\n");
+    return 0;
+}
@@ -0,0 +1,471 @@
+// Checks that `path_find` returns exactly the same paths as the original
+// open-list `make_path_func`, and reports time per query for both.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "game/anim.h"
+#include "game/map_defs.h"
+#include "game/path.h"
+#include "game/tile.h"
+
+namespace fallout {
+
+// Hex grid geometry, same as `tile.cc` with the view centered on the map.
+
+static const int grid_width = HEX_GRID_WIDTH;
+static const int grid_size = HEX_GRID_SIZE;
+static const int tile_x = HEX_GRID_WIDTH / 2;
+static const int tile_y = HEX_GRID_HEIGHT / 2;
+static const int tile_offx = 304;
+static const int tile_offy = 180;
+
+static const int dir_tile[2][6] = {
+    { -1, HEX_GRID_WIDTH - 1, HEX_GRID_WIDTH, HEX_GRID_WIDTH + 1, 1, -HEX_GRID_WIDTH },
+    { -HEX_GRID_WIDTH - 1, -1, HEX_GRID_WIDTH, 1, 1 - HEX_GRID_WIDTH, -HEX_GRID_WIDTH },
+};
+
+static bool tile_on_edge(int tile)
+{
+    if (tile < 0 || tile >= grid_size) {
+        return false;
+    }
+
+    if (tile < grid_width) {
+        return true;
+    }
+
+    if (tile >= grid_size - grid_width) {
+        return true;
+    }
+
+    if (tile % grid_width == 0) {
+        return true;
+    }
+
+    if (tile % grid_width == grid_width - 1) {
+        return true;
+    }
+
+    return false;
+}
+
+int tile_coord(int tile, int* screenX, int* screenY, int elevation)
+{
+    if (tile < 0 || tile >= grid_size) {
+        return -1;
+    }
+
+    int v3 = grid_width - 1 - tile % grid_width;
+    int v4 = tile / grid_width;
+
+    *screenX = tile_offx;
+    *screenY = tile_offy;
+
+    int v5 = (v3 - tile_x) / -2;
+    *screenX += 48 * ((v3 - tile_x) / 2);
+    *screenY += 12 * v5;
+
+    if (v3 & 1) {
+        if (v3 <= tile_x) {
+            *screenX -= 16;
+            *screenY += 12;
+        } else {
+            *screenX += 32;
+        }
+    }
+
+    int v6 = v4 - tile_y;
+    *screenX += 16 * v6;
+    *screenY += 12 * v6;
+
+    return 0;
+}
+
+int tile_num_in_direction(int tile, int rotation, int distance)
+{
+    int newTile = tile;
+    for (int index = 0; index < distance; index++) {
+        if (tile_on_edge(newTile)) {
+            break;
+        }
+
+        int parity = (newTile % grid_width) & 1;
+        newTile += dir_tile[parity][rotation];
+    }
+
+    return newTile;
+}
+
+int idist(int x1, int y1, int x2, int y2)
+{
+    int dx = x2 - x1;
+    if (dx < 0) {
+        dx = -dx;
+    }
+
+    int dy = y2 - y1;
+    if (dy < 0) {
+        dy = -dy;
+    }
+
+    int dm = (dx <= dy) ? dx : dy;
+
+    return dx + dy - (dm / 2);
+}
+
+int EST(int tile1, int tile2)
+{
+    int x1;
+    int y1;
+    tile_coord(tile1, &x1, &y1, 0);
+
+    int x2;
+    int y2;
+    tile_coord(tile2, &x2, &y2, 0);
+
+    return idist(x1, y1, x2, y2);
+}
+
+} // namespace fallout
+
+using namespace fallout;
+
+#define LAYOUT_COUNT 8
+#define QUERIES_PER_LAYOUT 40
+#define MAX_PATH_LENGTH 20000
+
+static int failures;
+
+#define CHECK(condition)                                                   \
+    do {                                                                   \
+        if (!(condition)) {                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+                #condition);                                               \
+            failures++;                                                    \
+        }                                                                  \
+    } while (0)
+
+static unsigned int seed = 12345;
+
+static int nextRandom(int max)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % max;
+}
+
+static double elapsedMicroseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Blocker layout of the map being searched. Walls can't be passed at all,
+// doors only by critters that can open them.
+static unsigned char gBlockers[HEX_GRID_SIZE];
+static Object gWall;
+static Object gDoor;
+
+#define BLOCKER_NONE 0
+#define BLOCKER_WALL 1
+#define BLOCKER_DOOR 2
+
+static Object* blockingAt(Object* object, int tile, int elevation)
+{
+    switch (gBlockers[tile]) {
+    case BLOCKER_WALL:
+        return &gWall;
+    case BLOCKER_DOOR:
+        return &gDoor;
+    }
+
+    return NULL;
+}
+
+static bool canUseDoor(Object* critter, Object* door)
+{
+    return door == &gDoor;
+}
+
+// Scatters walls with given density (in percent), grown into short
+// segments so that paths have to go around them.
+static void makeLayout(int density)
+{
+    memset(gBlockers, BLOCKER_NONE, sizeof(gBlockers));
+
+    int count = HEX_GRID_SIZE * density / 100 / 4;
+    for (int index = 0; index < count; index++) {
+        int tile = nextRandom(HEX_GRID_SIZE);
+        int rotation = nextRandom(ROTATION_COUNT);
+        for (int step = 0; step < 4; step++) {
+            gBlockers[tile] = nextRandom(20) == 0 ? BLOCKER_DOOR : BLOCKER_WALL;
+            tile = tile_num_in_direction(tile, rotation, 1);
+        }
+    }
+}
+
+// Original implementation of `make_path_func` (without the destination check,
+// which is done before the search in both versions).
+
+typedef struct OldPathNode {
+    int tile;
+    int from;
+    int rotation;
+    int field_C;
+    int field_10;
+} OldPathNode;
+
+static OldPathNode dad[20000];
+static unsigned char seen[5000];
+static OldPathNode child[20000];
+
+static int oldMakePath(Object* object, int from, int to, unsigned char* rotations, bool isNotInCombat, PathBuilderCallback* callback)
+{
+    memset(seen, 0, sizeof(seen));
+
+    seen[from / 8] |= 1 << (from & 7);
+
+    child[0].tile = from;
+    child[0].from = -1;
+    child[0].rotation = 0;
+    child[0].field_C = EST(from, to);
+    child[0].field_10 = 0;
+
+    for (int index = 1; index < 2000; index += 1) {
+        child[index].tile = -1;
+    }
+
+    int toScreenX;
+    int toScreenY;
+    tile_coord(to, &toScreenX, &toScreenY, object->elevation);
+
+    int closedPathNodeListLength = 0;
+    int openPathNodeListLength = 1;
+    OldPathNode temp;
+
+    while (1) {
+        int v63 = -1;
+
+        OldPathNode* prev = NULL;
+        int v12 = 0;
+        for (int index = 0; v12 < openPathNodeListLength; index += 1) {
+            OldPathNode* curr = &(child[index]);
+            if (curr->tile != -1) {
+                v12++;
+                if (v63 == -1 || (curr->field_C + curr->field_10) < (prev->field_C + prev->field_10)) {
+                    prev = curr;
+                    v63 = index;
+                }
+            }
+        }
+
+        OldPathNode* curr = &(child[v63]);
+
+        memcpy(&temp, curr, sizeof(temp));
+
+        openPathNodeListLength -= 1;
+
+        curr->tile = -1;
+
+        if (temp.tile == to) {
+            if (openPathNodeListLength == 0) {
+                openPathNodeListLength = 1;
+            }
+            break;
+        }
+
+        OldPathNode* curr1 = &(dad[closedPathNodeListLength]);
+        memcpy(curr1, &temp, sizeof(temp));
+
+        closedPathNodeListLength += 1;
+
+        if (closedPathNodeListLength == 20000) {
+            return 0;
+        }
+
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+            int tile = tile_num_in_direction(temp.tile, rotation, 1);
+            int bit = 1 << (tile & 7);
+            if ((seen[tile / 8] & bit) != 0) {
+                continue;
+            }
+
+            if (tile != to) {
+                Object* v24 = callback(object, tile, object->elevation);
+                if (v24 != NULL) {
+                    if (!canUseDoor(object, v24)) {
+                        continue;
+                    }
+                }
+            }
+
+            int v25 = 0;
+            for (; v25 < 20000; v25++) {
+                if (child[v25].tile == -1) {
+                    break;
+                }
+            }
+
+            openPathNodeListLength += 1;
+
+            if (openPathNodeListLength == 20000) {
+                return 0;
+            }
+
+            seen[tile / 8] |= bit;
+
+            OldPathNode* v27 = &(child[v25]);
+            v27->tile = tile;
+            v27->from = temp.tile;
+            v27->rotation = rotation;
+
+            int newX;
+            int newY;
+            tile_coord(tile, &newX, &newY, object->elevation);
+
+            v27->field_C = idist(newX, newY, toScreenX, toScreenY);
+            v27->field_10 = temp.field_10 + 50;
+
+            if (isNotInCombat && temp.rotation != rotation) {
+                v27->field_10 += 10;
+            }
+        }
+
+        if (openPathNodeListLength == 0) {
+            break;
+        }
+    }
+
+    if (openPathNodeListLength != 0) {
+        unsigned char* v39 = rotations;
+        int index = 0;
+        for (; index < 20000; index++) {
+            if (temp.tile == from) {
+                break;
+            }
+
+            if (v39 != NULL) {
+                *v39 = temp.rotation & 0xFF;
+                v39 += 1;
+            }
+
+            int j = 0;
+            while (dad[j].tile != temp.from) {
+                j++;
+            }
+
+            OldPathNode* v36 = &(dad[j]);
+            memcpy(&temp, v36, sizeof(temp));
+        }
+
+        if (rotations != NULL) {
+            unsigned char* beginning = rotations;
+            unsigned char* ending = rotations + index - 1;
+            int middle = index / 2;
+            for (int index = 0; index < middle; index++) {
+                unsigned char rotation = *ending;
+                *ending = *beginning;
+                *beginning = rotation;
+
+                ending -= 1;
+                beginning += 1;
+            }
+        }
+
+        return index;
+    }
+
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Object critter;
+    memset(&critter, 0, sizeof(critter));
+
+    std::vector<unsigned char> expected(MAX_PATH_LENGTH);
+    std::vector<unsigned char> actual(MAX_PATH_LENGTH);
+
+    double oldTime = 0.0;
+    double newTime = 0.0;
+    int queries = 0;
+    int found = 0;
+
+    for (int layout = 0; layout < LAYOUT_COUNT; layout++) {
+        makeLayout(5 + layout * 5);
+
+        for (int query = 0; query < QUERIES_PER_LAYOUT; query++) {
+            int from = nextRandom(HEX_GRID_SIZE);
+            int to;
+            if (query % 2 == 0) {
+                // Short walk, the most common query in game.
+                to = from;
+                int rotation = nextRandom(ROTATION_COUNT);
+                int distance = 1 + nextRandom(20);
+                for (int step = 0; step < distance; step++) {
+                    to = tile_num_in_direction(to, (rotation + nextRandom(2)) % ROTATION_COUNT, 1);
+                }
+            } else {
+                to = nextRandom(HEX_GRID_SIZE);
+            }
+
+            bool isNotInCombat = nextRandom(2) != 0;
+
+            // Same rule as `make_path_func` applies before searching.
+            gBlockers[from] = BLOCKER_NONE;
+
+            memset(expected.data(), 0xFF, expected.size());
+            memset(actual.data(), 0xFF, actual.size());
+
+            auto start = std::chrono::steady_clock::now();
+            int expectedLength = oldMakePath(&critter, from, to, expected.data(), isNotInCombat, blockingAt);
+            oldTime += elapsedMicroseconds(start);
+
+            start = std::chrono::steady_clock::now();
+            int actualLength = path_find(&critter, from, to, actual.data(), isNotInCombat, blockingAt, canUseDoor);
+            newTime += elapsedMicroseconds(start);
+
+            // Same query without rotations, as `make_path` does when only
+            // length is needed.
+            int lengthOnly = path_find(&critter, from, to, NULL, isNotInCombat, blockingAt, canUseDoor);
+
+            if (expectedLength != actualLength || expected != actual) {
+                fprintf(stderr, "layout %d, query %d: %d -> %d, length %d, expected %d\n",
+                    layout,
+                    query,
+                    from,
+                    to,
+                    actualLength,
+                    expectedLength);
+                failures++;
+            }
+
+            CHECK(lengthOnly == expectedLength);
+
+            queries++;
+            if (expectedLength != 0) {
+                found++;
+            }
+        }
+    }
+
+    // Both unreachable and reachable destinations must have been exercised.
+    CHECK(found != 0);
+    CHECK(found != queries);
+
+    printf("path_test: %d queries (%d found), old %.1f us, new %.1f us per query\n",
+        queries,
+        found,
+        oldTime / queries,
+        newTime / queries);
+
+    if (failures != 0) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    printf("path_test: ok\n");
+    return 0;
+}
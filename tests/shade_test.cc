@@ -0,0 +1,235 @@
+// Checks that the shade row kernels produce exactly the same pixels as the
+// original per-pixel loops of `dark_trans_buf_to_buf`,
+// `dark_translucent_trans_buf_to_buf` and `intensity_mask_buf_to_buf`.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "game/shade.h"
+#include "plib/color/color.h"
+
+namespace fallout {
+
+Color colorMixAddTable[256][256];
+unsigned char intensityColorTable[256][256];
+
+} // namespace fallout
+
+using namespace fallout;
+
+#define ITERATIONS 20000
+#define MAX_WIDTH 80
+#define MAX_HEIGHT 12
+
+static unsigned int seed = 12345;
+
+static int nextRandom(int max)
+{
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % max;
+}
+
+// Fills sprite with a mix of transparent runs, opaque runs and noise, so that
+// every kind of 8-pixel group shows up.
+static void fillSprite(unsigned char* data, int length)
+{
+    int index = 0;
+    while (index < length) {
+        int run = 1 + nextRandom(24);
+        int kind = nextRandom(3);
+        for (int end = std::min(index + run, length); index < end; index++) {
+            if (kind == 0) {
+                data[index] = 0;
+            } else if (kind == 1) {
+                data[index] = 1 + nextRandom(255);
+            } else {
+                data[index] = nextRandom(2) ? nextRandom(256) : 0;
+            }
+        }
+    }
+}
+
+static void fillNoise(unsigned char* data, int length)
+{
+    for (int index = 0; index < length; index++) {
+        data[index] = nextRandom(256);
+    }
+}
+
+static void referenceDarkTrans(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, int light)
+{
+    int srcStep = srcPitch - srcWidth;
+    int destStep = destPitch - srcWidth;
+    int lightModifier = light >> 9;
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x++) {
+            unsigned char b = *src;
+            if (b != 0) {
+                if (b < 0xE5) {
+                    b = intensityColorTable[b][lightModifier];
+                }
+
+                *dest = b;
+            }
+
+            src++;
+            dest++;
+        }
+
+        src += srcStep;
+        dest += destStep;
+    }
+}
+
+static void referenceDarkTranslucentTrans(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, int light, unsigned char* a10, unsigned char* a11)
+{
+    int srcStep = srcPitch - srcWidth;
+    int destStep = destPitch - srcWidth;
+    int lightModifier = light >> 9;
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x++) {
+            unsigned char srcByte = *src;
+            if (srcByte != 0) {
+                unsigned char destByte = *dest;
+                unsigned int index = a11[srcByte] << 8;
+                index = a10[index + destByte];
+                *dest = intensityColorTable[index][lightModifier];
+            }
+
+            src++;
+            dest++;
+        }
+
+        src += srcStep;
+        dest += destStep;
+    }
+}
+
+static void referenceIntensityMask(unsigned char* src, int srcWidth, int srcHeight, int srcPitch, unsigned char* dest, int destPitch, unsigned char* mask, int maskPitch, int light)
+{
+    int srcStep = srcPitch - srcWidth;
+    int destStep = destPitch - srcWidth;
+    int maskStep = maskPitch - srcWidth;
+    light >>= 9;
+
+    for (int y = 0; y < srcHeight; y++) {
+        for (int x = 0; x < srcWidth; x++) {
+            unsigned char b = *src;
+            if (b != 0) {
+                b = intensityColorTable[b][light];
+                unsigned char m = *mask;
+                if (m != 0) {
+                    unsigned char d = *dest;
+                    int q = intensityColorTable[d][128 - m];
+                    m = intensityColorTable[b][m];
+                    b = colorMixAddTable[m][q];
+                }
+                *dest = b;
+            }
+
+            src++;
+            dest++;
+            mask++;
+        }
+
+        src += srcStep;
+        dest += destStep;
+        mask += maskStep;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    fillNoise(&(intensityColorTable[0][0]), sizeof(intensityColorTable));
+    fillNoise(&(colorMixAddTable[0][0]), sizeof(colorMixAddTable));
+
+    std::vector<unsigned char> blendTable(256 * 256);
+    std::vector<unsigned char> blendIndexTable(256);
+    fillNoise(blendTable.data(), static_cast<int>(blendTable.size()));
+    fillNoise(blendIndexTable.data(), static_cast<int>(blendIndexTable.size()));
+
+    std::vector<unsigned char> src(MAX_WIDTH * 2 * MAX_HEIGHT + 8);
+    std::vector<unsigned char> mask(MAX_WIDTH * 2 * MAX_HEIGHT + 8);
+    std::vector<unsigned char> expected(MAX_WIDTH * 2 * MAX_HEIGHT + 8);
+    std::vector<unsigned char> actual(MAX_WIDTH * 2 * MAX_HEIGHT + 8);
+
+    int failures = 0;
+
+    for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+        int width = 1 + nextRandom(MAX_WIDTH);
+        int height = 1 + nextRandom(MAX_HEIGHT);
+        int srcPitch = width + nextRandom(MAX_WIDTH);
+        int destPitch = width + nextRandom(MAX_WIDTH);
+        int maskPitch = width + nextRandom(MAX_WIDTH);
+
+        // Unaligned starts exercise unaligned word loads.
+        int srcOffset = nextRandom(8);
+        int destOffset = nextRandom(8);
+        int light = nextRandom(0x10000);
+        int kind = nextRandom(3);
+
+        fillSprite(src.data(), static_cast<int>(src.size()));
+        fillNoise(mask.data(), static_cast<int>(mask.size()));
+        for (size_t index = 0; index < mask.size(); index++) {
+            // Mask is a 0..128 weight, with plenty of zeroes.
+            mask[index] = nextRandom(2) ? mask[index] % 129 : 0;
+        }
+        fillNoise(expected.data(), static_cast<int>(expected.size()));
+        actual = expected;
+
+        unsigned char* sp = src.data() + srcOffset;
+        unsigned char* mp = mask.data() + srcOffset;
+        unsigned char* ep = expected.data() + destOffset;
+        unsigned char* ap = actual.data() + destOffset;
+
+        unsigned char shade[256];
+        if (kind == 0) {
+            referenceDarkTrans(sp, width, height, srcPitch, ep, destPitch, light);
+
+            shade_build_table(shade, light >> 9, true);
+            for (int y = 0; y < height; y++) {
+                shade_dark_trans_row(sp + srcPitch * y, ap + destPitch * y, width, shade);
+            }
+        } else if (kind == 1) {
+            referenceDarkTranslucentTrans(sp, width, height, srcPitch, ep, destPitch, light, blendTable.data(), blendIndexTable.data());
+
+            shade_build_table(shade, light >> 9, false);
+            for (int y = 0; y < height; y++) {
+                shade_dark_translucent_trans_row(sp + srcPitch * y, ap + destPitch * y, width, shade, blendTable.data(), blendIndexTable.data());
+            }
+        } else {
+            referenceIntensityMask(sp, width, height, srcPitch, ep, destPitch, mp, maskPitch, light);
+
+            shade_build_table(shade, light >> 9, false);
+            for (int y = 0; y < height; y++) {
+                shade_intensity_mask_row(sp + srcPitch * y, ap + destPitch * y, mp + maskPitch * y, width, shade);
+            }
+        }
+
+        if (expected != actual) {
+            fprintf(stderr, "iteration %d: kind %d, %dx%d, pitches %d/%d/%d: output differs\n",
+                iteration,
+                kind,
+                width,
+                height,
+                srcPitch,
+                destPitch,
+                maskPitch);
+            failures++;
+        }
+    }
+
+    if (failures != 0) {
+        fprintf(stderr, "%d of %d blit(s) differ\n", failures, ITERATIONS);
+        return 1;
+    }
+
+    printf("shade_test: ok\n");
+    return 0;
+}